@@ -47,240 +47,1433 @@
 #include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 #include <unistd.h>
+#if defined(_WIN32)
+  #include <io.h>
+#else
+  #include <poll.h>
+  #include <sys/mman.h>
+#endif
 
-struct scanresult *result_list;
-int scanresults_n;
+struct fft_eval_config fft_eval_config;
+struct fft_eval_store result_store;
 
-/* read_file - reads an file into a big buffer and returns it
+/* read_fd - reads a file descriptor into a big buffer and returns it
  *
- * @fname: file name
+ * @fd: file descriptor to read until EOF
+ * @size: returns the number of bytes read
+ *
+ * Fallback for inputs which cannot be mapped (pipes, character devices like
+ * debugfs files or platforms without mmap). The buffer grows geometrically
+ * to keep the number of reallocations logarithmic in the file size.
  *
  * returns the buffer with the files content
  */
-static char *read_file(char *fname, size_t *size)
+static u8 *read_fd(int fd, size_t *size)
 {
-	FILE *fp;
-	char *buf = NULL;
-	char *newbuf;
-	size_t ret;
+	size_t bufsize = 0;
+	u8 *buf = NULL;
+	u8 *newbuf;
+	ssize_t ret;
 
-	fp = fopen(fname, "rb");
+	*size = 0;
+	while (1) {
+		if (*size == bufsize) {
+			bufsize = bufsize ? bufsize * 2 : 64 * 1024;
+			newbuf = realloc(buf, bufsize);
+			if (!newbuf) {
+				free(buf);
+				return NULL;
+			}
 
-	if (!fp)
-		return NULL;
+			buf = newbuf;
+		}
 
-	*size = 0;
-	while (!feof(fp)) {
+		ret = read(fd, buf + *size, bufsize - *size);
+		if (ret < 0 && errno == EINTR)
+			continue;
 
-		newbuf = realloc(buf, *size + 4097);
-		if (!newbuf) {
+		if (ret < 0) {
 			free(buf);
 			return NULL;
 		}
 
-		buf = newbuf;
+		if (ret == 0)
+			break;
 
-		ret = fread(buf + *size, 1, 4096, fp);
 		*size += ret;
 	}
-	fclose(fp);
-
-	if (buf)
-		buf[*size] = '\0';
 
 	return buf;
 }
 
 /*
- * read_scandata - reads the fft scandata and compiles a linked list of datasets
+ * fft_eval_map_file - make the content of a dump available as one buffer
  *
  * @fname: file name
+ * @map: returns the buffer
+ *
+ * Regular files are mmap()ed read-only so that even multi-GB dumps only cost
+ * page cache. Everything else is read into a heap buffer.
  *
  * returns 0 on success, -1 on error.
  */
-int fft_eval_init(char *fname)
+int fft_eval_map_file(const char *fname, struct fft_eval_map *map)
 {
-	char *pos, *scandata;
-	size_t len, sample_len;
-	size_t rel_pos, remaining_len;
-	struct scanresult *result;
-	struct fft_sample_tlv *tlv;
-	struct scanresult *tail = result_list;
-	int handled, bins;
+	struct stat st;
+	int fd;
+	int flags = O_RDONLY;
 
-	scandata = read_file(fname, &len);
-	if (!scandata)
+	memset(map, 0, sizeof(*map));
+
+	if (!fname)
+		return -1;
+
+#ifdef O_BINARY
+	flags |= O_BINARY;
+#endif
+
+	fd = open(fname, flags);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) < 0) {
+		close(fd);
 		return -1;
+	}
+
+#if !defined(_WIN32)
+	if (S_ISREG(st.st_mode) && st.st_size > 0) {
+		void *data;
+
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+			madvise(data, st.st_size, MADV_SEQUENTIAL);
+#endif
+			map->data = data;
+			map->len = st.st_size;
+			map->mapped = 1;
+			close(fd);
+			return 0;
+		}
+	}
+#endif
+
+	map->data = read_fd(fd, &map->len);
+	close(fd);
+
+	if (!map->data)
+		return -1;
+
+	return 0;
+}
+
+void fft_eval_unmap(struct fft_eval_map *map)
+{
+#if !defined(_WIN32)
+	if (map->mapped) {
+		munmap((void *)map->data, map->len);
+		map->data = NULL;
+		return;
+	}
+#endif
+
+	free((void *)map->data);
+	map->data = NULL;
+}
+
+void fft_eval_cursor_init(struct fft_eval_cursor *cursor, const void *data,
+			  size_t len)
+{
+	cursor->data = data;
+	cursor->len = len;
+	cursor->pos = 0;
+}
+
+/* the TLV length is big endian and may be unaligned in the raw dump */
+u16 fft_eval_tlv_length(const struct fft_sample_tlv *tlv)
+{
+	const u8 *raw = (const u8 *)tlv;
+
+	return raw[1] << 8 | raw[2];
+}
+
+/*
+ * fft_eval_cursor_next - get the next TLV of a dump
+ *
+ * @cursor: position in the dump
+ * @sample_len: returns the length of the TLV including its header
+ *
+ * The returned TLV points into the buffer of the cursor and is still in
+ * (big endian) wire format. Nothing besides the length is validated.
+ *
+ * returns NULL when the end of the buffer was reached. cursor->pos is not
+ * equal to cursor->len when the buffer ended with an incomplete TLV.
+ */
+const struct fft_sample_tlv *
+fft_eval_cursor_next(struct fft_eval_cursor *cursor, size_t *sample_len)
+{
+	const struct fft_sample_tlv *tlv;
+	size_t remaining_len;
+
+	remaining_len = cursor->len - cursor->pos;
+	if (remaining_len < sizeof(*tlv))
+		return NULL;
+
+	tlv = (const struct fft_sample_tlv *)(cursor->data + cursor->pos);
+	*sample_len = sizeof(*tlv) + fft_eval_tlv_length(tlv);
+	if (remaining_len < *sample_len)
+		return NULL;
+
+	cursor->pos += *sample_len;
+
+	return tlv;
+}
+
+/*
+ * fft_eval_check_tlv - validates a TLV in wire format
+ *
+ * @tlv: TLV in wire format, sample_len bytes long
+ * @sample_len: length of the TLV including its header
+ *
+ * The checks only look at the wire format so rejected samples never have to
+ * be copied or converted.
+ *
+ * returns FFT_EVAL_ACCEPT or the reason why the sample has to be skipped.
+ */
+enum fft_eval_reject fft_eval_check_tlv(const struct fft_sample_tlv *tlv,
+					size_t sample_len)
+{
+	int bins;
+
+	if (sample_len > FFT_EVAL_MAX_SAMPLE_LEN)
+		return FFT_EVAL_REJECT_TOO_LONG;
+
+	switch (tlv->type) {
+	case ATH_FFT_SAMPLE_HT20:
+		if (sample_len != sizeof(struct fft_sample_ht20))
+			return FFT_EVAL_REJECT_BAD_LENGTH;
+
+		break;
+	case ATH_FFT_SAMPLE_HT20_40:
+		if (sample_len != sizeof(struct fft_sample_ht20_40))
+			return FFT_EVAL_REJECT_BAD_LENGTH;
+
+		break;
+	case ATH_FFT_SAMPLE_ATH10K:
+		if (sample_len < sizeof(struct fft_sample_ath10k))
+			return FFT_EVAL_REJECT_BAD_LENGTH;
+
+		bins = sample_len - sizeof(struct fft_sample_ath10k);
+
+		if (bins != 64 &&
+		    bins != 128 &&
+		    bins != 256)
+			return FFT_EVAL_REJECT_BAD_BINS;
+
+		/*
+		 * Zero noise level should not happen in a real environment
+		 * but some datasets contain it which creates bogus results.
+		 */
+		if (((const struct fft_sample_ath10k *)tlv)->noise == 0)
+			return FFT_EVAL_REJECT_ZERO_NOISE;
+
+		break;
+	case ATH_FFT_SAMPLE_ATH11K:
+		if (sample_len < sizeof(struct fft_sample_ath11k))
+			return FFT_EVAL_REJECT_BAD_LENGTH;
+
+		bins = sample_len - sizeof(struct fft_sample_ath11k);
+
+		if (bins != 16 &&
+		    bins != 32 &&
+		    bins != 64 &&
+		    bins != 128 &&
+		    bins != 256 &&
+		    bins != 512)
+			return FFT_EVAL_REJECT_BAD_BINS;
+
+		/*
+		 * Zero noise level should not happen in a real environment
+		 * but some datasets contain it which creates bogus results.
+		 */
+		if (((const struct fft_sample_ath11k *)tlv)->noise == 0)
+			return FFT_EVAL_REJECT_ZERO_NOISE;
+
+		break;
+	default:
+		return FFT_EVAL_REJECT_UNKNOWN_TYPE;
+	}
+
+	return FFT_EVAL_ACCEPT;
+}
+
+/*
+ * fft_eval_tlv_tsf - reads the TSF of a TLV in wire format
+ *
+ * @tlv: TLV in wire format which passed fft_eval_check_tlv()
+ *
+ * returns the TSF in host endianness.
+ */
+u64 fft_eval_tlv_tsf(const struct fft_sample_tlv *tlv)
+{
+	u64 tsf = 0;
+	u32 tsf32;
+
+	switch (tlv->type) {
+	case ATH_FFT_SAMPLE_HT20:
+		tsf = ((const struct fft_sample_ht20 *)tlv)->tsf;
+		CONVERT_BE64(tsf);
+		break;
+	case ATH_FFT_SAMPLE_HT20_40:
+		tsf = ((const struct fft_sample_ht20_40 *)tlv)->tsf;
+		CONVERT_BE64(tsf);
+		break;
+	case ATH_FFT_SAMPLE_ATH10K:
+		tsf = ((const struct fft_sample_ath10k *)tlv)->tsf;
+		CONVERT_BE64(tsf);
+		break;
+	case ATH_FFT_SAMPLE_ATH11K:
+		tsf32 = ((const struct fft_sample_ath11k *)tlv)->tsf;
+		CONVERT_BE32(tsf32);
+		tsf = tsf32;
+		break;
+	}
+
+	return tsf;
+}
+
+/*
+ * fft_eval_filter_tlv - applies the filters of fft_eval_config to a TLV
+ *
+ * @tlv: TLV in wire format which passed fft_eval_check_tlv()
+ * @sample_len: length of the TLV including its header
+ *
+ * Only the few fields compared by the filters are read from the wire
+ * format, so samples which are filtered out are never copied or decoded.
+ *
+ * returns FFT_EVAL_ACCEPT or FFT_EVAL_REJECT_FILTERED.
+ */
+enum fft_eval_reject fft_eval_filter_tlv(const struct fft_sample_tlv *tlv,
+					 size_t sample_len)
+{
+	const struct fft_eval_filter *filter = &fft_eval_config.filter;
+	const struct fft_sample_ht20 *ht20;
+	const struct fft_sample_ht20_40 *ht40;
+	const struct fft_sample_ath10k *ath10k;
+	const struct fft_sample_ath11k *ath11k;
+	u8 chan_width = 0;
+	int32_t rssi = 0;
+	u16 freq = 0;
+	u16 rssi16;
+	u64 tsf;
+
+	if ((filter->active & FFT_EVAL_FILTER_TYPE) &&
+	    !(filter->types & (1U << tlv->type)))
+		return FFT_EVAL_REJECT_FILTERED;
+
+	if ((filter->active & FFT_EVAL_FILTER_BINS) &&
+	    sample_len - fft_eval_header_len(tlv->type) != filter->bins)
+		return FFT_EVAL_REJECT_FILTERED;
+
+	switch (tlv->type) {
+	case ATH_FFT_SAMPLE_HT20:
+		ht20 = (const struct fft_sample_ht20 *)tlv;
+		freq = ht20->freq;
+		rssi = ht20->rssi;
+		chan_width = 20;
+		break;
+	case ATH_FFT_SAMPLE_HT20_40:
+		ht40 = (const struct fft_sample_ht20_40 *)tlv;
+		freq = ht40->freq;
+		rssi = ht40->lower_rssi;
+		chan_width = 40;
+		break;
+	case ATH_FFT_SAMPLE_ATH10K:
+		ath10k = (const struct fft_sample_ath10k *)tlv;
+		freq = ath10k->freq1;
+		rssi = ath10k->rssi;
+		chan_width = ath10k->chan_width_mhz;
+		break;
+	case ATH_FFT_SAMPLE_ATH11K:
+		ath11k = (const struct fft_sample_ath11k *)tlv;
+		freq = ath11k->freq1;
+		rssi16 = ath11k->rssi;
+		CONVERT_BE16(rssi16);
+		rssi = rssi16;
+		chan_width = ath11k->chan_width_mhz;
+		break;
+	}
+
+	CONVERT_BE16(freq);
+
+	if ((filter->active & FFT_EVAL_FILTER_WIDTH) &&
+	    chan_width != filter->chan_width)
+		return FFT_EVAL_REJECT_FILTERED;
+
+	if ((filter->active & FFT_EVAL_FILTER_FREQ) &&
+	    (freq < filter->freq_min || freq > filter->freq_max))
+		return FFT_EVAL_REJECT_FILTERED;
+
+	if (filter->active & FFT_EVAL_FILTER_TSF) {
+		tsf = fft_eval_tlv_tsf(tlv);
+		if (tsf < filter->tsf_min || tsf > filter->tsf_max)
+			return FFT_EVAL_REJECT_FILTERED;
+	}
+
+	if ((filter->active & FFT_EVAL_FILTER_RSSI) && rssi < filter->rssi_min)
+		return FFT_EVAL_REJECT_FILTERED;
+
+	return FFT_EVAL_ACCEPT;
+}
+
+/* number of rejected TLVs which are reported in detail */
+#define REPORT_LIMIT	32
 
-	pos = scandata;
+/*
+ * fft_eval_report_reject - prints why a TLV was rejected
+ *
+ * @stats: statistics of the parser
+ * @tlv: TLV in wire format
+ * @sample_len: length of the TLV including its header
+ * @reason: return value of fft_eval_check_tlv()
+ *
+ * Only the first REPORT_LIMIT messages are printed, the others are counted
+ * in stats->suppressed. Printing a line for every TLV of a corrupt
+ * dump would take longer than parsing it.
+ */
+void fft_eval_report_reject(struct fft_eval_stats *stats,
+			    const struct fft_sample_tlv *tlv,
+			    size_t sample_len, enum fft_eval_reject reason)
+{
+	size_t header_len = fft_eval_header_len(tlv->type);
+
+	if (reason == FFT_EVAL_ACCEPT || reason == FFT_EVAL_REJECT_ZERO_NOISE ||
+	    reason == FFT_EVAL_REJECT_FILTERED)
+		return;
 
-	while ((uintptr_t)(pos - scandata) < len) {
-		rel_pos = pos - scandata;
-		remaining_len = len - rel_pos;
+	if (stats->reported >= REPORT_LIMIT) {
+		stats->suppressed++;
+		return;
+	}
+	stats->reported++;
 
-		if (remaining_len < sizeof(*tlv)) {
-			fprintf(stderr, "Found incomplete TLV header at position 0x%zx\n", rel_pos);
+	switch (reason) {
+	case FFT_EVAL_ACCEPT:
+	case FFT_EVAL_REJECT_ZERO_NOISE:
+	case FFT_EVAL_REJECT_FILTERED:
+	case FFT_EVAL_REJECT_SHORT_HEADER:
+	case FFT_EVAL_REJECT_TRUNCATED:
+	case FFT_EVAL_REJECT_MAX:
+		break;
+	case FFT_EVAL_REJECT_TOO_LONG:
+		fprintf(stderr, "sample length %zu too long\n", sample_len);
+		break;
+	case FFT_EVAL_REJECT_BAD_LENGTH:
+		switch (tlv->type) {
+		case ATH_FFT_SAMPLE_HT20:
+			fprintf(stderr, "wrong sample length (have %zd, expected %zd)\n",
+				sample_len, sizeof(struct fft_sample_ht20));
+			break;
+		case ATH_FFT_SAMPLE_HT20_40:
+			fprintf(stderr, "wrong sample length (have %zd, expected %zd)\n",
+				sample_len, sizeof(struct fft_sample_ht20_40));
+			break;
+		default:
+			fprintf(stderr, "wrong sample length (have %zd, expected at least %zd)\n",
+				sample_len, header_len);
 			break;
 		}
+		break;
+	case FFT_EVAL_REJECT_BAD_BINS:
+		fprintf(stderr, "invalid bin length %d\n",
+			(int)(sample_len - header_len));
+		break;
+	case FFT_EVAL_REJECT_UNKNOWN_TYPE:
+		fprintf(stderr, "unknown sample type (%d)\n", tlv->type);
+		break;
+	}
+}
+
+static void report_suppressed(const struct fft_eval_stats *stats, u64 before)
+{
+	if (stats->suppressed > before)
+		fprintf(stderr, "%llu more rejected samples were not reported\n",
+			(unsigned long long)(stats->suppressed - before));
+}
+
+static void report_filtered(const struct fft_eval_counts *counts, u64 before,
+			    u64 before_bytes)
+{
+	if (counts->rejected[FFT_EVAL_REJECT_FILTERED] > before)
+		fprintf(stderr, "skipped %llu samples (%llu bytes) by filters\n",
+			(unsigned long long)(counts->rejected[FFT_EVAL_REJECT_FILTERED] - before),
+			(unsigned long long)(counts->filtered_bytes - before_bytes));
+}
+
+/*
+ * fft_eval_decode_tlv - converts an accepted TLV to host endianness
+ *
+ * @tlv: TLV in wire format which passed fft_eval_check_tlv()
+ * @sample_len: length of the TLV including its header
+ * @out: buffer of at least sample_len bytes for the host endian copy
+ * @sample: returns the decoded sample, pointing into @out
+ */
+void fft_eval_decode_tlv(const struct fft_sample_tlv *tlv, size_t sample_len,
+			 u8 *out, struct fft_eval_sample *sample)
+{
+	struct fft_sample_ht20 *ht20;
+	struct fft_sample_ht20_40 *ht40;
+	struct fft_sample_ath10k *ath10k;
+	struct fft_sample_ath11k *ath11k;
+	size_t header_len = fft_eval_header_len(tlv->type);
+
+	memcpy(out, tlv, sample_len);
+	((struct fft_sample_tlv *)out)->length = sample_len - sizeof(*tlv);
+
+	sample->tlv = (const struct fft_sample_tlv *)out;
+	sample->data = out + header_len;
+	sample->pos = 0;
+	sample->type = tlv->type;
+	sample->bins = sample_len - header_len;
+
+	switch (tlv->type) {
+	case ATH_FFT_SAMPLE_HT20:
+		ht20 = (struct fft_sample_ht20 *)out;
+
+		CONVERT_BE16(ht20->freq);
+		CONVERT_BE16(ht20->max_magnitude);
+		CONVERT_BE64(ht20->tsf);
+
+		sample->tsf = ht20->tsf;
+		sample->rssi = ht20->rssi;
+		sample->noise = ht20->noise;
+		sample->freq = ht20->freq;
+		sample->max_exp = ht20->max_exp;
+		sample->chan_width = 20;
+		break;
+	case ATH_FFT_SAMPLE_HT20_40:
+		ht40 = (struct fft_sample_ht20_40 *)out;
+
+		CONVERT_BE16(ht40->freq);
+		CONVERT_BE64(ht40->tsf);
+		CONVERT_BE16(ht40->lower_max_magnitude);
+		CONVERT_BE16(ht40->upper_max_magnitude);
+
+		sample->tsf = ht40->tsf;
+		sample->rssi = ht40->lower_rssi;
+		sample->noise = ht40->lower_noise;
+		sample->freq = ht40->freq;
+		sample->max_exp = ht40->max_exp;
+		sample->chan_width = 40;
+		break;
+	case ATH_FFT_SAMPLE_ATH10K:
+		ath10k = (struct fft_sample_ath10k *)out;
+
+		CONVERT_BE16(ath10k->freq1);
+		CONVERT_BE16(ath10k->freq2);
+		CONVERT_BE16(ath10k->noise);
+		CONVERT_BE16(ath10k->max_magnitude);
+		CONVERT_BE16(ath10k->total_gain_db);
+		CONVERT_BE16(ath10k->base_pwr_db);
+		CONVERT_BE64(ath10k->tsf);
+
+		sample->tsf = ath10k->tsf;
+		sample->rssi = ath10k->rssi;
+		sample->noise = ath10k->noise;
+		sample->freq = ath10k->freq1;
+		sample->max_exp = ath10k->max_exp;
+		sample->chan_width = ath10k->chan_width_mhz;
+		break;
+	case ATH_FFT_SAMPLE_ATH11K:
+		ath11k = (struct fft_sample_ath11k *)out;
+
+		CONVERT_BE16(ath11k->freq1);
+		CONVERT_BE16(ath11k->freq2);
+		CONVERT_BE16(ath11k->max_magnitude);
+		CONVERT_BE16(ath11k->rssi);
+		CONVERT_BE32(ath11k->tsf);
+		CONVERT_BE32(ath11k->noise);
+
+		sample->tsf = ath11k->tsf;
+		sample->rssi = ath11k->rssi;
+		sample->noise = ath11k->noise;
+		sample->freq = ath11k->freq1;
+		sample->max_exp = ath11k->max_exp;
+		sample->chan_width = ath11k->chan_width_mhz;
+		break;
+	}
+}
+
+static int store_grow_column(void **column, size_t elem_size, size_t n)
+{
+	void *newcolumn;
+
+	newcolumn = realloc(*column, elem_size * n);
+	if (!newcolumn)
+		return -1;
+
+	*column = newcolumn;
+	return 0;
+}
+
+static int store_grow(struct fft_eval_store *store, size_t n)
+{
+	size_t alloc = store->alloc ? store->alloc * 2 : 1024;
+
+	if (store->cache)
+		return -1;
+
+	while (alloc < n)
+		alloc *= 2;
+
+	if (store_grow_column((void **)&store->tsf, sizeof(*store->tsf), alloc) ||
+	    store_grow_column((void **)&store->rssi, sizeof(*store->rssi), alloc) ||
+	    store_grow_column((void **)&store->noise, sizeof(*store->noise), alloc) ||
+	    store_grow_column((void **)&store->freq, sizeof(*store->freq), alloc) ||
+	    store_grow_column((void **)&store->bins, sizeof(*store->bins), alloc) ||
+	    store_grow_column((void **)&store->type, sizeof(*store->type), alloc) ||
+	    store_grow_column((void **)&store->max_exp, sizeof(*store->max_exp), alloc) ||
+	    store_grow_column((void **)&store->chan_width, sizeof(*store->chan_width), alloc) ||
+	    store_grow_column((void **)&store->pos, sizeof(*store->pos), alloc) ||
+	    store_grow_column((void **)&store->offset, sizeof(*store->offset), alloc))
+		return -1;
+
+	store->alloc = alloc;
+	return 0;
+}
+
+static int store_grow_arena(struct fft_eval_store *store, size_t len)
+{
+	u8 *newarena;
+	size_t alloc;
+
+	if (store->arena_alloc - store->arena_len >= len)
+		return 0;
+
+	if (store->cache)
+		return -1;
 
-		tlv = (struct fft_sample_tlv *) pos;
-		CONVERT_BE16(tlv->length);
-		sample_len = sizeof(*tlv) + tlv->length;
-		pos += sample_len;
+	alloc = store->arena_alloc ? store->arena_alloc * 2 : 256 * 1024;
+	while (alloc - store->arena_len < len)
+		alloc *= 2;
 
-		if (remaining_len < sample_len) {
-			fprintf(stderr, "Found incomplete TLV at position 0x%zx\n", rel_pos);
+	newarena = realloc(store->arena, alloc);
+	if (!newarena)
+		return -1;
+
+	store->arena = newarena;
+	store->arena_alloc = alloc;
+
+	return 0;
+}
+
+static void store_set(struct fft_eval_store *store, size_t i,
+		      const struct fft_eval_sample *sample)
+{
+	store->tsf[i] = sample->tsf;
+	store->rssi[i] = sample->rssi;
+	store->noise[i] = sample->noise;
+	store->freq[i] = sample->freq;
+	store->bins[i] = sample->bins;
+	store->type[i] = sample->type;
+	store->max_exp[i] = sample->max_exp;
+	store->chan_width[i] = sample->chan_width;
+	store->pos[i] = sample->pos;
+	store->offset[i] = store->arena_len;
+}
+
+/*
+ * fft_eval_store_add - decodes a TLV and appends it to the store
+ *
+ * @store: column store
+ * @tlv: TLV in wire format which passed fft_eval_check_tlv()
+ * @sample_len: length of the TLV including its header
+ * @pos: position of the TLV in the dump
+ *
+ * returns 0 on success, -1 if memory ran out.
+ */
+int fft_eval_store_add(struct fft_eval_store *store,
+		       const struct fft_sample_tlv *tlv, size_t sample_len,
+		       u64 pos)
+{
+	struct fft_eval_sample sample;
+	size_t i = store->n;
+
+	if (store->n == store->alloc && store_grow(store, store->n + 1) < 0)
+		return -1;
+
+	if (store_grow_arena(store, sample_len) < 0)
+		return -1;
+
+	fft_eval_decode_tlv(tlv, sample_len, store->arena + store->arena_len,
+			    &sample);
+	sample.pos = pos;
+	store_set(store, i, &sample);
+
+	store->arena_len += sample_len;
+	store->n++;
+
+	return 0;
+}
+
+/*
+ * fft_eval_store_add_sample - appends a sample which was already decoded
+ *  by fft_eval_decode_tlv()
+ *
+ * returns 0 on success, -1 if memory ran out.
+ */
+int fft_eval_store_add_sample(struct fft_eval_store *store,
+			      const struct fft_eval_sample *sample)
+{
+	size_t sample_len = sizeof(*sample->tlv) + sample->tlv->length;
+	size_t i = store->n;
+
+	if (store->n == store->alloc && store_grow(store, store->n + 1) < 0)
+		return -1;
+
+	if (store_grow_arena(store, sample_len) < 0)
+		return -1;
+
+	memcpy(store->arena + store->arena_len, sample->tlv, sample_len);
+	store_set(store, i, sample);
+
+	store->arena_len += sample_len;
+	store->n++;
+
+	return 0;
+}
+
+/*
+ * fft_eval_store_append - appends all samples of src to store
+ *
+ * returns 0 on success, -1 if memory ran out.
+ */
+int fft_eval_store_append(struct fft_eval_store *store,
+			  const struct fft_eval_store *src)
+{
+	size_t i;
+
+	if (!src->n)
+		return 0;
+
+	if (store->alloc - store->n < src->n &&
+	    store_grow(store, store->n + src->n) < 0)
+		return -1;
+
+	if (store_grow_arena(store, src->arena_len) < 0)
+		return -1;
+
+	memcpy(store->tsf + store->n, src->tsf, src->n * sizeof(*src->tsf));
+	memcpy(store->rssi + store->n, src->rssi, src->n * sizeof(*src->rssi));
+	memcpy(store->noise + store->n, src->noise, src->n * sizeof(*src->noise));
+	memcpy(store->freq + store->n, src->freq, src->n * sizeof(*src->freq));
+	memcpy(store->bins + store->n, src->bins, src->n * sizeof(*src->bins));
+	memcpy(store->type + store->n, src->type, src->n * sizeof(*src->type));
+	memcpy(store->max_exp + store->n, src->max_exp, src->n * sizeof(*src->max_exp));
+	memcpy(store->chan_width + store->n, src->chan_width,
+	       src->n * sizeof(*src->chan_width));
+	memcpy(store->pos + store->n, src->pos, src->n * sizeof(*src->pos));
+
+	for (i = 0; i < src->n; i++)
+		store->offset[store->n + i] = store->arena_len + src->offset[i];
+
+	memcpy(store->arena + store->arena_len, src->arena, src->arena_len);
+
+	store->arena_len += src->arena_len;
+	store->n += src->n;
+
+	return 0;
+}
+
+void fft_eval_store_free(struct fft_eval_store *store)
+{
+	if (store->cache) {
+		fft_eval_unmap(store->cache);
+		free(store->cache);
+		memset(store, 0, sizeof(*store));
+		return;
+	}
+
+	free(store->tsf);
+	free(store->rssi);
+	free(store->noise);
+	free(store->freq);
+	free(store->bins);
+	free(store->type);
+	free(store->max_exp);
+	free(store->chan_width);
+	free(store->pos);
+	free(store->offset);
+	free(store->arena);
+
+	memset(store, 0, sizeof(*store));
+}
+
+/*
+ * fft_eval_reader_open - prepares sequential reading of a dump
+ *
+ * @reader: reader state
+ * @fname: file name, "-" for stdin
+ *
+ * returns 0 on success, -1 on error.
+ */
+int fft_eval_reader_open(struct fft_eval_reader *reader, const char *fname)
+{
+	reader->flags = 0;
+	reader->pos = 0;
+	reader->samples = 0;
+	reader->stop = 0;
+	reader->fd_flags = -1;
+	reader->nonblock = 0;
+	reader->idle = NULL;
+	reader->idle_arg = NULL;
+	memset(&reader->stats, 0, sizeof(reader->stats));
+	fft_eval_sampler_init(&reader->sampler);
+
+	if (!fname)
+		return -1;
+
+	/* every sample is passed on before the end of the input is known */
+	if (fft_eval_config.sampling.reservoir) {
+		fprintf(stderr, "--reservoir can't be used while streaming\n");
+		return -1;
+	}
+
+	if (strcmp(fname, "-") == 0) {
+#if defined(_WIN32)
+		setmode(fileno(stdin), O_BINARY);
+#endif
+		reader->fp = stdin;
+		return 0;
+	}
+
+	reader->fp = fopen(fname, "rb");
+	if (!reader->fp)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * fft_eval_reader_stop - makes a reader with FOLLOW stop waiting for data
+ *
+ * Can be called from any thread. fft_eval_reader_next() returns 0 within
+ * FFT_EVAL_READER_POLL_US afterwards.
+ */
+void fft_eval_reader_stop(struct fft_eval_reader *reader)
+{
+	__atomic_store_n(&reader->stop, 1, __ATOMIC_RELEASE);
+}
+
+static int reader_stopped(struct fft_eval_reader *reader)
+{
+	return __atomic_load_n(&reader->stop, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * reader_nonblock - switches the input of a FOLLOW reader to non-blocking
+ *
+ * A read from an empty pipe would otherwise block until the writer sends
+ * more data and fft_eval_reader_stop() could not end it. Readers with an
+ * idle function need it too, to notice that a pipe or socket is empty
+ * before they block on it. Terminals are left alone, they usually share
+ * the file description with stdout.
+ */
+static void reader_nonblock(struct fft_eval_reader *reader)
+{
+#if !defined(_WIN32)
+	int fd = fileno(reader->fp);
+	struct stat st;
+	int flags;
+
+	if (reader->nonblock)
+		return;
+
+	reader->nonblock = 1;
+
+	if (!(reader->flags & FFT_EVAL_READER_FOLLOW) &&
+	    (!reader->idle || fstat(fd, &st) < 0 ||
+	     !(S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode))))
+		return;
+
+	flags = fcntl(fd, F_GETFL);
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+		return;
+
+	reader->fd_flags = flags;
+#else
+	(void)reader;
+#endif
+}
+
+/*
+ * reader_wait - waits until a pipe without FOLLOW has data again
+ */
+static void reader_wait(struct fft_eval_reader *reader)
+{
+#if !defined(_WIN32)
+	struct pollfd pfd;
+
+	pfd.fd = fileno(reader->fp);
+	pfd.events = POLLIN;
+	poll(&pfd, 1, -1);
+#else
+	(void)reader;
+#endif
+}
+
+/*
+ * reader_read - reads up to len bytes
+ *
+ * With FFT_EVAL_READER_FOLLOW, the end of the input is polled until len
+ * bytes were read, like "tail -f" does, or the reader was stopped. The
+ * idle function is called whenever the reader has to wait for data.
+ */
+static size_t reader_read(struct fft_eval_reader *reader, void *buf,
+			  size_t len)
+{
+	size_t done = 0;
+	int follow = reader->flags & FFT_EVAL_READER_FOLLOW;
+
+	reader_nonblock(reader);
+
+	while (1) {
+		done += fread((u8 *)buf + done, 1, len - done, reader->fp);
+		if (done == len || reader_stopped(reader))
+			return done;
+
+		/* without FOLLOW, only an empty non-blocking pipe is waited for */
+		if (!follow && (!ferror(reader->fp) ||
+				(errno != EAGAIN && errno != EWOULDBLOCK)))
+			return done;
+
+		clearerr(reader->fp);
+
+		if (reader->idle)
+			reader->idle(reader->idle_arg);
+
+		if (follow)
+			usleep(FFT_EVAL_READER_POLL_US);
+		else
+			reader_wait(reader);
+	}
+}
+
+static enum fft_eval_stage reader_stage(struct fft_eval_reader *reader,
+					enum fft_eval_stage stage)
+{
+	if (reader->flags & FFT_EVAL_READER_NOSTATS)
+		return FFT_EVAL_STAGE_NONE;
+
+	return fft_eval_stage_enter(stage);
+}
+
+/*
+ * fft_eval_reader_next - reads and decodes the next accepted sample
+ *
+ * @reader: reader state
+ * @sample: returns the decoded sample, valid until the next call
+ *
+ * Blocks until the next complete TLV was received. Rejected TLVs are
+ * skipped.
+ *
+ * returns 1 when a sample was read, 0 at the end of the input or when the
+ * reader was stopped.
+ */
+int fft_eval_reader_next(struct fft_eval_reader *reader,
+			 struct fft_eval_sample *sample)
+{
+	struct fft_eval_stats *stats = &reader->stats;
+	const struct fft_sample_tlv *tlv;
+	enum fft_eval_reject reason;
+	enum fft_eval_stage stage;
+	size_t sample_len;
+	size_t ret;
+
+	tlv = (const struct fft_sample_tlv *)reader->raw;
+
+	while (1) {
+		stage = reader_stage(reader, FFT_EVAL_STAGE_READ);
+
+		ret = reader_read(reader, reader->raw, sizeof(*tlv));
+		stats->bytes_read += ret;
+		if (ret < sizeof(*tlv)) {
+			if (ret > 0 && !reader_stopped(reader)) {
+				fprintf(stderr, "Found incomplete TLV header at position 0x%zx\n", reader->pos);
+				stats->counts.tlvs++;
+				stats->counts.rejected[FFT_EVAL_REJECT_SHORT_HEADER]++;
+			}
 			break;
 		}
 
-		if (sample_len > sizeof(*result)) {
-			fprintf(stderr, "sample length %zu too long\n", sample_len);
+		sample_len = sizeof(*tlv) + fft_eval_tlv_length(tlv);
+		ret = reader_read(reader, reader->raw + sizeof(*tlv),
+				  sample_len - sizeof(*tlv));
+		stats->bytes_read += ret;
+		if (ret < sample_len - sizeof(*tlv)) {
+			if (reader_stopped(reader))
+				break;
+
+			fprintf(stderr, "Found incomplete TLV at position 0x%zx\n", reader->pos);
+			stats->counts.tlvs++;
+			stats->counts.rejected[FFT_EVAL_REJECT_TRUNCATED]++;
+			break;
+		}
+
+		reader->pos += sample_len;
+
+		reader_stage(reader, FFT_EVAL_STAGE_PARSE);
+
+		reason = fft_eval_select_tlv(tlv, sample_len);
+		fft_eval_count_tlv(&stats->counts, tlv, sample_len, reason);
+		if (reason != FFT_EVAL_ACCEPT) {
+			fft_eval_report_reject(stats, tlv, sample_len, reason);
+			reader_stage(reader, stage);
 			continue;
 		}
 
-		result = malloc(sizeof(*result));
-		if (!result)
+		if (fft_eval_sampling_active() &&
+		    !fft_eval_sampler_keep(&reader->sampler, tlv,
+					   reader->pos - sample_len)) {
+			stats->decimated++;
+			reader_stage(reader, stage);
 			continue;
+		}
 
-		memset(result, 0, sizeof(*result));
-		memcpy(&result->sample, tlv, sample_len);
+		fft_eval_decode_tlv(tlv, sample_len, reader->buf, sample);
+		sample->pos = reader->pos - sample_len;
 
-		handled = 0;
-		switch (tlv->type) {
-		case ATH_FFT_SAMPLE_HT20:
-			if (sample_len != sizeof(result->sample.ht20)) {
-				fprintf(stderr, "wrong sample length (have %zd, expected %zd)\n",
-					sample_len, sizeof(result->sample.ht20));
-				break;
-			}
+		reader_stage(reader, stage);
 
-			CONVERT_BE16(result->sample.ht20.freq);
-			CONVERT_BE16(result->sample.ht20.max_magnitude);
-			CONVERT_BE64(result->sample.ht20.tsf);
+		reader->samples++;
+		return 1;
+	}
 
-			handled = 1;
-			break;
-		case ATH_FFT_SAMPLE_HT20_40:
-			if (sample_len != sizeof(result->sample.ht40)) {
-				fprintf(stderr, "wrong sample length (have %zd, expected %zd)\n",
-					sample_len, sizeof(result->sample.ht40));
-				break;
-			}
+	reader_stage(reader, stage);
+	report_suppressed(stats, 0);
+	report_filtered(&stats->counts, 0, 0);
 
-			CONVERT_BE16(result->sample.ht40.freq);
-			CONVERT_BE64(result->sample.ht40.tsf);
-			CONVERT_BE16(result->sample.ht40.lower_max_magnitude);
-			CONVERT_BE16(result->sample.ht40.upper_max_magnitude);
+	return 0;
+}
 
-			handled = 1;
-			break;
-		case ATH_FFT_SAMPLE_ATH10K:
-			if (sample_len < sizeof(result->sample.ath10k.header)) {
-				fprintf(stderr, "wrong sample length (have %zd, expected at least %zd)\n",
-					sample_len, sizeof(result->sample.ath10k.header));
-				break;
-			}
+/*
+ * fft_eval_reader_close - closes the input and adds the reader's counters
+ *
+ * Must be called from the main thread, after the thread which used the
+ * reader ended.
+ */
+void fft_eval_reader_close(struct fft_eval_reader *reader)
+{
+#if !defined(_WIN32)
+	if (reader->fp && reader->fd_flags >= 0)
+		fcntl(fileno(reader->fp), F_SETFL, reader->fd_flags);
+#endif
 
-			bins = sample_len - sizeof(result->sample.ath10k.header);
+	if (reader->fp && reader->fp != stdin)
+		fclose(reader->fp);
 
-			if (bins != 64 &&
-			    bins != 128 &&
-			    bins != 256) {
-				fprintf(stderr, "invalid bin length %d\n", bins);
-				break;
-			}
+	reader->fp = NULL;
 
-			/*
-			 * Zero noise level should not happen in a real environment
-			 * but some datasets contain it which creates bogus results.
-			 */
-			if (result->sample.ath10k.header.noise == 0)
-				break;
+	fft_eval_stats_add(&fft_eval_stats, &reader->stats);
+	memset(&reader->stats, 0, sizeof(reader->stats));
+}
 
-			CONVERT_BE16(result->sample.ath10k.header.freq1);
-			CONVERT_BE16(result->sample.ath10k.header.freq2);
-			CONVERT_BE16(result->sample.ath10k.header.noise);
-			CONVERT_BE16(result->sample.ath10k.header.max_magnitude);
-			CONVERT_BE16(result->sample.ath10k.header.total_gain_db);
-			CONVERT_BE16(result->sample.ath10k.header.base_pwr_db);
-			CONVERT_BE64(result->sample.ath10k.header.tsf);
+/*
+ * parse_range - parses "first:last", "first:", ":last" or "value"
+ *
+ * @arg: option argument
+ * @first: returns the first accepted value, 0 when omitted
+ * @last: returns the last accepted value, limit when omitted
+ * @limit: largest allowed value
+ *
+ * returns 0 on success, -1 if arg is not a valid range.
+ */
+static int parse_range(const char *arg, u64 *first, u64 *last, u64 limit)
+{
+	const char *colon = strchr(arg, ':');
+	char *end;
 
-			handled = 1;
-			break;
-		case ATH_FFT_SAMPLE_ATH11K:
-			if (sample_len < sizeof(result->sample.ath11k.header)) {
-				fprintf(stderr, "wrong sample length (have %zd, expected at least %zd)\n",
-					sample_len, sizeof(result->sample.ath11k.header));
-				break;
-			}
+	*first = 0;
+	*last = limit;
 
-			bins = sample_len - sizeof(result->sample.ath11k.header);
+	if (*arg != ':') {
+		errno = 0;
+		*first = strtoull(arg, &end, 0);
+		if (errno || end == arg || end != (colon ? colon : arg + strlen(arg)))
+			return -1;
+	}
 
-			if (bins != 16 &&
-			    bins != 32 &&
-			    bins != 64 &&
-			    bins != 128 &&
-			    bins != 256 &&
-			    bins != 512) {
-				fprintf(stderr, "invalid bin length %d\n", bins);
-				break;
-			}
+	if (!colon) {
+		*last = *first;
+	} else if (colon[1] != '\0') {
+		errno = 0;
+		*last = strtoull(colon + 1, &end, 0);
+		if (errno || *end != '\0')
+			return -1;
+	}
+
+	if (*first > *last || *last > limit)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * parse_types - parses a comma separated list of sample types
+ *
+ * returns the bit mask of the types, 0 if a type is unknown.
+ */
+static unsigned int parse_types(const char *arg)
+{
+	static const char * const names[] = {
+		[ATH_FFT_SAMPLE_HT20] = "ht20",
+		[ATH_FFT_SAMPLE_HT20_40] = "ht20_40",
+		[ATH_FFT_SAMPLE_ATH10K] = "ath10k",
+		[ATH_FFT_SAMPLE_ATH11K] = "ath11k",
+	};
+	unsigned int types = 0;
+	size_t len;
+	size_t i;
 
-			/*
-			 * Zero noise level should not happen in a real environment
-			 * but some datasets contain it which creates bogus results.
-			 */
-			if (result->sample.ath11k.header.noise == 0)
+	while (*arg) {
+		len = strcspn(arg, ",");
+
+		for (i = ATH_FFT_SAMPLE_HT20; i < FFT_EVAL_NUM_TYPES; i++) {
+			if (strlen(names[i]) == len &&
+			    strncmp(arg, names[i], len) == 0)
 				break;
+		}
 
-			CONVERT_BE16(result->sample.ath11k.header.freq1);
-			CONVERT_BE16(result->sample.ath11k.header.freq2);
-			CONVERT_BE16(result->sample.ath11k.header.max_magnitude);
-			CONVERT_BE16(result->sample.ath11k.header.rssi);
-			CONVERT_BE32(result->sample.ath11k.header.tsf);
-			CONVERT_BE32(result->sample.ath11k.header.noise);
+		if (i == FFT_EVAL_NUM_TYPES)
+			return 0;
 
-			handled = 1;
-			break;
-		default:
-			fprintf(stderr, "unknown sample type (%d)\n", tlv->type);
+		types |= 1U << i;
+		arg += len;
+		if (*arg == ',')
+			arg++;
+	}
+
+	return types;
+}
+
+/*
+ * fft_eval_parse_option - handles the options shared by all frontends
+ *
+ * @ch: option character returned by getopt() or getopt_long()
+ * @arg: option argument
+ *
+ * returns 0 if the option was handled, -1 if it is unknown or invalid.
+ */
+int fft_eval_parse_option(int ch, const char *arg)
+{
+	struct fft_eval_filter *filter = &fft_eval_config.filter;
+	struct fft_eval_sampling *sampling = &fft_eval_config.sampling;
+	u64 first, last;
+	long val;
+	char *end;
+
+	switch (ch) {
+	case 'j':
+		fft_eval_config.threads = strtol(arg, &end, 0);
+		if (*end != '\0' || fft_eval_config.threads < 0)
+			return -1;
+		break;
+	case FFT_EVAL_OPT_STATS:
+		fft_eval_config.stats = 1;
+		fft_eval_config.stats_file = arg;
+		break;
+	case FFT_EVAL_OPT_CACHE:
+		fft_eval_config.cache = 1;
+		fft_eval_config.cache_dir = arg;
+		break;
+	case FFT_EVAL_OPT_TYPE:
+		filter->types = parse_types(arg);
+		if (!filter->types)
+			return -1;
+		filter->active |= FFT_EVAL_FILTER_TYPE;
+		break;
+	case FFT_EVAL_OPT_FREQ:
+		if (parse_range(arg, &first, &last, UINT16_MAX) < 0)
+			return -1;
+		filter->freq_min = first;
+		filter->freq_max = last;
+		filter->active |= FFT_EVAL_FILTER_FREQ;
+		break;
+	case FFT_EVAL_OPT_TSF:
+		if (parse_range(arg, &first, &last, UINT64_MAX) < 0)
+			return -1;
+		filter->tsf_min = first;
+		filter->tsf_max = last;
+		filter->active |= FFT_EVAL_FILTER_TSF;
+		break;
+	case FFT_EVAL_OPT_MIN_RSSI:
+		val = strtol(arg, &end, 0);
+		if (*end != '\0' || end == arg || val < INT16_MIN || val > UINT16_MAX)
+			return -1;
+		filter->rssi_min = val;
+		filter->active |= FFT_EVAL_FILTER_RSSI;
+		break;
+	case FFT_EVAL_OPT_BINS:
+		val = strtol(arg, &end, 0);
+		if (*end != '\0' || val <= 0 || val > SPECTRAL_ATH11K_MAX_NUM_BINS)
+			return -1;
+		filter->bins = val;
+		filter->active |= FFT_EVAL_FILTER_BINS;
+		break;
+	case FFT_EVAL_OPT_WIDTH:
+		val = strtol(arg, &end, 0);
+		if (*end != '\0' || val <= 0 || val > UINT8_MAX)
+			return -1;
+		filter->chan_width = val;
+		filter->active |= FFT_EVAL_FILTER_WIDTH;
+		break;
+	case FFT_EVAL_OPT_EVERY:
+		sampling->every = strtoull(arg, &end, 0);
+		if (*end != '\0' || end == arg || sampling->every == 0)
+			return -1;
+		break;
+	case FFT_EVAL_OPT_BUCKET:
+		sampling->bucket_max = strtoull(arg, &end, 0);
+		if (*end != '/' || end == arg || sampling->bucket_max == 0)
+			return -1;
+		arg = end + 1;
+		sampling->bucket_len = strtoull(arg, &end, 0);
+		if (*end != '\0' || end == arg || sampling->bucket_len == 0)
+			return -1;
+		break;
+	case FFT_EVAL_OPT_RESERVOIR:
+		sampling->reservoir = strtoull(arg, &end, 0);
+		if (*end != '\0' || end == arg || sampling->reservoir == 0 ||
+		    sampling->reservoir > SIZE_MAX / sizeof(u64))
+			return -1;
+		break;
+	default:
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * parse_threads - number of threads used to parse a dump of len bytes
+ *
+ * Each thread gets at least PARSE_CHUNK_MIN bytes when the number of threads
+ * is chosen automatically. Thread start-up and chunk synchronization are
+ * not worth it for smaller dumps.
+ */
+#define PARSE_CHUNK_MIN		(4 * 1024 * 1024)
+#define PARSE_CHUNK_MIN_FORCED	1024
+
+static int parse_threads(size_t len)
+{
+	size_t chunk_min = PARSE_CHUNK_MIN_FORCED;
+	long threads = fft_eval_config.threads;
+
+	if (threads == 0) {
+		chunk_min = PARSE_CHUNK_MIN;
+#if defined(_SC_NPROCESSORS_ONLN)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	}
+
+	if ((size_t)threads > len / chunk_min)
+		threads = len / chunk_min;
+
+	if (threads < 1)
+		threads = 1;
+
+	return threads;
+}
+
+/* counts_since - TLVs counted since the counts were before */
+static void counts_since(struct fft_eval_counts *dst,
+			 const struct fft_eval_counts *now,
+			 const struct fft_eval_counts *before)
+{
+	size_t i;
+
+	dst->tlvs = now->tlvs - before->tlvs;
+
+	for (i = 0; i < FFT_EVAL_NUM_TYPES; i++)
+		dst->accepted[i] = now->accepted[i] - before->accepted[i];
+
+	for (i = 0; i < FFT_EVAL_REJECT_MAX; i++)
+		dst->rejected[i] = now->rejected[i] - before->rejected[i];
+
+	dst->filtered_bytes = now->filtered_bytes - before->filtered_bytes;
+}
+
+/*
+ * fft_eval_init - reads the fft scandata and fills the column store
+ *
+ * @fname: file name
+ *
+ * With --cache, the store is loaded from the cache file of the scanfile
+ * when there is a valid one and the cache file is written otherwise.
+ *
+ * returns 0 on success, -1 on error.
+ */
+int fft_eval_init(char *fname)
+{
+	struct fft_eval_stats *stats = &fft_eval_stats;
+	struct fft_eval_counts before = stats->counts;
+	struct fft_eval_counts counts;
+	u64 suppressed = stats->suppressed;
+	struct fft_eval_sampler sampler;
+	struct fft_eval_cursor cursor;
+	struct fft_eval_map map;
+	const struct fft_sample_tlv *tlv;
+	enum fft_eval_reject reason;
+	enum fft_eval_stage stage;
+	size_t sample_len;
+	u64 kept = 0;
+	int sampling;
+	int threads;
+	int cache;
+	size_t reservoir;
+	int keep;
+	size_t i;
+
+	stage = fft_eval_stage_enter(FFT_EVAL_STAGE_READ);
+
+	sampling = fft_eval_sampling_active();
+
+	/*
+	 * only a store with nothing but this scanfile can be cached, and only
+	 * when no samples were filtered out or sampled
+	 */
+	cache = fft_eval_config.cache && result_store.n == 0 &&
+		!result_store.cache && !fft_eval_config.filter.active &&
+		!sampling;
+
+	if (cache && fft_eval_cache_load(&result_store, fname, &counts) == 0) {
+		fft_eval_counts_add(&stats->counts, &counts);
+		stats->bytes_read += result_store.cache->len;
+		fprintf(stderr, "read %zu scan results (cached)\n", result_store.n);
+		fft_eval_stage_enter(stage);
+		return 0;
+	}
+
+	if (fft_eval_map_file(fname, &map) < 0) {
+		fft_eval_stage_enter(stage);
+		return -1;
+	}
+
+	stats->bytes_read += map.len;
+
+	fft_eval_stage_enter(FFT_EVAL_STAGE_PARSE);
+
+	fft_eval_cursor_init(&cursor, map.data, map.len);
+	fft_eval_sampler_init(&sampler);
+
+	/* sampling decides in file order, which needs a single parser */
+	threads = sampling ? 1 : parse_threads(map.len);
+	if (threads > 1 &&
+	    fft_eval_parse_parallel(map.data, map.len, threads, &result_store,
+				    &cursor.pos) < 0)
+		goto err;
+
+	while (cursor.pos < cursor.len) {
+		tlv = fft_eval_cursor_next(&cursor, &sample_len);
+		if (!tlv)
 			break;
-		}
 
-		if (!handled) {
-			free(result);
+		reason = fft_eval_select_tlv(tlv, sample_len);
+		fft_eval_count_tlv(&stats->counts, tlv, sample_len, reason);
+		if (reason != FFT_EVAL_ACCEPT) {
+			fft_eval_report_reject(stats, tlv, sample_len, reason);
 			continue;
 		}
 
-		if (tail)
-			tail->next = result;
-		else
-			result_list = result;
+		if (sampling) {
+			keep = fft_eval_sampler_keep(&sampler, tlv,
+						     cursor.pos - sample_len);
+			if (keep < 0) {
+				fprintf(stderr, "Couldn't allocate the reservoir\n");
+				goto err;
+			}
+
+			if (!keep)
+				continue;
+		}
+
+		if (fft_eval_store_add(&result_store, tlv, sample_len,
+				       cursor.pos - sample_len) < 0) {
+			fprintf(stderr, "Out of memory while parsing TLV at position 0x%zx\n",
+				cursor.pos - sample_len);
+			goto err;
+		}
+
+		kept++;
+	}
+
+	if (cursor.len - cursor.pos >= sizeof(*tlv)) {
+		fprintf(stderr, "Found incomplete TLV at position 0x%zx\n", cursor.pos);
+		stats->counts.tlvs++;
+		stats->counts.rejected[FFT_EVAL_REJECT_TRUNCATED]++;
+	} else if (cursor.pos != cursor.len) {
+		fprintf(stderr, "Found incomplete TLV header at position 0x%zx\n", cursor.pos);
+		stats->counts.tlvs++;
+		stats->counts.rejected[FFT_EVAL_REJECT_SHORT_HEADER]++;
+	}
 
-		tail = result;
+	/* the reservoir is complete now, decode its samples in file order */
+	reservoir = fft_eval_sampler_finish(&sampler);
+	for (i = 0; i < reservoir; i++) {
+		tlv = (const struct fft_sample_tlv *)(map.data +
+						      sampler.reservoir[i]);
+		sample_len = sizeof(*tlv) + fft_eval_tlv_length(tlv);
 
-		scanresults_n++;
+		if (fft_eval_store_add(&result_store, tlv, sample_len,
+				       sampler.reservoir[i]) < 0) {
+			fprintf(stderr, "Out of memory while parsing TLV at position 0x%zx\n",
+				(size_t)sampler.reservoir[i]);
+			goto err;
+		}
+
+		kept++;
 	}
 
-	fprintf(stderr, "read %d scan results\n", scanresults_n);
-	free(scandata);
+	report_suppressed(stats, suppressed);
+	report_filtered(&stats->counts, before.rejected[FFT_EVAL_REJECT_FILTERED],
+			before.filtered_bytes);
+	if (sampling) {
+		stats->decimated += sampler.seen - kept;
+		fprintf(stderr, "kept %llu of %llu samples\n",
+			(unsigned long long)kept,
+			(unsigned long long)sampler.seen);
+	}
+	fprintf(stderr, "read %zu scan results\n", result_store.n);
+	fft_eval_sampler_free(&sampler);
+	fft_eval_unmap(&map);
+
+	if (cache) {
+		counts_since(&counts, &stats->counts, &before);
+		if (fft_eval_cache_save(&result_store, fname, &counts) < 0)
+			fprintf(stderr, "Couldn't write the cache of %s\n", fname);
+	}
+
+	fft_eval_stage_enter(stage);
 
 	return 0;
+
+err:
+	fft_eval_sampler_free(&sampler);
+	fft_eval_unmap(&map);
+	fft_eval_stage_enter(stage);
+
+	return -1;
 }
 
 void fft_eval_exit(void)
 {
-	struct scanresult *list = result_list;
-	struct scanresult *next;
-
-	while (list) {
-		next = list->next;
-		free(list);
-		list = next;
-	}
-
-	result_list = NULL;
+	fft_eval_store_free(&result_store);
+	fft_eval_stats_report();
 }
 
 void fft_eval_usage(const char *prog)
@@ -288,6 +1481,26 @@ void fft_eval_usage(const char *prog)
 	if (!prog)
 		prog = "fft_eval";
 
+	fprintf(stderr, "\n");
+	fprintf(stderr, "common options:\n");
+	fprintf(stderr, "  -j threads      threads used to parse the scanfile and to draw the samples\n");
+	fprintf(stderr, "                  (default: 0 = one per CPU)\n");
+	fprintf(stderr, "  --stats[=file]  print counters and timings as JSON to stderr or file\n");
+	fprintf(stderr, "  --cache[=dir]   keep parsed scanfiles in dir (default: ~/.cache/fft_eval)\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "filters, samples which don't match are skipped without decoding them:\n");
+	fprintf(stderr, "  --type=list     sample types, e.g. ht20,ht20_40,ath10k,ath11k\n");
+	fprintf(stderr, "  --freq=lo:hi    center frequency in MHz\n");
+	fprintf(stderr, "  --tsf=lo:hi     TSF in microseconds\n");
+	fprintf(stderr, "  --min-rssi=n    lowest RSSI\n");
+	fprintf(stderr, "  --bins=n        number of FFT bins\n");
+	fprintf(stderr, "  --width=mhz     channel width\n");
+	fprintf(stderr, "                  (either end of a range may be omitted, e.g. --freq=5000:)\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "sampling, to keep only a part of the samples of big scanfiles:\n");
+	fprintf(stderr, "  --every=n       every nth sample\n");
+	fprintf(stderr, "  --bucket=n/us   at most n samples in each TSF interval of us microseconds\n");
+	fprintf(stderr, "  --reservoir=n   n random samples of the whole scanfile\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "scanfile is generated by the spectral analyzer feature\n");
 	fprintf(stderr, "of your wifi card. If you have a AR92xx or AR93xx based\n");
@@ -8,12 +8,15 @@
 #ifndef _FFT_EVAL_H
 #define _FFT_EVAL_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 
 typedef int8_t s8;
 typedef uint8_t u8;
 typedef uint16_t u16;
+typedef uint32_t u32;
 typedef uint64_t u64;
 
 enum ath_fft_sample_type {
@@ -143,28 +146,710 @@ struct fft_sample_ath11k {
 #endif
 
 
-struct scanresult {
-	union {
-		struct fft_sample_tlv tlv;
-		struct fft_sample_ht20 ht20;
-		struct fft_sample_ht20_40 ht40;
-		struct {
-			struct fft_sample_ath10k header;
-			u8 data[SPECTRAL_ATH10K_MAX_NUM_BINS];
-		} ath10k;
-		struct {
-			struct fft_sample_ath11k header;
-			u8 data[SPECTRAL_ATH11K_MAX_NUM_BINS];
-		} ath11k;
-	} sample;
-	struct scanresult *next;
+/* longest TLV (header and bins) accepted from a dump */
+#define FFT_EVAL_MAX_SAMPLE_LEN	(sizeof(struct fft_sample_ath11k) + \
+				 SPECTRAL_ATH11K_MAX_NUM_BINS)
+
+/*
+ * decoded sample
+ *
+ * tlv points to a host endian copy of the sample. It has to be casted to the
+ * struct matching type to access fields which are not part of this summary.
+ */
+struct fft_eval_sample {
+	const struct fft_sample_tlv *tlv;
+	const u8 *data;
+	u64 pos;	/* of the TLV in the dump */
+	u64 tsf;
+	int32_t rssi;
+	int32_t noise;
+	u16 freq;
+	u16 bins;
+	u8 type;
+	u8 max_exp;
+	u8 chan_width;
+};
+
+/*
+ * column store of all decoded samples
+ *
+ * The fields needed to walk over all samples are kept in separate arrays
+ * (one entry per sample, in file order). The host endian TLVs are packed
+ * back to back into one arena and each sample only occupies its real length
+ * there. offset points to the start of the TLV of each sample inside the
+ * arena, pos to its start in the dump. For ht40 samples, rssi and noise are
+ * the values of the lower half.
+ *
+ * A store loaded from a cache file points into the mapped file and can't
+ * be changed.
+ */
+struct fft_eval_map;
+
+struct fft_eval_store {
+	size_t n;
+	size_t alloc;
+
+	u64 *tsf;
+	int32_t *rssi;
+	int32_t *noise;
+	u16 *freq;
+	u16 *bins;
+	u8 *type;
+	u8 *max_exp;
+	u8 *chan_width;
+	u64 *pos;
+	size_t *offset;
+
+	u8 *arena;
+	size_t arena_len;
+	size_t arena_alloc;
+
+	struct fft_eval_map *cache;
+};
+
+static inline size_t fft_eval_header_len(u8 type)
+{
+	switch (type) {
+	case ATH_FFT_SAMPLE_HT20:
+		return offsetof(struct fft_sample_ht20, data);
+	case ATH_FFT_SAMPLE_HT20_40:
+		return offsetof(struct fft_sample_ht20_40, data);
+	case ATH_FFT_SAMPLE_ATH10K:
+		return sizeof(struct fft_sample_ath10k);
+	case ATH_FFT_SAMPLE_ATH11K:
+		return sizeof(struct fft_sample_ath11k);
+	default:
+		return sizeof(struct fft_sample_tlv);
+	}
+}
+
+static inline void fft_eval_store_get(const struct fft_eval_store *store,
+				      size_t i, struct fft_eval_sample *sample)
+{
+	const u8 *tlv = store->arena + store->offset[i];
+
+	sample->tlv = (const struct fft_sample_tlv *)tlv;
+	sample->data = tlv + fft_eval_header_len(store->type[i]);
+	sample->pos = store->pos[i];
+	sample->tsf = store->tsf[i];
+	sample->rssi = store->rssi[i];
+	sample->noise = store->noise[i];
+	sample->freq = store->freq[i];
+	sample->bins = store->bins[i];
+	sample->type = store->type[i];
+	sample->max_exp = store->max_exp[i];
+	sample->chan_width = store->chan_width[i];
+}
+
+enum fft_eval_reject {
+	FFT_EVAL_ACCEPT,
+	FFT_EVAL_REJECT_TOO_LONG,
+	FFT_EVAL_REJECT_BAD_LENGTH,
+	FFT_EVAL_REJECT_BAD_BINS,
+	FFT_EVAL_REJECT_ZERO_NOISE,
+	FFT_EVAL_REJECT_UNKNOWN_TYPE,
+
+	/* valid samples which don't match the filters (--freq, --tsf, ...) */
+	FFT_EVAL_REJECT_FILTERED,
+
+	/* incomplete TLVs at the end of the input, found by the parsers */
+	FFT_EVAL_REJECT_SHORT_HEADER,
+	FFT_EVAL_REJECT_TRUNCATED,
+
+	FFT_EVAL_REJECT_MAX,
+};
+
+enum fft_eval_reject fft_eval_check_tlv(const struct fft_sample_tlv *tlv,
+					size_t sample_len);
+u64 fft_eval_tlv_tsf(const struct fft_sample_tlv *tlv);
+enum fft_eval_reject fft_eval_filter_tlv(const struct fft_sample_tlv *tlv,
+					 size_t sample_len);
+struct fft_eval_stats;
+
+void fft_eval_report_reject(struct fft_eval_stats *stats,
+			    const struct fft_sample_tlv *tlv,
+			    size_t sample_len, enum fft_eval_reject reason);
+void fft_eval_decode_tlv(const struct fft_sample_tlv *tlv, size_t sample_len,
+			 u8 *out, struct fft_eval_sample *sample);
+int fft_eval_store_add(struct fft_eval_store *store,
+		       const struct fft_sample_tlv *tlv, size_t sample_len,
+		       u64 pos);
+int fft_eval_store_add_sample(struct fft_eval_store *store,
+			      const struct fft_eval_sample *sample);
+int fft_eval_store_append(struct fft_eval_store *store,
+			  const struct fft_eval_store *src);
+void fft_eval_store_free(struct fft_eval_store *store);
+
+int fft_eval_parse_parallel(const u8 *data, size_t len, int threads,
+			    struct fft_eval_store *store, size_t *end);
+
+/*
+ * samples of a store sorted by TSF, to find samples by time. The order is
+ * stable, samples with the same TSF stay in file order.
+ */
+struct fft_eval_tsf_entry {
+	u64 tsf;
+	u64 rnum;
+};
+
+struct fft_eval_index {
+	struct fft_eval_tsf_entry *by_tsf;
+	size_t n;
+};
+
+int fft_eval_index_build(struct fft_eval_index *index,
+			 const struct fft_eval_store *store);
+void fft_eval_index_free(struct fft_eval_index *index);
+size_t fft_eval_index_seek_tsf(const struct fft_eval_index *index, u64 tsf);
+int fft_eval_index_load(struct fft_eval_index *index,
+			const struct fft_eval_store *store, const char *fname);
+int fft_eval_index_save(const struct fft_eval_index *index, const char *fname);
+
+/*
+ * cache of parsed dumps (--cache)
+ */
+struct fft_eval_counts;
+
+int fft_eval_cache_load(struct fft_eval_store *store, const char *fname,
+			struct fft_eval_counts *counts);
+int fft_eval_cache_save(const struct fft_eval_store *store, const char *fname,
+			const struct fft_eval_counts *counts);
+
+/*
+ * raw dump access
+ *
+ * A dump is a sequence of big endian TLVs. fft_eval_map_file() makes the
+ * whole file available as one read-only buffer (mmap()ed when possible) and
+ * the cursor walks the TLVs in place without copying them.
+ */
+struct fft_eval_map {
+	const u8 *data;
+	size_t len;
+	int mapped;
+};
+
+struct fft_eval_cursor {
+	const u8 *data;
+	size_t len;
+	size_t pos;
+};
+
+int fft_eval_map_file(const char *fname, struct fft_eval_map *map);
+void fft_eval_unmap(struct fft_eval_map *map);
+
+void fft_eval_cursor_init(struct fft_eval_cursor *cursor, const void *data,
+			  size_t len);
+const struct fft_sample_tlv *
+fft_eval_cursor_next(struct fft_eval_cursor *cursor, size_t *sample_len);
+u16 fft_eval_tlv_length(const struct fft_sample_tlv *tlv);
+
+/*
+ * statistics (--stats)
+ */
+#define FFT_EVAL_NUM_TYPES	(ATH_FFT_SAMPLE_ATH11K + 1)
+
+enum fft_eval_stage {
+	FFT_EVAL_STAGE_NONE,
+	FFT_EVAL_STAGE_READ,
+	FFT_EVAL_STAGE_PARSE,
+	FFT_EVAL_STAGE_DECODE,
+	FFT_EVAL_STAGE_EMIT,
+	FFT_EVAL_STAGE_RENDER,
+	FFT_EVAL_STAGE_MAX,
+};
+
+struct fft_eval_counts {
+	u64 tlvs;
+	u64 accepted[FFT_EVAL_NUM_TYPES];
+	u64 rejected[FFT_EVAL_REJECT_MAX];
+	u64 filtered_bytes;
+};
+
+struct fft_eval_stats {
+	struct fft_eval_counts counts;
+	u64 bytes_read;
+	u64 reported;
+	u64 suppressed;
+	u64 dropped;	/* samples which didn't fit into the ring */
+	u64 decimated;	/* samples not kept by --every, --bucket, --reservoir */
+
+	/* seconds spent in each stage */
+	double wall[FFT_EVAL_STAGE_MAX];
+	double cpu[FFT_EVAL_STAGE_MAX];
+
+	enum fft_eval_stage stage;
+	double stage_wall;
+	double stage_cpu;
+};
+
+extern struct fft_eval_stats fft_eval_stats;
+
+/*
+ * sampling of oversized dumps (--every, --bucket, --reservoir)
+ *
+ * Decides which of the accepted TLVs are kept, before they are decoded.
+ * TLVs chosen for the reservoir are only known at the end of the dump,
+ * their positions are collected in reservoir.
+ */
+struct fft_eval_sampler {
+	u64 seen;		/* TLVs passed to the sampler */
+	u64 every;		/* TLVs since the last one kept by --every */
+	u64 bucket;		/* current TSF interval of --bucket */
+	u64 in_bucket;		/* TLVs kept in the current interval */
+	u64 offered;		/* TLVs offered to the reservoir */
+	u64 rand;		/* state of the reservoir PRNG */
+	u64 *reservoir;		/* positions of the chosen TLVs */
+	size_t n;
+	size_t size;
+};
+
+int fft_eval_sampling_active(void);
+void fft_eval_sampler_init(struct fft_eval_sampler *sampler);
+void fft_eval_sampler_free(struct fft_eval_sampler *sampler);
+int fft_eval_sampler_keep(struct fft_eval_sampler *sampler,
+			  const struct fft_sample_tlv *tlv, u64 pos);
+size_t fft_eval_sampler_finish(struct fft_eval_sampler *sampler);
+
+/*
+ * sequential reader for dumps which are consumed while they are written
+ * (stdin, pipes, FIFOs). Only the current TLV is buffered.
+ *
+ * The counters of a reader are kept in its own stats and only added to
+ * fft_eval_stats when it is closed, so it can run in another thread.
+ */
+
+/* wait for more data at the end of the input instead of stopping */
+#define FFT_EVAL_READER_FOLLOW		(1 << 0)
+/* used by another thread than main, don't account the time for --stats */
+#define FFT_EVAL_READER_NOSTATS		(1 << 1)
+
+/* interval in which the end of the input is polled with FOLLOW */
+#define FFT_EVAL_READER_POLL_US		(20 * 1000)
+
+struct fft_eval_reader {
+	FILE *fp;
+	unsigned int flags;	/* FFT_EVAL_READER_*, set after opening */
+	size_t pos;
+	size_t samples;
+	int stop;		/* set by fft_eval_reader_stop() */
+	int fd_flags;		/* of the input before O_NONBLOCK, -1 if unchanged */
+	int nonblock;		/* input was checked by reader_nonblock() */
+	/* called before waiting for more input, set after opening */
+	void (*idle)(void *arg);
+	void *idle_arg;
+	struct fft_eval_stats stats;	/* merged by fft_eval_reader_close() */
+	struct fft_eval_sampler sampler;
+	u8 raw[sizeof(struct fft_sample_tlv) + UINT16_MAX];
+	u8 buf[FFT_EVAL_MAX_SAMPLE_LEN];
+};
+
+int fft_eval_reader_open(struct fft_eval_reader *reader, const char *fname);
+int fft_eval_reader_next(struct fft_eval_reader *reader,
+			 struct fft_eval_sample *sample);
+void fft_eval_reader_stop(struct fft_eval_reader *reader);
+void fft_eval_reader_close(struct fft_eval_reader *reader);
+
+/*
+ * lock-free ring to hand decoded samples from one reader thread to the main
+ * loop. When it is full, the oldest sample is dropped to make room.
+ */
+#define FFT_EVAL_RING_SIZE	4096	/* samples, power of two */
+
+struct fft_eval_ring_slot {
+	struct fft_eval_sample sample;	/* points into buf */
+	u8 buf[FFT_EVAL_MAX_SAMPLE_LEN];
+};
+
+struct fft_eval_ring {
+	struct fft_eval_ring_slot *slots;
+	size_t mask;
+
+	/* number of samples ever pushed and ever taken out or dropped */
+	size_t head;
+	size_t tail;
+
+	u64 dropped;
+};
+
+int fft_eval_ring_init(struct fft_eval_ring *ring, size_t size);
+void fft_eval_ring_free(struct fft_eval_ring *ring);
+void fft_eval_ring_push(struct fft_eval_ring *ring,
+			const struct fft_eval_sample *sample);
+int fft_eval_ring_pop(struct fft_eval_ring *ring,
+		      struct fft_eval_ring_slot *slot);
+u64 fft_eval_ring_dropped(struct fft_eval_ring *ring);
+
+/*
+ * spectrum decoding
+ *
+ * datamax and datamin are the largest and smallest squared (shifted) bin,
+ * datasquaresum[1] is only used for the upper half of ht20_40 samples.
+ */
+#define FFT_EVAL_DECODE_HT20_20MHZ	(1 << 0)
+/* ath11k bins without max_exp, like the output of fft_eval_json */
+#define FFT_EVAL_DECODE_ATH11K_RAW	(1 << 1)
+/* called by a worker thread, don't account the time for --stats */
+#define FFT_EVAL_DECODE_NOSTATS		(1 << 2)
+
+struct fft_eval_spectrum {
+	int bins;
+	double datasquaresum[2];
+	double datamax;
+	double datamin;
+	float freq[SPECTRAL_ATH11K_MAX_NUM_BINS];
+	float signal[SPECTRAL_ATH11K_MAX_NUM_BINS];
+};
+
+int fft_eval_decode(const struct fft_eval_sample *sample,
+		    struct fft_eval_spectrum *spectrum, unsigned int flags);
+int fft_eval_decode_span(const struct fft_eval_sample *sample,
+			 unsigned int flags, float *low, float *high);
+
+/*
+ * buffered output
+ *
+ * precision is the number of decimals written for the frequency and signal
+ * of each bin; the default of 6 matches printf("%f").
+ */
+struct fft_eval_writer {
+	int fd;
+	int error;
+	int precision;
+	char *buf;
+	size_t len;
+	size_t size;
+	u64 written;
+};
+
+#define FFT_EVAL_WRITER_SIZE	(1024 * 1024)
+
+int fft_eval_writer_init(struct fft_eval_writer *writer, int fd, size_t size);
+int fft_eval_writer_flush(struct fft_eval_writer *writer);
+int fft_eval_writer_free(struct fft_eval_writer *writer);
+void fft_eval_write(struct fft_eval_writer *writer, const void *data,
+		    size_t len);
+void fft_eval_write_str(struct fft_eval_writer *writer, const char *str);
+void fft_eval_write_u64(struct fft_eval_writer *writer, u64 value);
+void fft_eval_write_int(struct fft_eval_writer *writer, int64_t value);
+void fft_eval_write_float(struct fft_eval_writer *writer, float value,
+			  int precision);
+void fft_eval_write_json(struct fft_eval_writer *writer,
+			 const struct fft_eval_sample *sample,
+			 const struct fft_eval_spectrum *spectrum);
+
+#define fft_eval_write_lit(writer, str) \
+	fft_eval_write(writer, str, sizeof(str) - 1)
+
+/*
+ * columnar export
+ */
+#define FFT_EVAL_ARROW_BATCH_ROWS	4096
+
+int fft_eval_write_arrow(struct fft_eval_writer *writer,
+			 const struct fft_eval_store *store, size_t batch_rows,
+			 int stream);
+
+/*
+ * spectrum plot
+ *
+ * 32 bit pixels, x is the frequency (X_SCALE pixels per MHz) and y the
+ * signal (Y_SCALE pixels per dB).
+ */
+#define FFT_EVAL_RMASK		0x000000ff
+#define FFT_EVAL_RBITS		0
+#define FFT_EVAL_GMASK		0x0000ff00
+#define FFT_EVAL_GBITS		8
+#define FFT_EVAL_BMASK		0x00ff0000
+#define FFT_EVAL_BBITS		16
+#define FFT_EVAL_AMASK		0xff000000
+
+#define FFT_EVAL_X_SCALE	10
+#define FFT_EVAL_Y_SCALE	4
+
+/* frequency range which can be shown, in MHz */
+#define FFT_EVAL_MIN_FREQ	2300
+#define FFT_EVAL_MAX_FREQ	6000
+
+struct fft_eval_canvas {
+	u32 *pixels;
+	int width;
+	int height;
+	int color_invert;
+};
+
+void fft_eval_render_background(struct fft_eval_canvas *canvas, int startfreq);
+void fft_eval_render_sample(struct fft_eval_canvas *canvas,
+			    const struct fft_eval_spectrum *spectrum,
+			    float startfreq, int highlight);
+
+/*
+ * samples sorted by the frequency range of their bins, to find the samples
+ * shown in a part of the spectrum without decoding all of them
+ */
+struct fft_eval_freq_span {
+	float low;
+	float high;
+	size_t rnum;
+};
+
+struct fft_eval_freq_index {
+	struct fft_eval_freq_span *spans;	/* sorted by low */
+	size_t n;
+	float max_width;
 };
 
+int fft_eval_freq_index_build(struct fft_eval_freq_index *index,
+			      const struct fft_eval_store *store,
+			      unsigned int flags);
+int fft_eval_freq_index_build_range(struct fft_eval_freq_index *index,
+				    const struct fft_eval_store *store,
+				    size_t first, size_t end,
+				    unsigned int flags);
+void fft_eval_freq_index_free(struct fft_eval_freq_index *index);
+size_t fft_eval_freq_index_start(const struct fft_eval_freq_index *index,
+				 float low);
+int fft_eval_freq_index_next(const struct fft_eval_freq_index *index,
+			     size_t *pos, float low, float high, size_t *rnum);
+
+/*
+ * density (persistence) view: number of bins per pixel column and dB, over
+ * the whole frequency range so the view can be moved without counting again
+ */
+#define FFT_EVAL_DENSITY_COLUMNS \
+	((FFT_EVAL_MAX_FREQ - FFT_EVAL_MIN_FREQ) * FFT_EVAL_X_SCALE)
+#define FFT_EVAL_DENSITY_ROWS	163	/* 0 to -162 dBm */
+
+struct fft_eval_density {
+	u32 *count;	/* FFT_EVAL_DENSITY_ROWS rows of all columns */
+	u32 max;
+};
+
+int fft_eval_density_init(struct fft_eval_density *density);
+void fft_eval_density_free(struct fft_eval_density *density);
+void fft_eval_density_add(struct fft_eval_density *density,
+			  const struct fft_eval_spectrum *spectrum);
+void fft_eval_render_density(struct fft_eval_canvas *canvas,
+			     const struct fft_eval_density *density,
+			     int startfreq);
+
+/* power range of the palette of the waterfall view, in dBm */
+#define FFT_EVAL_ROW_MIN_DBM	-120
+#define FFT_EVAL_ROW_MAX_DBM	-20
+
+void fft_eval_render_row(u32 *pixels, int width,
+			 const struct fft_eval_spectrum *spectrum,
+			 float startfreq, int color_invert);
+
+/*
+ * minimum, maximum and mean signal over the frequency range at several
+ * resolutions, to draw any part of the spectrum at any zoom level from a
+ * bounded number of buckets
+ */
+#define FFT_EVAL_PYRAMID_RES		10	/* level 0 buckets per MHz */
+#define FFT_EVAL_PYRAMID_BUCKETS \
+	((FFT_EVAL_MAX_FREQ - FFT_EVAL_MIN_FREQ) * FFT_EVAL_PYRAMID_RES)
+#define FFT_EVAL_PYRAMID_LEVELS		16
+
+struct fft_eval_bucket {
+	float min;
+	float max;
+	double sum;
+	u32 count;
+};
+
+struct fft_eval_pyramid {
+	struct fft_eval_bucket *level[FFT_EVAL_PYRAMID_LEVELS];
+	size_t len[FFT_EVAL_PYRAMID_LEVELS];
+
+	/* level 0 buckets changed since the last update */
+	size_t dirty_first;
+	size_t dirty_last;
+};
+
+int fft_eval_pyramid_init(struct fft_eval_pyramid *pyramid);
+void fft_eval_pyramid_free(struct fft_eval_pyramid *pyramid);
+void fft_eval_pyramid_add(struct fft_eval_pyramid *pyramid,
+			  const struct fft_eval_spectrum *spectrum);
+void fft_eval_pyramid_update(struct fft_eval_pyramid *pyramid);
+void fft_eval_pyramid_query(const struct fft_eval_pyramid *pyramid,
+			    double low, double high,
+			    struct fft_eval_bucket *result);
+
+int fft_eval_grid_step(double scale);
+void fft_eval_render_grid(struct fft_eval_canvas *canvas, double startfreq,
+			  double scale, int step);
+void fft_eval_render_envelope(struct fft_eval_canvas *canvas,
+			      const struct fft_eval_pyramid *pyramid,
+			      double startfreq, double scale);
+
+/*
+ * sum of the translucent samples, not yet clamped to the pixel range
+ *
+ * Samples can be added and removed again, the result is identical to
+ * drawing the remaining samples with fft_eval_render_sample().
+ */
+struct fft_eval_layer {
+	u32 *sum;	/* red, green and blue of every pixel */
+	int width;
+	int height;
+	int color_invert;
+};
+
+int fft_eval_layer_init(struct fft_eval_layer *layer, int width, int height);
+void fft_eval_layer_free(struct fft_eval_layer *layer);
+void fft_eval_layer_clear(struct fft_eval_layer *layer, int color_invert);
+void fft_eval_layer_add(struct fft_eval_layer *layer,
+			const struct fft_eval_spectrum *spectrum,
+			float startfreq, int sign);
+int fft_eval_layer_draw(struct fft_eval_layer *layer,
+			const struct fft_eval_store *store,
+			const struct fft_eval_freq_index *index,
+			float startfreq, size_t skip, int threads);
+void fft_eval_layer_compose(struct fft_eval_canvas *canvas,
+			    const u32 *background,
+			    const struct fft_eval_layer *layer);
+
+/*
+ * image files of a canvas
+ */
+int fft_eval_write_ppm(struct fft_eval_writer *writer,
+		       const struct fft_eval_canvas *canvas);
+int fft_eval_write_png(struct fft_eval_writer *writer,
+		       const struct fft_eval_canvas *canvas);
+
+/*
+ * options shared by all frontends
+ */
+#define FFT_EVAL_FILTER_TYPE	(1 << 0)
+#define FFT_EVAL_FILTER_FREQ	(1 << 1)
+#define FFT_EVAL_FILTER_TSF	(1 << 2)
+#define FFT_EVAL_FILTER_RSSI	(1 << 3)
+#define FFT_EVAL_FILTER_BINS	(1 << 4)
+#define FFT_EVAL_FILTER_WIDTH	(1 << 5)
+
+/* samples to keep, checked on the wire format before a sample is decoded */
+struct fft_eval_filter {
+	unsigned int active;	/* FFT_EVAL_FILTER_* */
+	unsigned int types;	/* bit for each sample type */
+	u16 freq_min;
+	u16 freq_max;
+	u64 tsf_min;
+	u64 tsf_max;
+	int32_t rssi_min;
+	u16 bins;
+	u8 chan_width;
+};
+
+/* subset of the accepted samples to keep, 0 disables a mode */
+struct fft_eval_sampling {
+	u64 every;
+	u64 bucket_max;
+	u64 bucket_len;		/* TSF interval of --bucket */
+	u64 reservoir;
+};
+
+struct fft_eval_config {
+	int threads;
+	int stats;
+	const char *stats_file;
+	int cache;
+	const char *cache_dir;
+	struct fft_eval_filter filter;
+	struct fft_eval_sampling sampling;
+};
+
+#define FFT_EVAL_OPTSTRING	"j:"
+
+/* long options, to be used with getopt_long() */
+#define FFT_EVAL_OPT_STATS	0x100
+#define FFT_EVAL_OPT_CACHE	0x101
+#define FFT_EVAL_OPT_TYPE	0x102
+#define FFT_EVAL_OPT_FREQ	0x103
+#define FFT_EVAL_OPT_TSF	0x104
+#define FFT_EVAL_OPT_MIN_RSSI	0x105
+#define FFT_EVAL_OPT_BINS	0x106
+#define FFT_EVAL_OPT_WIDTH	0x107
+#define FFT_EVAL_OPT_EVERY	0x108
+#define FFT_EVAL_OPT_BUCKET	0x109
+#define FFT_EVAL_OPT_RESERVOIR	0x10a
+
+#define FFT_EVAL_LONGOPTS \
+	{ "stats", optional_argument, NULL, FFT_EVAL_OPT_STATS }, \
+	{ "cache", optional_argument, NULL, FFT_EVAL_OPT_CACHE }, \
+	{ "type", required_argument, NULL, FFT_EVAL_OPT_TYPE }, \
+	{ "freq", required_argument, NULL, FFT_EVAL_OPT_FREQ }, \
+	{ "tsf", required_argument, NULL, FFT_EVAL_OPT_TSF }, \
+	{ "min-rssi", required_argument, NULL, FFT_EVAL_OPT_MIN_RSSI }, \
+	{ "bins", required_argument, NULL, FFT_EVAL_OPT_BINS }, \
+	{ "width", required_argument, NULL, FFT_EVAL_OPT_WIDTH }, \
+	{ "every", required_argument, NULL, FFT_EVAL_OPT_EVERY }, \
+	{ "bucket", required_argument, NULL, FFT_EVAL_OPT_BUCKET }, \
+	{ "reservoir", required_argument, NULL, FFT_EVAL_OPT_RESERVOIR }
+
+int fft_eval_parse_option(int ch, const char *arg);
+
 int fft_eval_init(char *fname);
 void fft_eval_exit(void);
 void fft_eval_usage(const char *prog);
 
-extern struct scanresult *result_list;
-extern int scanresults_n;
+extern struct fft_eval_config fft_eval_config;
+extern struct fft_eval_store result_store;
+
+/*
+ * accounting of the statistics
+ */
+enum fft_eval_stage fft_eval_stage_switch(enum fft_eval_stage stage);
+void fft_eval_counts_add(struct fft_eval_counts *dst,
+			 const struct fft_eval_counts *src);
+void fft_eval_stats_add(struct fft_eval_stats *dst,
+			const struct fft_eval_stats *src);
+void fft_eval_stats_report(void);
+
+/*
+ * fft_eval_stage_enter - accounts the following time to stage
+ *
+ * Must only be called from the main thread.
+ *
+ * returns the previous stage, to be restored when the stage ends.
+ */
+static inline enum fft_eval_stage fft_eval_stage_enter(enum fft_eval_stage stage)
+{
+	if (!fft_eval_config.stats)
+		return FFT_EVAL_STAGE_NONE;
+
+	return fft_eval_stage_switch(stage);
+}
+
+static inline void fft_eval_count_tlv(struct fft_eval_counts *counts,
+				      const struct fft_sample_tlv *tlv,
+				      size_t sample_len,
+				      enum fft_eval_reject reason)
+{
+	counts->tlvs++;
+
+	if (reason == FFT_EVAL_ACCEPT)
+		counts->accepted[tlv->type]++;
+	else
+		counts->rejected[reason]++;
+
+	if (reason == FFT_EVAL_REJECT_FILTERED)
+		counts->filtered_bytes += sample_len;
+}
+
+/*
+ * fft_eval_select_tlv - checks a TLV in wire format and applies the filters
+ *
+ * returns FFT_EVAL_ACCEPT or the reason why the sample has to be skipped.
+ */
+static inline enum fft_eval_reject
+fft_eval_select_tlv(const struct fft_sample_tlv *tlv, size_t sample_len)
+{
+	enum fft_eval_reject reason = fft_eval_check_tlv(tlv, sample_len);
+
+	if (reason == FFT_EVAL_ACCEPT && fft_eval_config.filter.active)
+		reason = fft_eval_filter_tlv(tlv, sample_len);
+
+	return reason;
+}
 
 #endif
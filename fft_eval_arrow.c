@@ -0,0 +1,682 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * SPDX-FileCopyrightText: 2026 Simon Wunderlich <sw@simonwunderlich.de>
+ */
+
+/*
+ * Export of decoded samples in the Arrow IPC stream or file format.
+ *
+ * The stream format is one schema message, the samples in record batches
+ * and an end of stream marker; it can be written to pipes and read with
+ * pyarrow.ipc.open_stream(). The file format wraps the same stream between
+ * the magic "ARROW1" and a footer which contains the schema again and the
+ * position of every record batch. All column buffers are 8 byte aligned,
+ * so a consumer can memory map the file and use the columns in place.
+ *
+ * The metadata of Arrow is encoded as flatbuffers. Only the few tables
+ * needed here are written, by the minimal builder below; see Schema.fbs,
+ * Message.fbs and File.fbs of the Arrow format for their definitions.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fft_eval.h"
+
+#define ARRAY_SIZE(x)	(sizeof(x) / sizeof((x)[0]))
+
+#define ARROW_CONTINUATION	0xffffffffU
+#define ARROW_METADATA_V5	4
+
+/* MessageHeader union */
+#define ARROW_HEADER_SCHEMA		1
+#define ARROW_HEADER_RECORD_BATCH	3
+
+/* Type union */
+#define ARROW_TYPE_INT		2
+#define ARROW_TYPE_FLOAT	3
+#define ARROW_TYPE_LIST		12
+
+#define ARROW_PRECISION_SINGLE	1
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define ARROW_ENDIANNESS	1
+#else
+#define ARROW_ENDIANNESS	0
+#endif
+
+/* highest slot number of all written tables + 1 */
+#define FB_MAX_SLOTS		8
+
+/*
+ * flatbuffer builder
+ *
+ * A flatbuffer is built back to front: objects are added to the end of the
+ * buffer first and references point forward to objects which were added
+ * earlier. Positions are stored as distance from the end of the buffer.
+ */
+struct fb_builder {
+	u8 *buf;
+	size_t size;
+	size_t head;
+	size_t minalign;
+	int error;
+
+	size_t table_start;
+	size_t slots[FB_MAX_SLOTS];
+	int num_slots;
+};
+
+static void fb_reset(struct fb_builder *b)
+{
+	b->head = 0;
+	b->minalign = 1;
+}
+
+static void fb_grow(struct fb_builder *b, size_t len)
+{
+	size_t size = b->size ? b->size : 1024;
+	u8 *buf;
+
+	if (b->error || b->size - b->head >= len)
+		return;
+
+	while (size - b->head < len)
+		size *= 2;
+
+	buf = malloc(size);
+	if (!buf) {
+		b->error = 1;
+		return;
+	}
+
+	if (b->head)
+		memcpy(buf + size - b->head, b->buf + b->size - b->head, b->head);
+
+	free(b->buf);
+	b->buf = buf;
+	b->size = size;
+}
+
+static void fb_push(struct fb_builder *b, const void *data, size_t len)
+{
+	fb_grow(b, len);
+	if (b->error)
+		return;
+
+	b->head += len;
+	if (data)
+		memcpy(b->buf + b->size - b->head, data, len);
+	else
+		memset(b->buf + b->size - b->head, 0, len);
+}
+
+/* pads the buffer so that it is aligned to align after additional bytes */
+static void fb_prep(struct fb_builder *b, size_t align, size_t additional)
+{
+	if (align > b->minalign)
+		b->minalign = align;
+
+	fb_push(b, NULL, (~(b->head + additional) + 1) & (align - 1));
+}
+
+static size_t fb_scalar(struct fb_builder *b, u64 value, size_t len)
+{
+	u8 bytes[8];
+	size_t i;
+
+	/* flatbuffers are always little endian */
+	for (i = 0; i < len; i++)
+		bytes[i] = value >> (8 * i);
+
+	fb_prep(b, len, 0);
+	fb_push(b, bytes, len);
+
+	return b->head;
+}
+
+static size_t fb_uoffset(struct fb_builder *b, size_t ref)
+{
+	fb_prep(b, 4, 0);
+
+	return fb_scalar(b, b->head + 4 - ref, 4);
+}
+
+static size_t fb_string(struct fb_builder *b, const char *str)
+{
+	size_t len = strlen(str);
+
+	fb_prep(b, 4, len + 1);
+	fb_push(b, "", 1);
+	fb_push(b, str, len);
+
+	return fb_scalar(b, len, 4);
+}
+
+static void fb_start_vector(struct fb_builder *b, size_t elem_size, size_t n,
+			    size_t align)
+{
+	fb_prep(b, 4, elem_size * n);
+	fb_prep(b, align, elem_size * n);
+}
+
+static size_t fb_end_vector(struct fb_builder *b, size_t n)
+{
+	return fb_scalar(b, n, 4);
+}
+
+static void fb_start_table(struct fb_builder *b)
+{
+	memset(b->slots, 0, sizeof(b->slots));
+	b->num_slots = 0;
+	b->table_start = b->head;
+}
+
+static void fb_slot(struct fb_builder *b, int slot)
+{
+	b->slots[slot] = b->head;
+	if (slot >= b->num_slots)
+		b->num_slots = slot + 1;
+}
+
+static void fb_field_scalar(struct fb_builder *b, int slot, u64 value,
+			    size_t len)
+{
+	fb_scalar(b, value, len);
+	fb_slot(b, slot);
+}
+
+static void fb_field_offset(struct fb_builder *b, int slot, size_t ref)
+{
+	fb_uoffset(b, ref);
+	fb_slot(b, slot);
+}
+
+static size_t fb_end_table(struct fb_builder *b)
+{
+	size_t object, vtable;
+	u32 soffset;
+	int i;
+
+	/* placeholder for the offset to the vtable */
+	object = fb_scalar(b, 0, 4);
+
+	for (i = b->num_slots - 1; i >= 0; i--)
+		fb_scalar(b, b->slots[i] ? object - b->slots[i] : 0, 2);
+	fb_scalar(b, object - b->table_start, 2);
+	vtable = fb_scalar(b, 4 + 2 * b->num_slots, 2);
+
+	if (b->error)
+		return 0;
+
+	soffset = vtable - object;
+	for (i = 0; i < 4; i++)
+		b->buf[b->size - object + i] = soffset >> (8 * i);
+
+	return object;
+}
+
+static void fb_finish(struct fb_builder *b, size_t root)
+{
+	fb_prep(b, b->minalign, 4);
+	fb_uoffset(b, root);
+}
+
+/*
+ * Arrow schema
+ */
+struct arrow_column {
+	const char *name;
+	u8 type;
+	u8 bits;
+	u8 is_signed;
+};
+
+static const struct arrow_column arrow_columns[] = {
+	{ "tsf",	ARROW_TYPE_INT,		64,	0 },
+	{ "freq",	ARROW_TYPE_INT,		16,	0 },
+	{ "rssi",	ARROW_TYPE_INT,		32,	1 },
+	{ "noise",	ARROW_TYPE_INT,		32,	1 },
+	{ "type",	ARROW_TYPE_INT,		8,	0 },
+	{ "chan_width",	ARROW_TYPE_INT,		8,	0 },
+	{ "start_freq",	ARROW_TYPE_FLOAT,	32,	0 },
+	{ "bin_width",	ARROW_TYPE_FLOAT,	32,	0 },
+	{ "signal",	ARROW_TYPE_LIST,	0,	0 },
+};
+
+static const struct arrow_column arrow_list_item = {
+	"item", ARROW_TYPE_FLOAT, 32, 0,
+};
+
+/* per row: validity + data, the list has one more pair for its items */
+#define ARROW_NODES	(ARRAY_SIZE(arrow_columns) + 1)
+#define ARROW_BUFFERS	(2 * ARROW_NODES)
+
+static size_t arrow_type(struct fb_builder *b, const struct arrow_column *col)
+{
+	fb_start_table(b);
+
+	switch (col->type) {
+	case ARROW_TYPE_INT:
+		fb_field_scalar(b, 0, col->bits, 4);
+		fb_field_scalar(b, 1, col->is_signed, 1);
+		break;
+	case ARROW_TYPE_FLOAT:
+		fb_field_scalar(b, 0, ARROW_PRECISION_SINGLE, 2);
+		break;
+	}
+
+	return fb_end_table(b);
+}
+
+static size_t arrow_field(struct fb_builder *b, const struct arrow_column *col)
+{
+	size_t name, type, children;
+	size_t child = 0;
+
+	if (col->type == ARROW_TYPE_LIST)
+		child = arrow_field(b, &arrow_list_item);
+
+	name = fb_string(b, col->name);
+	type = arrow_type(b, col);
+
+	fb_start_vector(b, 4, child ? 1 : 0, 4);
+	if (child)
+		fb_uoffset(b, child);
+	children = fb_end_vector(b, child ? 1 : 0);
+
+	fb_start_table(b);
+	fb_field_offset(b, 0, name);
+	fb_field_offset(b, 3, type);
+	fb_field_offset(b, 5, children);
+	fb_field_scalar(b, 1, 0, 1);		/* nullable */
+	fb_field_scalar(b, 2, col->type, 1);
+
+	return fb_end_table(b);
+}
+
+static size_t arrow_schema(struct fb_builder *b)
+{
+	size_t fields[ARRAY_SIZE(arrow_columns)];
+	size_t vector;
+	int i;
+
+	for (i = 0; i < (int)ARRAY_SIZE(arrow_columns); i++)
+		fields[i] = arrow_field(b, &arrow_columns[i]);
+
+	fb_start_vector(b, 4, ARRAY_SIZE(fields), 4);
+	for (i = ARRAY_SIZE(fields) - 1; i >= 0; i--)
+		fb_uoffset(b, fields[i]);
+	vector = fb_end_vector(b, ARRAY_SIZE(fields));
+
+	fb_start_table(b);
+	fb_field_offset(b, 1, vector);
+	fb_field_scalar(b, 0, ARROW_ENDIANNESS, 2);
+
+	return fb_end_table(b);
+}
+
+static size_t arrow_message(struct fb_builder *b, u8 header_type,
+			    size_t header, u64 body_len)
+{
+	fb_start_table(b);
+	fb_field_scalar(b, 3, body_len, 8);
+	fb_field_offset(b, 2, header);
+	fb_field_scalar(b, 0, ARROW_METADATA_V5, 2);
+	fb_field_scalar(b, 1, header_type, 1);
+
+	return fb_end_table(b);
+}
+
+/*
+ * Arrow file
+ */
+struct arrow_block {
+	u64 offset;
+	u32 meta_len;
+	u64 body_len;
+};
+
+struct arrow_buffer {
+	const void *data;
+	size_t len;
+};
+
+struct arrow_file {
+	struct fft_eval_writer *writer;
+	struct fb_builder fb;
+
+	struct arrow_block *blocks;
+	size_t num_blocks;
+	size_t alloc_blocks;
+
+	/* list column of the current record batch */
+	int32_t *offsets;
+	float *start_freq;
+	float *bin_width;
+	float *signal;
+	size_t signal_len;
+	size_t signal_alloc;
+};
+
+static const u8 arrow_magic[8] = "ARROW1";
+static const u8 arrow_zero[8];
+
+static void arrow_write_u32(struct arrow_file *file, u32 value)
+{
+	u8 bytes[4];
+	int i;
+
+	for (i = 0; i < 4; i++)
+		bytes[i] = value >> (8 * i);
+
+	fft_eval_write(file->writer, bytes, sizeof(bytes));
+}
+
+static u64 arrow_pos(const struct arrow_file *file)
+{
+	return file->writer->written + file->writer->len;
+}
+
+static void arrow_pad(struct arrow_file *file, size_t len)
+{
+	fft_eval_write(file->writer, arrow_zero, (~len + 1) & 7);
+}
+
+/*
+ * arrow_write_message - writes the flatbuffer in file->fb as message
+ *
+ * returns the length of the message metadata including its prefix.
+ */
+static u32 arrow_write_message(struct arrow_file *file)
+{
+	struct fb_builder *b = &file->fb;
+	u32 len;
+
+	len = (b->head + 7) & ~7;
+	arrow_write_u32(file, ARROW_CONTINUATION);
+	arrow_write_u32(file, len);
+
+	fft_eval_write(file->writer, b->buf + b->size - b->head, b->head);
+	arrow_pad(file, b->head);
+
+	return 8 + len;
+}
+
+static int arrow_add_block(struct arrow_file *file, u64 offset, u32 meta_len,
+			   u64 body_len)
+{
+	struct arrow_block *blocks;
+	size_t alloc;
+
+	if (file->num_blocks == file->alloc_blocks) {
+		alloc = file->alloc_blocks ? file->alloc_blocks * 2 : 64;
+		blocks = realloc(file->blocks, alloc * sizeof(*blocks));
+		if (!blocks)
+			return -1;
+
+		file->blocks = blocks;
+		file->alloc_blocks = alloc;
+	}
+
+	file->blocks[file->num_blocks].offset = offset;
+	file->blocks[file->num_blocks].meta_len = meta_len;
+	file->blocks[file->num_blocks].body_len = body_len;
+	file->num_blocks++;
+
+	return 0;
+}
+
+static int arrow_add_signal(struct arrow_file *file,
+			    const struct fft_eval_spectrum *spectrum)
+{
+	size_t alloc = file->signal_alloc ? file->signal_alloc : 64 * 1024;
+	float *signal;
+
+	if (file->signal_len + spectrum->bins > file->signal_alloc) {
+		while (file->signal_len + spectrum->bins > alloc)
+			alloc *= 2;
+
+		signal = realloc(file->signal, alloc * sizeof(*signal));
+		if (!signal)
+			return -1;
+
+		file->signal = signal;
+		file->signal_alloc = alloc;
+	}
+
+	memcpy(file->signal + file->signal_len, spectrum->signal,
+	       spectrum->bins * sizeof(*signal));
+	file->signal_len += spectrum->bins;
+
+	return 0;
+}
+
+/*
+ * arrow_decode_batch - decodes the list column of rows [first, first + n)
+ *
+ * Samples which cannot be decoded get an empty list and NaN frequencies.
+ */
+static int arrow_decode_batch(struct arrow_file *file,
+			      const struct fft_eval_store *store,
+			      size_t first, size_t n)
+{
+	struct fft_eval_spectrum spectrum;
+	struct fft_eval_sample sample;
+	size_t i;
+
+	file->signal_len = 0;
+	file->offsets[0] = 0;
+
+	for (i = 0; i < n; i++) {
+		fft_eval_store_get(store, first + i, &sample);
+
+		if (fft_eval_decode(&sample, &spectrum,
+				    FFT_EVAL_DECODE_HT20_20MHZ |
+				    FFT_EVAL_DECODE_ATH11K_RAW) < 0) {
+			file->start_freq[i] = NAN;
+			file->bin_width[i] = NAN;
+			file->offsets[i + 1] = file->signal_len;
+			continue;
+		}
+
+		file->start_freq[i] = spectrum.freq[0];
+		if (spectrum.bins > 1)
+			file->bin_width[i] = ((double)spectrum.freq[spectrum.bins - 1] -
+					      spectrum.freq[0]) / (spectrum.bins - 1);
+		else
+			file->bin_width[i] = 0;
+
+		if (arrow_add_signal(file, &spectrum) < 0)
+			return -1;
+
+		file->offsets[i + 1] = file->signal_len;
+	}
+
+	return 0;
+}
+
+static int arrow_write_batch(struct arrow_file *file,
+			     const struct fft_eval_store *store,
+			     size_t first, size_t n)
+{
+	struct arrow_buffer buffers[ARROW_BUFFERS];
+	const void *data[ARRAY_SIZE(arrow_columns)];
+	struct fb_builder *b = &file->fb;
+	size_t nodes, vector, batch;
+	u64 offset[ARROW_BUFFERS];
+	u64 body_len = 0;
+	u64 pos;
+	u32 meta_len;
+	int i;
+
+	if (arrow_decode_batch(file, store, first, n) < 0)
+		return -1;
+
+	data[0] = store->tsf + first;
+	data[1] = store->freq + first;
+	data[2] = store->rssi + first;
+	data[3] = store->noise + first;
+	data[4] = store->type + first;
+	data[5] = store->chan_width + first;
+	data[6] = file->start_freq;
+	data[7] = file->bin_width;
+
+	/* no nulls, so all validity bitmaps are empty */
+	memset(buffers, 0, sizeof(buffers));
+	for (i = 0; i < (int)ARRAY_SIZE(arrow_columns) - 1; i++) {
+		buffers[2 * i + 1].data = data[i];
+		buffers[2 * i + 1].len = n * arrow_columns[i].bits / 8;
+	}
+	buffers[2 * i + 1].data = file->offsets;
+	buffers[2 * i + 1].len = (n + 1) * sizeof(*file->offsets);
+	buffers[2 * i + 3].data = file->signal;
+	buffers[2 * i + 3].len = file->signal_len * sizeof(*file->signal);
+
+	for (i = 0; i < (int)ARROW_BUFFERS; i++) {
+		offset[i] = body_len;
+		body_len += (buffers[i].len + 7) & ~7;
+	}
+
+	fb_reset(b);
+
+	fb_start_vector(b, 16, ARROW_NODES, 8);
+	fb_scalar(b, 0, 8);
+	fb_scalar(b, file->signal_len, 8);
+	for (i = ARROW_NODES - 2; i >= 0; i--) {
+		fb_scalar(b, 0, 8);
+		fb_scalar(b, n, 8);
+	}
+	nodes = fb_end_vector(b, ARROW_NODES);
+
+	fb_start_vector(b, 16, ARROW_BUFFERS, 8);
+	for (i = ARROW_BUFFERS - 1; i >= 0; i--) {
+		fb_scalar(b, buffers[i].len, 8);
+		fb_scalar(b, offset[i], 8);
+	}
+	vector = fb_end_vector(b, ARROW_BUFFERS);
+
+	fb_start_table(b);
+	fb_field_scalar(b, 0, n, 8);
+	fb_field_offset(b, 1, nodes);
+	fb_field_offset(b, 2, vector);
+	batch = fb_end_table(b);
+
+	fb_finish(b, arrow_message(b, ARROW_HEADER_RECORD_BATCH, batch,
+				   body_len));
+	if (b->error)
+		return -1;
+
+	pos = arrow_pos(file);
+	meta_len = arrow_write_message(file);
+
+	for (i = 0; i < (int)ARROW_BUFFERS; i++) {
+		fft_eval_write(file->writer, buffers[i].data, buffers[i].len);
+		arrow_pad(file, buffers[i].len);
+	}
+
+	return arrow_add_block(file, pos, meta_len, body_len);
+}
+
+static int arrow_write_footer(struct arrow_file *file)
+{
+	struct fb_builder *b = &file->fb;
+	size_t schema, blocks, footer;
+	int i;
+
+	fb_reset(b);
+
+	schema = arrow_schema(b);
+
+	fb_start_vector(b, 24, file->num_blocks, 8);
+	for (i = file->num_blocks - 1; i >= 0; i--) {
+		fb_scalar(b, file->blocks[i].body_len, 8);
+		fb_scalar(b, 0, 4);
+		fb_scalar(b, file->blocks[i].meta_len, 4);
+		fb_scalar(b, file->blocks[i].offset, 8);
+	}
+	blocks = fb_end_vector(b, file->num_blocks);
+
+	fb_start_table(b);
+	fb_field_offset(b, 1, schema);
+	fb_field_offset(b, 3, blocks);
+	fb_field_scalar(b, 0, ARROW_METADATA_V5, 2);
+	footer = fb_end_table(b);
+
+	fb_finish(b, footer);
+	if (b->error)
+		return -1;
+
+	fft_eval_write(file->writer, b->buf + b->size - b->head, b->head);
+	arrow_write_u32(file, b->head);
+	fft_eval_write(file->writer, arrow_magic, 6);
+
+	return 0;
+}
+
+/*
+ * fft_eval_write_arrow - writes a store as Arrow IPC stream or file
+ *
+ * @writer: output, the file starts at the current position
+ * @store: samples to export
+ * @batch_rows: maximum number of samples per record batch
+ * @stream: write the stream format without file magic and footer
+ *
+ * returns 0 on success, -1 on error.
+ */
+int fft_eval_write_arrow(struct fft_eval_writer *writer,
+			 const struct fft_eval_store *store, size_t batch_rows,
+			 int stream)
+{
+	struct arrow_file file;
+	size_t first, n;
+	int ret = -1;
+
+	memset(&file, 0, sizeof(file));
+	file.writer = writer;
+
+	file.offsets = malloc((batch_rows + 1) * sizeof(*file.offsets));
+	file.start_freq = malloc(batch_rows * sizeof(*file.start_freq));
+	file.bin_width = malloc(batch_rows * sizeof(*file.bin_width));
+	if (!file.offsets || !file.start_freq || !file.bin_width)
+		goto out;
+
+	if (!stream)
+		fft_eval_write(writer, arrow_magic, sizeof(arrow_magic));
+
+	fb_reset(&file.fb);
+	fb_finish(&file.fb, arrow_message(&file.fb, ARROW_HEADER_SCHEMA,
+					  arrow_schema(&file.fb), 0));
+	if (file.fb.error)
+		goto out;
+
+	arrow_write_message(&file);
+
+	for (first = 0; first < store->n; first += n) {
+		n = store->n - first;
+		if (n > batch_rows)
+			n = batch_rows;
+
+		if (arrow_write_batch(&file, store, first, n) < 0)
+			goto out;
+	}
+
+	/* end of stream */
+	arrow_write_u32(&file, ARROW_CONTINUATION);
+	arrow_write_u32(&file, 0);
+
+	if (!stream && arrow_write_footer(&file) < 0)
+		goto out;
+
+	ret = writer->error ? -1 : 0;
+
+out:
+	free(file.fb.buf);
+	free(file.blocks);
+	free(file.offsets);
+	free(file.start_freq);
+	free(file.bin_width);
+	free(file.signal);
+
+	return ret;
+}
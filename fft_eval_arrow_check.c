@@ -0,0 +1,380 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * SPDX-FileCopyrightText: 2026 Simon Wunderlich <sw@simonwunderlich.de>
+ */
+
+/*
+ * Checks the framing of an Arrow IPC stream or file written by
+ * fft_eval_export and prints the number of rows in its record batches.
+ *
+ * It walks the messages of the stream (continuation marker, metadata
+ * length, flatbuffer metadata, body) up to the end of stream marker. For
+ * the file format it also checks the magic at both ends, the length of the
+ * footer and that the footer lists every record batch of the stream. It
+ * does not use any code of fft_eval_arrow.c, so it is used by "make test"
+ * to check the exporter.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fft_eval.h"
+
+#define ARROW_CONTINUATION	0xffffffffU
+
+/* MessageHeader union */
+#define ARROW_HEADER_SCHEMA		1
+#define ARROW_HEADER_RECORD_BATCH	3
+
+#define BLOCK_SIZE		24
+
+static const u8 arrow_magic[8] = "ARROW1";
+
+struct check_block {
+	u64 offset;
+	u32 meta_len;
+	u64 body_len;
+};
+
+struct check_buf {
+	const u8 *data;
+	size_t len;
+};
+
+static int get_le(const struct check_buf *buf, size_t pos, size_t len,
+		  u64 *value)
+{
+	size_t i;
+
+	if (pos > buf->len || len > buf->len - pos)
+		return -1;
+
+	*value = 0;
+	for (i = 0; i < len; i++)
+		*value |= (u64)buf->data[pos + i] << (8 * i);
+
+	return 0;
+}
+
+/*
+ * fb_field - looks up a field of a flatbuffer table
+ *
+ * returns the position of the field, 0 if it is not set and -1 if the table
+ * is broken.
+ */
+static long fb_field(const struct check_buf *buf, size_t table, int slot)
+{
+	u64 soffset, vtable_len, voffset;
+	size_t vtable;
+
+	if (get_le(buf, table, 4, &soffset) < 0)
+		return -1;
+
+	vtable = table - (int32_t)soffset;
+	if (get_le(buf, vtable, 2, &vtable_len) < 0)
+		return -1;
+
+	if (4 + 2 * (u64)slot >= vtable_len)
+		return 0;
+
+	if (get_le(buf, vtable + 4 + 2 * slot, 2, &voffset) < 0)
+		return -1;
+
+	if (!voffset)
+		return 0;
+
+	return table + voffset;
+}
+
+static long fb_deref(const struct check_buf *buf, long pos)
+{
+	u64 offset;
+
+	if (pos <= 0 || get_le(buf, pos, 4, &offset) < 0)
+		return -1;
+
+	return pos + offset;
+}
+
+static long fb_root(const struct check_buf *buf)
+{
+	u64 offset;
+
+	if (get_le(buf, 0, 4, &offset) < 0)
+		return -1;
+
+	return offset;
+}
+
+static int fb_get(const struct check_buf *buf, size_t table, int slot,
+		  size_t len, u64 *value)
+{
+	long pos = fb_field(buf, table, slot);
+
+	if (pos < 0)
+		return -1;
+
+	if (pos == 0) {
+		*value = 0;
+		return 0;
+	}
+
+	return get_le(buf, pos, len, value);
+}
+
+/*
+ * check_stream - walks the messages of a stream starting at pos
+ *
+ * returns the position after the end of stream marker or -1 if the stream
+ * is broken.
+ */
+static long check_stream(const struct check_buf *file, size_t pos,
+			 struct check_block **blocks, size_t *num_blocks,
+			 u64 *rows)
+{
+	struct check_block *block;
+	struct check_buf meta;
+	u64 cont, len, type, body_len, length;
+	int messages = 0;
+	long root, header;
+
+	while (1) {
+		if (get_le(file, pos, 4, &cont) < 0 ||
+		    get_le(file, pos + 4, 4, &len) < 0) {
+			fprintf(stderr, "truncated message at 0x%zx\n", pos);
+			return -1;
+		}
+
+		if (cont != ARROW_CONTINUATION) {
+			fprintf(stderr, "missing continuation at 0x%zx\n", pos);
+			return -1;
+		}
+
+		if (len == 0)
+			break;
+
+		if (len % 8 || len > file->len - pos - 8) {
+			fprintf(stderr, "invalid metadata length at 0x%zx\n", pos);
+			return -1;
+		}
+
+		meta.data = file->data + pos + 8;
+		meta.len = len;
+
+		root = fb_root(&meta);
+		if (root < 0 ||
+		    fb_get(&meta, root, 1, 1, &type) < 0 ||
+		    fb_get(&meta, root, 3, 8, &body_len) < 0) {
+			fprintf(stderr, "invalid message at 0x%zx\n", pos);
+			return -1;
+		}
+
+		if (body_len % 8 || body_len > file->len - pos - 8 - len) {
+			fprintf(stderr, "invalid body length at 0x%zx\n", pos);
+			return -1;
+		}
+
+		if (messages == 0 && type != ARROW_HEADER_SCHEMA) {
+			fprintf(stderr, "stream doesn't start with a schema\n");
+			return -1;
+		}
+
+		if (type == ARROW_HEADER_RECORD_BATCH) {
+			header = fb_deref(&meta, fb_field(&meta, root, 2));
+			if (header < 0 || fb_get(&meta, header, 0, 8, &length) < 0) {
+				fprintf(stderr, "invalid record batch at 0x%zx\n", pos);
+				return -1;
+			}
+
+			block = realloc(*blocks, (*num_blocks + 1) * sizeof(*block));
+			if (!block)
+				return -1;
+
+			*blocks = block;
+			block += *num_blocks;
+			block->offset = pos;
+			block->meta_len = 8 + len;
+			block->body_len = body_len;
+			(*num_blocks)++;
+
+			*rows += length;
+		}
+
+		messages++;
+		pos += 8 + len + body_len;
+	}
+
+	return pos + 8;
+}
+
+static int check_footer(const struct check_buf *file, size_t pos,
+			const struct check_block *blocks, size_t num_blocks)
+{
+	struct check_buf footer;
+	u64 offset, meta_len, body_len, n;
+	long root, vector;
+	size_t i;
+
+	footer.data = file->data + pos;
+	footer.len = file->len - pos - 10;
+
+	root = fb_root(&footer);
+	if (root < 0)
+		return -1;
+
+	vector = fb_deref(&footer, fb_field(&footer, root, 3));
+	if (vector < 0 || get_le(&footer, vector, 4, &n) < 0)
+		return -1;
+
+	if (n != num_blocks) {
+		fprintf(stderr, "footer lists %llu of %zu record batches\n",
+			(unsigned long long)n, num_blocks);
+		return -1;
+	}
+
+	for (i = 0; i < num_blocks; i++) {
+		pos = vector + 4 + i * BLOCK_SIZE;
+		if (get_le(&footer, pos, 8, &offset) < 0 ||
+		    get_le(&footer, pos + 8, 4, &meta_len) < 0 ||
+		    get_le(&footer, pos + 16, 8, &body_len) < 0)
+			return -1;
+
+		if (offset != blocks[i].offset ||
+		    meta_len != blocks[i].meta_len ||
+		    body_len != blocks[i].body_len) {
+			fprintf(stderr, "footer block %zu doesn't match the stream\n",
+				i);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * check_arrow - checks an Arrow IPC stream or file
+ *
+ * returns 0 if the file is valid, -1 otherwise.
+ */
+static int check_arrow(const struct check_buf *file, u64 *rows)
+{
+	struct check_block *blocks = NULL;
+	size_t num_blocks = 0;
+	u64 footer_len;
+	size_t footer;
+	int is_file;
+	long end;
+	int ret = -1;
+
+	is_file = file->len >= sizeof(arrow_magic) &&
+		  memcmp(file->data, arrow_magic, sizeof(arrow_magic)) == 0;
+
+	end = check_stream(file, is_file ? sizeof(arrow_magic) : 0, &blocks,
+			   &num_blocks, rows);
+	if (end < 0)
+		goto out;
+
+	if (!is_file) {
+		if ((size_t)end != file->len) {
+			fprintf(stderr, "data after the end of stream\n");
+			goto out;
+		}
+
+		ret = 0;
+		goto out;
+	}
+
+	if (file->len - end < 10 ||
+	    memcmp(file->data + file->len - 6, arrow_magic, 6) != 0) {
+		fprintf(stderr, "missing magic at the end of the file\n");
+		goto out;
+	}
+
+	get_le(file, file->len - 10, 4, &footer_len);
+	footer = file->len - 10 - footer_len;
+	if (footer_len > file->len - 10 || footer != (size_t)end) {
+		fprintf(stderr, "footer length %llu doesn't match the stream\n",
+			(unsigned long long)footer_len);
+		goto out;
+	}
+
+	if (check_footer(file, footer, blocks, num_blocks) < 0) {
+		fprintf(stderr, "invalid footer\n");
+		goto out;
+	}
+
+	ret = 0;
+
+out:
+	free(blocks);
+
+	return ret;
+}
+
+static int read_all(FILE *fp, struct check_buf *buf)
+{
+	size_t size = 64 * 1024;
+	u8 *data = NULL;
+	u8 *tmp;
+	size_t n;
+
+	buf->len = 0;
+
+	while (1) {
+		tmp = realloc(data, size);
+		if (!tmp) {
+			free(data);
+			return -1;
+		}
+		data = tmp;
+
+		n = fread(data + buf->len, 1, size - buf->len, fp);
+		buf->len += n;
+		if (buf->len < size)
+			break;
+
+		size *= 2;
+	}
+
+	buf->data = data;
+
+	return ferror(fp) ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct check_buf file;
+	u64 rows = 0;
+	FILE *fp;
+	int ret;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s file (\"-\" for stdin)\n", argv[0]);
+		return 127;
+	}
+
+	if (strcmp(argv[1], "-") == 0)
+		fp = stdin;
+	else
+		fp = fopen(argv[1], "rb");
+
+	if (!fp) {
+		perror(argv[1]);
+		return -1;
+	}
+
+	if (read_all(fp, &file) < 0) {
+		fprintf(stderr, "Couldn't read %s\n", argv[1]);
+		return -1;
+	}
+
+	ret = check_arrow(&file, &rows);
+	if (ret == 0)
+		printf("%llu\n", (unsigned long long)rows);
+
+	free((void *)file.data);
+	if (fp != stdin)
+		fclose(fp);
+
+	return ret;
+}
@@ -0,0 +1,540 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * SPDX-FileCopyrightText: 2026 Simon Wunderlich <sw@simonwunderlich.de>
+ */
+
+/*
+ * Benchmark of the processing stages.
+ *
+ * Every given dump is processed repeatedly, and every stage is timed on its
+ * own:
+ *
+ *  ingest:      reading and parsing the dump into the store
+ *  decode:      converting all samples to dBm
+ *  json:        JSON output through the buffered writer
+ *  json-printf: JSON output with printf as done by older versions
+ *  render:      drawing the samples shown by fft_eval_sdl at the position of
+ *               the first sample, without a window
+ *  cloud:       the same into the layer fft_eval_sdl keeps of the samples,
+ *               using -j threads
+ *  envelope:    drawing the whole frequency range zoomed out from the
+ *               pyramid of the samples
+ *
+ * MB/s is measured on the dump for ingest, decode and render, and on the
+ * output for the JSON stages. Results can be saved and used as baseline for
+ * later runs, which are then reported as regression when they are slower
+ * than the baseline by more than the tolerance.
+ */
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fft_eval.h"
+
+/*
+ * every stage is measured BENCH_ROUNDS times for at least BENCH_TIME seconds
+ * and the fastest round is reported, which hides most of the noise caused
+ * by other processes
+ */
+#define BENCH_ROUNDS	5
+#define BENCH_TIME	0.1
+
+#define BENCH_WIDTH	1600
+#define BENCH_HEIGHT	650
+
+struct bench_result {
+	char file[256];
+	char stage[16];
+	double samples;
+	double mbytes;
+};
+
+static struct bench_result *baseline;
+static size_t baseline_len;
+static double tolerance = 10;
+static FILE *save_fp;
+static int regressions;
+static int failures;
+
+static struct fft_eval_writer out;
+static FILE *out_fp;
+static int null_fd;
+static FILE *ingest_log;
+static int stage_failed;
+static struct fft_eval_canvas canvas;
+static struct fft_eval_freq_index freq_index;
+static struct fft_eval_layer layer;
+static struct fft_eval_pyramid pyramid;
+static const char *ingest_file;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * run_ingest - reads the dump again, like the frontends do at startup
+ *
+ * The messages of fft_eval_init() would be printed for every run, they are
+ * kept in ingest_log and only shown when it fails.
+ */
+static u64 run_ingest(void)
+{
+	char line[256];
+	int log_fd = fileno(ingest_log);
+	int fd;
+	int ret;
+
+	fflush(stderr);
+	fd = dup(STDERR_FILENO);
+	if (ftruncate(log_fd, 0) < 0 || lseek(log_fd, 0, SEEK_SET) < 0)
+		dup2(null_fd, STDERR_FILENO);
+	else
+		dup2(log_fd, STDERR_FILENO);
+
+	fft_eval_exit();
+	ret = fft_eval_init((char *)ingest_file);
+
+	fflush(stderr);
+	dup2(fd, STDERR_FILENO);
+	close(fd);
+
+	if (ret < 0) {
+		rewind(ingest_log);
+		while (fgets(line, sizeof(line), ingest_log))
+			fputs(line, stderr);
+
+		stage_failed = 1;
+	}
+
+	return 0;
+}
+
+static u64 run_decode(void)
+{
+	struct fft_eval_spectrum spectrum;
+	struct fft_eval_sample sample;
+	size_t rnum;
+
+	for (rnum = 0; rnum < result_store.n; rnum++) {
+		fft_eval_store_get(&result_store, rnum, &sample);
+		fft_eval_decode(&sample, &spectrum, FFT_EVAL_DECODE_HT20_20MHZ |
+				FFT_EVAL_DECODE_ATH11K_RAW);
+	}
+
+	return 0;
+}
+
+static u64 run_json(void)
+{
+	struct fft_eval_spectrum spectrum;
+	struct fft_eval_sample sample;
+	u64 start = out.written + out.len;
+	size_t rnum;
+
+	fft_eval_write_lit(&out, "[");
+	for (rnum = 0; rnum < result_store.n; rnum++) {
+		fft_eval_store_get(&result_store, rnum, &sample);
+
+		if (fft_eval_decode(&sample, &spectrum,
+				    FFT_EVAL_DECODE_HT20_20MHZ |
+				    FFT_EVAL_DECODE_ATH11K_RAW) < 0)
+			continue;
+
+		if (rnum > 0)
+			fft_eval_write_lit(&out, ",");
+
+		fft_eval_write_lit(&out, "\n");
+		fft_eval_write_json(&out, &sample, &spectrum);
+	}
+	fft_eval_write_lit(&out, "\n]\n");
+	fft_eval_writer_flush(&out);
+
+	return out.written - start;
+}
+
+/* reference: the formatting of fft_eval_json before the buffered writer */
+static u64 run_json_printf(void)
+{
+	struct fft_eval_spectrum spectrum;
+	struct fft_eval_sample sample;
+	size_t rnum;
+	u64 len = 0;
+	int i;
+
+	len += fprintf(out_fp, "[");
+	for (rnum = 0; rnum < result_store.n; rnum++) {
+		fft_eval_store_get(&result_store, rnum, &sample);
+
+		if (rnum > 0)
+			len += fprintf(out_fp, ",");
+
+		if (sample.type == ATH_FFT_SAMPLE_ATH11K)
+			len += fprintf(out_fp, "\n{ \"tsf\": %08d, \"central_freq\": %d, \"rssi\": %d, \"noise\": %d, \"data\": [ ",
+				       (int)sample.tsf, sample.freq, sample.rssi, sample.noise);
+		else
+			len += fprintf(out_fp, "\n{ \"tsf\": %" PRIu64 ", \"central_freq\": %d, \"rssi\": %d, \"noise\": %d, \"data\": [ ",
+				       sample.tsf, sample.freq, sample.rssi, sample.noise);
+
+		if (fft_eval_decode(&sample, &spectrum, FFT_EVAL_DECODE_HT20_20MHZ |
+				    FFT_EVAL_DECODE_ATH11K_RAW) < 0)
+			break;
+
+		for (i = 0; i < spectrum.bins; i++) {
+			len += fprintf(out_fp, "[ %f, %f ]", spectrum.freq[i], spectrum.signal[i]);
+			if (i < spectrum.bins - 1)
+				len += fprintf(out_fp, ", ");
+		}
+
+		len += fprintf(out_fp, " ] }");
+	}
+	len += fprintf(out_fp, "\n]\n");
+	fflush(out_fp);
+
+	return len;
+}
+
+static u64 run_render(void)
+{
+	struct fft_eval_spectrum spectrum;
+	struct fft_eval_sample sample;
+	int startfreq = FFT_EVAL_MIN_FREQ;
+	float high;
+	size_t rnum;
+	size_t pos;
+
+	/* show the first sample like fft_eval_sdl does */
+	if (result_store.n > 0)
+		startfreq = result_store.freq[0] - 20;
+
+	high = startfreq + BENCH_WIDTH / FFT_EVAL_X_SCALE;
+
+	fft_eval_render_background(&canvas, startfreq);
+
+	pos = fft_eval_freq_index_start(&freq_index, startfreq);
+	while (fft_eval_freq_index_next(&freq_index, &pos, startfreq, high,
+					&rnum)) {
+		fft_eval_store_get(&result_store, rnum, &sample);
+		if (fft_eval_decode(&sample, &spectrum, 0) < 0)
+			continue;
+
+		fft_eval_render_sample(&canvas, &spectrum, startfreq, rnum == 0);
+	}
+
+	return 0;
+}
+
+static u64 run_cloud(void)
+{
+	int startfreq = FFT_EVAL_MIN_FREQ;
+
+	if (result_store.n > 0)
+		startfreq = result_store.freq[0] - 20;
+
+	fft_eval_layer_clear(&layer, 0);
+	fft_eval_layer_draw(&layer, &result_store, &freq_index, startfreq,
+			    result_store.n, fft_eval_config.threads);
+
+	return 0;
+}
+
+static u64 run_envelope(void)
+{
+	double scale = (double)BENCH_WIDTH /
+		       (FFT_EVAL_MAX_FREQ - FFT_EVAL_MIN_FREQ);
+
+	fft_eval_render_grid(&canvas, FFT_EVAL_MIN_FREQ, scale, 500);
+	fft_eval_render_envelope(&canvas, &pyramid, FFT_EVAL_MIN_FREQ, scale);
+
+	return 0;
+}
+
+static int pyramid_build(void)
+{
+	struct fft_eval_spectrum spectrum;
+	struct fft_eval_sample sample;
+	size_t rnum;
+
+	if (fft_eval_pyramid_init(&pyramid) < 0)
+		return -1;
+
+	for (rnum = 0; rnum < result_store.n; rnum++) {
+		fft_eval_store_get(&result_store, rnum, &sample);
+		if (fft_eval_decode(&sample, &spectrum, 0) < 0)
+			continue;
+
+		fft_eval_pyramid_add(&pyramid, &spectrum);
+	}
+	fft_eval_pyramid_update(&pyramid);
+
+	return 0;
+}
+
+static const struct bench_result *find_baseline(const char *file,
+						const char *stage)
+{
+	size_t i;
+
+	for (i = 0; i < baseline_len; i++) {
+		if (strcmp(baseline[i].file, file) == 0 &&
+		    strcmp(baseline[i].stage, stage) == 0)
+			return &baseline[i];
+	}
+
+	return NULL;
+}
+
+static int load_baseline(const char *fname)
+{
+	struct bench_result result, *tmp;
+	size_t alloc = 0;
+	char line[512];
+	FILE *fp;
+
+	fp = fopen(fname, "r");
+	if (!fp) {
+		perror(fname);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%255s %15s %lf %lf", result.file, result.stage,
+			   &result.samples, &result.mbytes) != 4)
+			continue;
+
+		if (baseline_len == alloc) {
+			alloc = alloc ? alloc * 2 : 64;
+			tmp = realloc(baseline, alloc * sizeof(*baseline));
+			if (!tmp) {
+				fclose(fp);
+				return -1;
+			}
+			baseline = tmp;
+		}
+
+		baseline[baseline_len++] = result;
+	}
+
+	fclose(fp);
+
+	return 0;
+}
+
+/*
+ * bench_stage - measures one stage on the samples of a dump
+ *
+ * returns 0 on success, -1 if the stage failed.
+ */
+static int bench_stage(const char *fname, const char *stage, u64 in_bytes,
+		       u64 (*run)(void))
+{
+	const struct bench_result *base;
+	double start, elapsed;
+	double samples = 0, mbytes = 0;
+	u64 out_bytes;
+	u64 runs;
+	char delta[64] = "";
+	int round;
+
+	stage_failed = 0;
+
+	for (round = 0; round < BENCH_ROUNDS; round++) {
+		out_bytes = 0;
+		runs = 0;
+
+		start = now();
+		do {
+			out_bytes += run();
+			runs++;
+		} while (!stage_failed && (elapsed = now() - start) < BENCH_TIME);
+
+		if (stage_failed) {
+			printf("%-44s %-12s failed\n", fname, stage);
+			failures++;
+			return -1;
+		}
+
+		if (runs * result_store.n / elapsed < samples)
+			continue;
+
+		samples = runs * result_store.n / elapsed;
+		if (out_bytes)
+			mbytes = out_bytes / elapsed / 1e6;
+		else
+			mbytes = runs * in_bytes / elapsed / 1e6;
+	}
+
+	base = find_baseline(fname, stage);
+	if (base && base->samples > 0) {
+		snprintf(delta, sizeof(delta), "%+6.1f%%",
+			 (samples / base->samples - 1) * 100);
+
+		if (samples < base->samples * (1 - tolerance / 100)) {
+			strncat(delta, " REGRESSION", sizeof(delta) - strlen(delta) - 1);
+			regressions++;
+		}
+	}
+
+	printf("%-44s %-12s %12.0f samples/s %9.1f MB/s %s\n",
+	       fname, stage, samples, mbytes, delta);
+
+	if (save_fp)
+		fprintf(save_fp, "%s %s %.0f %.1f\n", fname, stage, samples,
+			mbytes);
+
+	return 0;
+}
+
+static void bench_file(const char *fname)
+{
+	struct stat st;
+
+	if (stat(fname, &st) < 0) {
+		perror(fname);
+		return;
+	}
+
+	ingest_file = fname;
+	stage_failed = 0;
+	run_ingest();
+	if (stage_failed) {
+		fprintf(stderr, "%s: couldn't read the scanfile\n", fname);
+		failures++;
+		return;
+	}
+
+	if (result_store.n == 0) {
+		fprintf(stderr, "%s: no samples\n", fname);
+		return;
+	}
+
+	if (bench_stage(fname, "ingest", st.st_size, run_ingest) < 0)
+		return;
+
+	bench_stage(fname, "decode", st.st_size, run_decode);
+	bench_stage(fname, "json", st.st_size, run_json);
+	bench_stage(fname, "json-printf", st.st_size, run_json_printf);
+
+	if (fft_eval_freq_index_build(&freq_index, &result_store, 0) < 0) {
+		fprintf(stderr, "%s: couldn't build frequency index\n", fname);
+		return;
+	}
+
+	bench_stage(fname, "render", st.st_size, run_render);
+	bench_stage(fname, "cloud", st.st_size, run_cloud);
+	fft_eval_freq_index_free(&freq_index);
+
+	if (pyramid_build() < 0) {
+		fprintf(stderr, "%s: couldn't build pyramid\n", fname);
+		return;
+	}
+
+	bench_stage(fname, "envelope", st.st_size, run_envelope);
+	fft_eval_pyramid_free(&pyramid);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-b baseline] [-w results] [-t tolerance] scanfile...\n", prog);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  -b  compare with the results in this file\n");
+	fprintf(stderr, "  -w  save the results to this file\n");
+	fprintf(stderr, "  -t  allowed slowdown in percent before a result is a regression\n");
+	fprintf(stderr, "      (default: %.0f)\n", tolerance);
+	fft_eval_usage(prog);
+}
+
+int main(int argc, char *argv[])
+{
+	struct rusage usage_self;
+	int ch;
+	int i;
+
+	while ((ch = getopt(argc, argv, "b:ht:w:" FFT_EVAL_OPTSTRING)) != -1) {
+		switch (ch) {
+		case 'b':
+			if (load_baseline(optarg) < 0)
+				return -1;
+			break;
+		case 't':
+			tolerance = atof(optarg);
+			break;
+		case 'w':
+			save_fp = fopen(optarg, "w");
+			if (!save_fp) {
+				perror(optarg);
+				return -1;
+			}
+			break;
+		case 'h':
+			usage(argv[0]);
+			exit(127);
+		default:
+			if (fft_eval_parse_option(ch, optarg) == 0)
+				break;
+
+			usage(argv[0]);
+			exit(127);
+		}
+	}
+
+	if (optind >= argc) {
+		usage(argv[0]);
+		return 127;
+	}
+
+	null_fd = open("/dev/null", O_WRONLY);
+	if (null_fd < 0) {
+		perror("/dev/null");
+		return -1;
+	}
+
+	out_fp = fdopen(null_fd, "w");
+	ingest_log = tmpfile();
+	canvas.width = BENCH_WIDTH;
+	canvas.height = BENCH_HEIGHT;
+	canvas.pixels = malloc(BENCH_WIDTH * BENCH_HEIGHT * sizeof(*canvas.pixels));
+	if (!out_fp || !ingest_log || !canvas.pixels ||
+	    fft_eval_layer_init(&layer, BENCH_WIDTH, BENCH_HEIGHT) < 0 ||
+	    fft_eval_writer_init(&out, null_fd, FFT_EVAL_WRITER_SIZE) < 0) {
+		fprintf(stderr, "Couldn't set up output\n");
+		return -1;
+	}
+
+	for (i = optind; i < argc; i++)
+		bench_file(argv[i]);
+
+	fft_eval_exit();
+
+	getrusage(RUSAGE_SELF, &usage_self);
+	printf("peak RSS: %ld KiB\n", usage_self.ru_maxrss);
+
+	if (regressions)
+		printf("%d results are slower than the baseline by more than %.0f%%\n",
+		       regressions, tolerance);
+
+	if (failures)
+		printf("%d stages failed\n", failures);
+
+	fft_eval_writer_free(&out);
+	fclose(out_fp);
+	fclose(ingest_log);
+	free(canvas.pixels);
+	fft_eval_layer_free(&layer);
+	free(baseline);
+
+	if (save_fp)
+		fclose(save_fp);
+
+	return regressions || failures ? 1 : 0;
+}
@@ -0,0 +1,490 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * SPDX-FileCopyrightText: 2026 Simon Wunderlich <sw@simonwunderlich.de>
+ */
+
+/*
+ * Cache of parsed dumps, enabled by --cache.
+ *
+ * After a dump was parsed, the column store is written to
+ * <dir>/<hash of the path>.cache. The next time the same dump is read, the
+ * cache file is mapped and the columns of the store point right into it,
+ * so nothing has to be converted or copied again. Only type, bins and
+ * offset of every sample are checked against the arena once.
+ *
+ * A cache file is only used for the dump with the same path, device, inode,
+ * size, modification time (with nanoseconds) and content hash. Hashing whole multi-GB dumps would
+ * take as long as parsing them, so only the start, the end and
+ * CACHE_HASH_BLOCKS blocks spread over the dump are hashed. Everything is
+ * stored in host byte order:
+ *
+ *   header           struct cache_header
+ *   path             path_len bytes
+ *   tsf[samples]     u64
+ *   pos[samples]     u64
+ *   offset[samples]  size_t
+ *   rssi[samples]    int32_t
+ *   noise[samples]   int32_t
+ *   freq[samples]    u16
+ *   bins[samples]    u16
+ *   type[samples]    u8
+ *   max_exp[samples] u8
+ *   chan_width[samples] u8
+ *   arena            arena_len bytes
+ *
+ * Every part starts at a multiple of 8 bytes.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "fft_eval.h"
+
+#if !defined(_WIN32)
+
+#define CACHE_MAGIC		"FFTCACHE"
+#define CACHE_VERSION		3
+#define CACHE_BYTE_ORDER	0x01020304
+
+#define CACHE_HASH_BLOCKS	16
+#define CACHE_HASH_BLOCK_SIZE	4096
+
+#if defined(__APPLE__)
+#define ST_MTIME_NSEC(st)	((st)->st_mtimespec.tv_nsec)
+#else
+#define ST_MTIME_NSEC(st)	((st)->st_mtim.tv_nsec)
+#endif
+
+struct cache_header {
+	char magic[8];
+	u32 version;
+	u32 byte_order;
+	u32 word_size;
+	u32 path_len;
+
+	u64 dump_dev;
+	u64 dump_ino;
+	u64 dump_size;
+	u64 dump_mtime;
+	u64 dump_mtime_nsec;
+	u64 dump_hash;
+
+	u64 samples;
+	u64 arena_len;
+
+	/* TLVs counted while the dump was parsed, for --stats */
+	struct fft_eval_counts counts;
+};
+
+#define CACHE_ALIGN(len)	(((len) + 7) & ~(size_t)7)
+
+/* FNV-1a */
+static u64 hash_add(u64 hash, const void *data, size_t len)
+{
+	const u8 *p = data;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+#define HASH_INIT	0xcbf29ce484222325ULL
+
+static u64 hash_block(u64 hash, int fd, u64 pos)
+{
+	u8 buf[CACHE_HASH_BLOCK_SIZE];
+	ssize_t ret;
+
+	if (lseek(fd, pos, SEEK_SET) == (off_t)-1)
+		return hash;
+
+	do {
+		ret = read(fd, buf, sizeof(buf));
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret > 0)
+		hash = hash_add(hash, buf, ret);
+
+	return hash;
+}
+
+/*
+ * cache_header_init - fills the key of the cache file of a dump
+ *
+ * @path: absolute path of the dump
+ *
+ * returns 0 on success, -1 when the dump can't be cached.
+ */
+static int cache_header_init(struct cache_header *header, const char *path)
+{
+	struct stat st;
+	u64 hash = HASH_INIT;
+	u64 step;
+	int flags = O_RDONLY;
+	int fd;
+	int i;
+
+#ifdef O_BINARY
+	flags |= O_BINARY;
+#endif
+
+	fd = open(path, flags);
+	if (fd < 0)
+		return -1;
+
+	/* pipes and character devices have no identity */
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return -1;
+	}
+
+	step = st.st_size / (CACHE_HASH_BLOCKS + 1);
+	if (step < CACHE_HASH_BLOCK_SIZE)
+		step = CACHE_HASH_BLOCK_SIZE;
+
+	hash = hash_block(hash, fd, 0);
+	for (i = 1; i <= CACHE_HASH_BLOCKS && step * i < (u64)st.st_size; i++)
+		hash = hash_block(hash, fd, step * i);
+	if ((u64)st.st_size > CACHE_HASH_BLOCK_SIZE)
+		hash = hash_block(hash, fd,
+				  st.st_size - CACHE_HASH_BLOCK_SIZE);
+
+	close(fd);
+
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, CACHE_MAGIC, sizeof(header->magic));
+	header->version = CACHE_VERSION;
+	header->byte_order = CACHE_BYTE_ORDER;
+	header->word_size = sizeof(size_t);
+	header->path_len = strlen(path);
+	header->dump_dev = st.st_dev;
+	header->dump_ino = st.st_ino;
+	header->dump_size = st.st_size;
+	header->dump_mtime = st.st_mtime;
+	header->dump_mtime_nsec = ST_MTIME_NSEC(&st);
+	header->dump_hash = hash;
+
+	return 0;
+}
+
+/*
+ * cache_dir - directory of the cache files
+ *
+ * --cache=dir or $XDG_CACHE_HOME/fft_eval or ~/.cache/fft_eval, which are
+ * created when they don't exist yet.
+ *
+ * returns 0 on success, -1 if there is no directory for the cache.
+ */
+static int cache_dir(char *dir, size_t len)
+{
+	const char *base;
+	int ret;
+
+	if (fft_eval_config.cache_dir) {
+		ret = snprintf(dir, len, "%s", fft_eval_config.cache_dir);
+	} else if ((base = getenv("XDG_CACHE_HOME")) && *base) {
+		ret = snprintf(dir, len, "%s/fft_eval", base);
+	} else if ((base = getenv("HOME")) && *base) {
+		ret = snprintf(dir, len, "%s/.cache", base);
+		if (ret > 0 && (size_t)ret < len)
+			mkdir(dir, 0755);
+		ret = snprintf(dir, len, "%s/.cache/fft_eval", base);
+	} else {
+		return -1;
+	}
+
+	if (ret < 0 || (size_t)ret >= len)
+		return -1;
+
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * cache_name - names the cache file of a dump
+ *
+ * @path: returns the absolute path of the dump
+ * @name: returns the path of the cache file
+ *
+ * returns 0 on success, -1 on error.
+ */
+static int cache_name(const char *fname, char *path, char *name, size_t len)
+{
+	char dir[PATH_MAX];
+	int ret;
+
+	if (!realpath(fname, path))
+		return -1;
+
+	if (cache_dir(dir, sizeof(dir)) < 0)
+		return -1;
+
+	ret = snprintf(name, len, "%s/%016llx.cache", dir,
+		       (unsigned long long)hash_add(HASH_INIT, path,
+						    strlen(path)));
+	if (ret < 0 || (size_t)ret >= len)
+		return -1;
+
+	return 0;
+}
+
+/* returns the column at *pos and moves on behind it */
+static void *cache_column(const struct fft_eval_map *map, size_t *pos,
+			  size_t len)
+{
+	void *column = (void *)(map->data + *pos);
+
+	*pos += CACHE_ALIGN(len);
+
+	return column;
+}
+
+static int cache_max_bins(u8 type)
+{
+	switch (type) {
+	case ATH_FFT_SAMPLE_HT20:
+		return SPECTRAL_HT20_NUM_BINS;
+	case ATH_FFT_SAMPLE_HT20_40:
+		return SPECTRAL_HT20_40_NUM_BINS;
+	case ATH_FFT_SAMPLE_ATH10K:
+		return SPECTRAL_ATH10K_MAX_NUM_BINS;
+	case ATH_FFT_SAMPLE_ATH11K:
+		return SPECTRAL_ATH11K_MAX_NUM_BINS;
+	default:
+		return -1;
+	}
+}
+
+/*
+ * cache_check - checks the columns of a store mapped from a cache file
+ *
+ * The store is used like one filled by the parser, without any further
+ * checks, so a damaged cache file must not point outside of the arena.
+ *
+ * returns 0 if every sample is valid, -1 otherwise.
+ */
+static int cache_check(const struct fft_eval_store *store)
+{
+	int max_bins;
+	size_t i;
+
+	for (i = 0; i < store->n; i++) {
+		max_bins = cache_max_bins(store->type[i]);
+		if (max_bins < 0 || store->bins[i] > max_bins)
+			return -1;
+
+		if (store->offset[i] > store->arena_len ||
+		    store->arena_len - store->offset[i] <
+		    fft_eval_header_len(store->type[i]) + store->bins[i])
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * fft_eval_cache_load - fills an empty store from the cache of a dump
+ *
+ * @store: empty store, read-only afterwards
+ * @fname: file name of the dump
+ * @counts: returns the TLVs counted when the dump was parsed
+ *
+ * returns 0 on success, -1 when there is no valid cache file for the dump.
+ */
+int fft_eval_cache_load(struct fft_eval_store *store, const char *fname,
+			struct fft_eval_counts *counts)
+{
+	struct cache_header expected;
+	const struct cache_header *header;
+	struct fft_eval_map *map;
+	char path[PATH_MAX];
+	char name[PATH_MAX];
+	size_t pos, n, len;
+
+	if (cache_name(fname, path, name, sizeof(name)) < 0 ||
+	    cache_header_init(&expected, path) < 0)
+		return -1;
+
+	map = malloc(sizeof(*map));
+	if (!map)
+		return -1;
+
+	if (fft_eval_map_file(name, map) < 0) {
+		free(map);
+		return -1;
+	}
+
+	if (map->len < sizeof(*header))
+		goto err;
+
+	header = (const struct cache_header *)map->data;
+	if (memcmp(header, &expected, offsetof(struct cache_header, samples)) != 0 ||
+	    header->samples > map->len || header->arena_len > map->len)
+		goto err;
+
+	pos = CACHE_ALIGN(sizeof(*header));
+	if (map->len - pos < header->path_len ||
+	    memcmp(map->data + pos, path, header->path_len) != 0)
+		goto err;
+	pos += CACHE_ALIGN(header->path_len);
+
+	n = header->samples;
+	len = CACHE_ALIGN(n * sizeof(u64)) * 2 +
+	      CACHE_ALIGN(n * sizeof(size_t)) +
+	      CACHE_ALIGN(n * sizeof(int32_t)) * 2 +
+	      CACHE_ALIGN(n * sizeof(u16)) * 2 +
+	      CACHE_ALIGN(n * sizeof(u8)) * 3 +
+	      CACHE_ALIGN(header->arena_len);
+	if (n != header->samples || pos > map->len || map->len - pos != len)
+		goto err;
+
+	memset(store, 0, sizeof(*store));
+	store->tsf = cache_column(map, &pos, n * sizeof(*store->tsf));
+	store->pos = cache_column(map, &pos, n * sizeof(*store->pos));
+	store->offset = cache_column(map, &pos, n * sizeof(*store->offset));
+	store->rssi = cache_column(map, &pos, n * sizeof(*store->rssi));
+	store->noise = cache_column(map, &pos, n * sizeof(*store->noise));
+	store->freq = cache_column(map, &pos, n * sizeof(*store->freq));
+	store->bins = cache_column(map, &pos, n * sizeof(*store->bins));
+	store->type = cache_column(map, &pos, n * sizeof(*store->type));
+	store->max_exp = cache_column(map, &pos, n * sizeof(*store->max_exp));
+	store->chan_width = cache_column(map, &pos,
+					 n * sizeof(*store->chan_width));
+	store->arena = cache_column(map, &pos, header->arena_len);
+	store->n = n;
+	store->alloc = n;
+	store->arena_len = header->arena_len;
+	store->arena_alloc = header->arena_len;
+	store->cache = map;
+
+	if (cache_check(store) < 0) {
+		memset(store, 0, sizeof(*store));
+		goto err;
+	}
+
+	*counts = header->counts;
+
+	return 0;
+
+err:
+	fft_eval_unmap(map);
+	free(map);
+
+	return -1;
+}
+
+static int cache_write(FILE *fp, const void *data, size_t len)
+{
+	static const u8 pad[8];
+
+	if (len && fwrite(data, len, 1, fp) != 1)
+		return -1;
+
+	if (CACHE_ALIGN(len) != len &&
+	    fwrite(pad, CACHE_ALIGN(len) - len, 1, fp) != 1)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * fft_eval_cache_save - writes the cache of a dump
+ *
+ * @store: all samples of the dump
+ * @fname: file name of the dump
+ * @counts: TLVs counted while the dump was parsed
+ *
+ * The cache file is written under a temporary name and renamed, so other
+ * readers never see a partial file.
+ *
+ * returns 0 on success, -1 on error.
+ */
+int fft_eval_cache_save(const struct fft_eval_store *store, const char *fname,
+			const struct fft_eval_counts *counts)
+{
+	struct cache_header header;
+	char path[PATH_MAX];
+	char name[PATH_MAX];
+	char tmp[PATH_MAX + 32];
+	size_t n = store->n;
+	FILE *fp;
+	int ret = 0;
+
+	if (cache_name(fname, path, name, sizeof(name)) < 0 ||
+	    cache_header_init(&header, path) < 0)
+		return -1;
+
+	header.samples = n;
+	header.arena_len = store->arena_len;
+	header.counts = *counts;
+
+	snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", name, (long)getpid());
+
+	fp = fopen(tmp, "wb");
+	if (!fp)
+		return -1;
+
+	if (cache_write(fp, &header, sizeof(header)) < 0 ||
+	    cache_write(fp, path, header.path_len) < 0 ||
+	    cache_write(fp, store->tsf, n * sizeof(*store->tsf)) < 0 ||
+	    cache_write(fp, store->pos, n * sizeof(*store->pos)) < 0 ||
+	    cache_write(fp, store->offset, n * sizeof(*store->offset)) < 0 ||
+	    cache_write(fp, store->rssi, n * sizeof(*store->rssi)) < 0 ||
+	    cache_write(fp, store->noise, n * sizeof(*store->noise)) < 0 ||
+	    cache_write(fp, store->freq, n * sizeof(*store->freq)) < 0 ||
+	    cache_write(fp, store->bins, n * sizeof(*store->bins)) < 0 ||
+	    cache_write(fp, store->type, n * sizeof(*store->type)) < 0 ||
+	    cache_write(fp, store->max_exp, n * sizeof(*store->max_exp)) < 0 ||
+	    cache_write(fp, store->chan_width,
+			n * sizeof(*store->chan_width)) < 0 ||
+	    cache_write(fp, store->arena, store->arena_len) < 0)
+		ret = -1;
+
+	if (fclose(fp) != 0)
+		ret = -1;
+
+	if (ret == 0 && rename(tmp, name) < 0)
+		ret = -1;
+
+	if (ret < 0)
+		remove(tmp);
+
+	return ret;
+}
+
+#else
+
+/* there is no realpath() to name the cache files */
+int fft_eval_cache_load(struct fft_eval_store *store, const char *fname,
+			struct fft_eval_counts *counts)
+{
+	(void)store;
+	(void)fname;
+	(void)counts;
+
+	return -1;
+}
+
+int fft_eval_cache_save(const struct fft_eval_store *store, const char *fname,
+			const struct fft_eval_counts *counts)
+{
+	(void)store;
+	(void)fname;
+	(void)counts;
+
+	return -1;
+}
+
+#endif
@@ -0,0 +1,509 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * SPDX-FileCopyrightText: 2012 Simon Wunderlich <sw@simonwunderlich.de>
+ * SPDX-FileCopyrightText: 2012 Fraunhofer-Gesellschaft zur Foerderung der angewandten Forschung e.V.
+ */
+
+/*
+ * Conversion of the raw FFT bins of a sample to frequency/power pairs.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+  #include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+  #include <arm_neon.h>
+#endif
+
+#include "fft_eval.h"
+
+/*
+ * 20 * log10(data << max_exp) for every possible bin value and the common
+ * exponents. The values are computed exactly like the scalar formula, so
+ * looking them up gives bit identical results.
+ */
+#define LOG_TABLE_EXP	16
+
+static double log_table[LOG_TABLE_EXP][256];
+static pthread_once_t log_table_once = PTHREAD_ONCE_INIT;
+
+static void log_table_init(void)
+{
+	int max_exp, data;
+
+	for (max_exp = 0; max_exp < LOG_TABLE_EXP; max_exp++) {
+		for (data = 0; data < 256; data++) {
+			if (data == 0)
+				log_table[max_exp][data] = 20 * log10(1);
+			else
+				log_table[max_exp][data] = 20 * log10(data << max_exp);
+		}
+	}
+}
+
+struct bin_stats {
+	u64 sum;
+	u64 sumsq;
+	u8 min;
+	u8 max;
+};
+
+static void bin_stats_scalar(const u8 *data, int bins, struct bin_stats *stats)
+{
+	int i;
+
+	for (i = 0; i < bins; i++) {
+		stats->sum += data[i];
+		stats->sumsq += data[i] * data[i];
+		if (data[i] < stats->min)
+			stats->min = data[i];
+		if (data[i] > stats->max)
+			stats->max = data[i];
+	}
+}
+
+/*
+ * bin_stats - sum, sum of squares, minimum and maximum of the unshifted bins
+ *
+ * The squares of 8 bit values are accumulated in 32 bit vector lanes, which
+ * cannot overflow for the at most 65535 bins a TLV can carry. The max_exp
+ * shift is applied afterwards on the 64 bit totals.
+ */
+#if defined(__AVX2__)
+static void bin_stats(const u8 *data, int bins, struct bin_stats *stats)
+{
+	__m256i vmin = _mm256_set1_epi8((char)0xff);
+	__m256i vmax = _mm256_setzero_si256();
+	__m256i vsum = _mm256_setzero_si256();
+	__m256i vsq = _mm256_setzero_si256();
+	__m256i zero = _mm256_setzero_si256();
+	__m128i min128, max128;
+	u64 lanes[4];
+	u32 sq[8];
+	u8 bytes[16];
+	int i, j;
+
+	for (i = 0; i + 32 <= bins; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+		__m256i lo = _mm256_unpacklo_epi8(v, zero);
+		__m256i hi = _mm256_unpackhi_epi8(v, zero);
+
+		vmin = _mm256_min_epu8(vmin, v);
+		vmax = _mm256_max_epu8(vmax, v);
+		vsum = _mm256_add_epi64(vsum, _mm256_sad_epu8(v, zero));
+		vsq = _mm256_add_epi32(vsq, _mm256_madd_epi16(lo, lo));
+		vsq = _mm256_add_epi32(vsq, _mm256_madd_epi16(hi, hi));
+	}
+
+	_mm256_storeu_si256((__m256i *)lanes, vsum);
+	_mm256_storeu_si256((__m256i *)sq, vsq);
+	for (j = 0; j < 4; j++)
+		stats->sum += lanes[j];
+	for (j = 0; j < 8; j++)
+		stats->sumsq += sq[j];
+
+	min128 = _mm_min_epu8(_mm256_castsi256_si128(vmin),
+			      _mm256_extracti128_si256(vmin, 1));
+	max128 = _mm_max_epu8(_mm256_castsi256_si128(vmax),
+			      _mm256_extracti128_si256(vmax, 1));
+
+	if (i > 0) {
+		_mm_storeu_si128((__m128i *)bytes, min128);
+		for (j = 0; j < 16; j++)
+			if (bytes[j] < stats->min)
+				stats->min = bytes[j];
+
+		_mm_storeu_si128((__m128i *)bytes, max128);
+		for (j = 0; j < 16; j++)
+			if (bytes[j] > stats->max)
+				stats->max = bytes[j];
+	}
+
+	bin_stats_scalar(data + i, bins - i, stats);
+}
+#elif defined(__SSE2__)
+static void bin_stats(const u8 *data, int bins, struct bin_stats *stats)
+{
+	__m128i vmin = _mm_set1_epi8((char)0xff);
+	__m128i vmax = _mm_setzero_si128();
+	__m128i vsum = _mm_setzero_si128();
+	__m128i vsq = _mm_setzero_si128();
+	__m128i zero = _mm_setzero_si128();
+	u64 lanes[2];
+	u32 sq[4];
+	u8 bytes[16];
+	int i, j;
+
+	for (i = 0; i + 16 <= bins; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+		__m128i lo = _mm_unpacklo_epi8(v, zero);
+		__m128i hi = _mm_unpackhi_epi8(v, zero);
+
+		vmin = _mm_min_epu8(vmin, v);
+		vmax = _mm_max_epu8(vmax, v);
+		vsum = _mm_add_epi64(vsum, _mm_sad_epu8(v, zero));
+		vsq = _mm_add_epi32(vsq, _mm_madd_epi16(lo, lo));
+		vsq = _mm_add_epi32(vsq, _mm_madd_epi16(hi, hi));
+	}
+
+	_mm_storeu_si128((__m128i *)lanes, vsum);
+	_mm_storeu_si128((__m128i *)sq, vsq);
+	stats->sum += lanes[0] + lanes[1];
+	for (j = 0; j < 4; j++)
+		stats->sumsq += sq[j];
+
+	if (i > 0) {
+		_mm_storeu_si128((__m128i *)bytes, vmin);
+		for (j = 0; j < 16; j++)
+			if (bytes[j] < stats->min)
+				stats->min = bytes[j];
+
+		_mm_storeu_si128((__m128i *)bytes, vmax);
+		for (j = 0; j < 16; j++)
+			if (bytes[j] > stats->max)
+				stats->max = bytes[j];
+	}
+
+	bin_stats_scalar(data + i, bins - i, stats);
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+static void bin_stats(const u8 *data, int bins, struct bin_stats *stats)
+{
+	uint8x16_t vmin = vdupq_n_u8(0xff);
+	uint8x16_t vmax = vdupq_n_u8(0);
+	uint32x4_t vsq = vdupq_n_u32(0);
+	int i;
+
+	for (i = 0; i + 16 <= bins; i += 16) {
+		uint8x16_t v = vld1q_u8(data + i);
+		uint16x8_t lo = vmull_u8(vget_low_u8(v), vget_low_u8(v));
+		uint16x8_t hi = vmull_high_u8(v, v);
+
+		vmin = vminq_u8(vmin, v);
+		vmax = vmaxq_u8(vmax, v);
+		stats->sum += vaddlvq_u8(v);
+		vsq = vpadalq_u16(vsq, lo);
+		vsq = vpadalq_u16(vsq, hi);
+	}
+
+	stats->sumsq += vaddvq_u32(vsq);
+	if (i > 0) {
+		if (vminvq_u8(vmin) < stats->min)
+			stats->min = vminvq_u8(vmin);
+		if (vmaxvq_u8(vmax) > stats->max)
+			stats->max = vmaxvq_u8(vmax);
+	}
+
+	bin_stats_scalar(data + i, bins - i, stats);
+}
+#else
+static void bin_stats(const u8 *data, int bins, struct bin_stats *stats)
+{
+	bin_stats_scalar(data, bins, stats);
+}
+#endif
+
+/*
+ * decode_signal - converts bins to dBm
+ *
+ * This is where the "magic" happens: interpret the signal to output some
+ * kind of data which looks useful.
+ *
+ *   signal = noise + rssi + 20 * log10(data) - 10 * log10(datasquaresum)
+ *
+ * with data being the bin shifted by max_exp (at least 1) and datasquaresum
+ * the sum of the squares of all shifted bins.
+ */
+static void decode_signal(const u8 *data, int bins, int max_exp,
+			  int noise, int rssi, double datasquaresum,
+			  float *signal)
+{
+	double base = noise + rssi;
+	double sumlog = log10(datasquaresum) * 10;
+	const double *table;
+	int i;
+
+	if (max_exp < LOG_TABLE_EXP) {
+		table = log_table[max_exp];
+
+		for (i = 0; i < bins; i++)
+			signal[i] = base + table[data[i]] - sumlog;
+
+		return;
+	}
+
+	for (i = 0; i < bins; i++) {
+		double value = data[i] ? ldexp(data[i], max_exp) : 1;
+
+		signal[i] = base + 20 * log10(value) - sumlog;
+	}
+}
+
+/*
+ * decode_half - computes power statistics and signal of a range of bins
+ *
+ * @squared: sum up the squares of the bins (otherwise the plain bins)
+ */
+static void decode_half(const u8 *data, int bins, int max_exp, int noise,
+			int rssi, int squared, struct fft_eval_spectrum *spectrum,
+			int half, float *signal)
+{
+	struct bin_stats stats = { 0, 0, 0xff, 0 };
+	double datasquaresum;
+
+	bin_stats(data, bins, &stats);
+
+	if (squared)
+		datasquaresum = ldexp(stats.sumsq, 2 * max_exp);
+	else
+		datasquaresum = ldexp(stats.sum, max_exp);
+
+	spectrum->datasquaresum[half] = datasquaresum;
+	if (ldexp(stats.max * stats.max, 2 * max_exp) > spectrum->datamax)
+		spectrum->datamax = ldexp(stats.max * stats.max, 2 * max_exp);
+	if (ldexp(stats.min * stats.min, 2 * max_exp) < spectrum->datamin)
+		spectrum->datamin = ldexp(stats.min * stats.min, 2 * max_exp);
+
+	decode_signal(data, bins, max_exp, noise, rssi, datasquaresum, signal);
+}
+
+/*
+ * decode_ath11k_raw - converts ath11k bins like fft_eval_json always did
+ *
+ * Unlike fft_eval_sdl, fft_eval_json never shifted the ath11k bins by
+ * max_exp and computed the signal in single precision. This is kept to not
+ * change its output.
+ */
+static void decode_ath11k_raw(const struct fft_eval_sample *sample,
+			      struct fft_eval_spectrum *spectrum)
+{
+	int datasquaresum = 0;
+	int data;
+	int i;
+
+	for (i = 0; i < sample->bins; i++) {
+		data = sample->data[i];
+		data *= data;
+		datasquaresum += data;
+		if (data > spectrum->datamax)
+			spectrum->datamax = data;
+		if (data < spectrum->datamin)
+			spectrum->datamin = data;
+	}
+	spectrum->datasquaresum[0] = datasquaresum;
+
+	for (i = 0; i < sample->bins; i++) {
+		data = sample->data[i];
+		if (data == 0)
+			data = 1;
+		spectrum->signal[i] = sample->noise + sample->rssi +
+				      20 * log10f(data) -
+				      log10f(datasquaresum) * 10;
+	}
+}
+
+static int decode_spectrum(const struct fft_eval_sample *sample,
+			   struct fft_eval_spectrum *spectrum,
+			   unsigned int flags)
+{
+	const struct fft_sample_ht20_40 *ht40;
+	int half = sample->bins / 2;
+	double centerfreq;
+	double width;
+	int i;
+
+	pthread_once(&log_table_once, log_table_init);
+
+	spectrum->bins = sample->bins;
+	spectrum->datamax = 0;
+	spectrum->datamin = HUGE_VAL;
+	spectrum->datasquaresum[0] = 0;
+	spectrum->datasquaresum[1] = 0;
+
+	switch (sample->type) {
+	case ATH_FFT_SAMPLE_HT20:
+		if (flags & FFT_EVAL_DECODE_HT20_20MHZ) {
+			for (i = 0; i < sample->bins; i++)
+				spectrum->freq[i] = sample->freq - 10.0 +
+						    ((20.0 * i) / sample->bins);
+			break;
+		}
+
+		/*
+		 * According to Dave Aragon from University of Washington,
+		 * formerly Trapeze/Juniper Networks, in 2.4 GHz it should
+		 * divide 22 MHz channel width into 64 subcarriers but
+		 * only report the middle 56 subcarriers.
+		 *
+		 * For 5 GHz we do not know (Atheros claims it does not support
+		 * this frequency band, but it works).
+		 *
+		 * Since all these calculations map pretty much to -10/+10 MHz,
+		 * and we don't know better, use this assumption as well in 5 GHz.
+		 */
+		for (i = 0; i < sample->bins; i++)
+			spectrum->freq[i] = sample->freq -
+					    (22.0 * sample->bins / 64.0) / 2 +
+					    (22.0 * (i + 0.5) / 64.0);
+		break;
+	case ATH_FFT_SAMPLE_HT20_40:
+		ht40 = (const struct fft_sample_ht20_40 *)sample->tlv;
+
+		switch (ht40->channel_type) {
+		case NL80211_CHAN_HT40PLUS:
+			centerfreq = ht40->freq + 10;
+			break;
+		case NL80211_CHAN_HT40MINUS:
+			centerfreq = ht40->freq - 10;
+			break;
+		default:
+			return -1;
+		}
+
+		for (i = 0; i < sample->bins; i++)
+			spectrum->freq[i] = centerfreq -
+					    (40.0 * sample->bins / 128.0) / 2 +
+					    (40.0 * (i + 0.5) / 128.0);
+
+		/*
+		 * Both halves are separate 20 MHz channels with their own
+		 * noise and rssi. The upper half historically sums up the
+		 * plain instead of the squared bins.
+		 */
+		decode_half(sample->data, half, ht40->max_exp,
+			    ht40->lower_noise, ht40->lower_rssi, 1, spectrum, 0,
+			    spectrum->signal);
+		decode_half(sample->data + half, sample->bins - half,
+			    ht40->max_exp, ht40->upper_noise, ht40->upper_rssi,
+			    0, spectrum, 1, spectrum->signal + half);
+		return 0;
+	case ATH_FFT_SAMPLE_ATH10K:
+	case ATH_FFT_SAMPLE_ATH11K:
+		width = sample->chan_width;
+
+		for (i = 0; i < sample->bins; i++)
+			spectrum->freq[i] = sample->freq -
+					    (sample->chan_width) / 2 +
+					    (width * (i + 0.5) / sample->bins);
+
+		if (sample->type == ATH_FFT_SAMPLE_ATH11K &&
+		    (flags & FFT_EVAL_DECODE_ATH11K_RAW)) {
+			decode_ath11k_raw(sample, spectrum);
+			return 0;
+		}
+		break;
+	default:
+		return -1;
+	}
+
+	decode_half(sample->data, sample->bins, sample->max_exp, sample->noise,
+		    sample->rssi, 1, spectrum, 0, spectrum->signal);
+
+	return 0;
+}
+
+/*
+ * fft_eval_decode - converts the bins of a sample to frequency and dBm
+ *
+ * @sample: decoded sample
+ * @spectrum: returns frequency (MHz) and signal (dBm) of every bin
+ * @flags: FFT_EVAL_DECODE_* flags
+ *
+ * returns 0 on success, -1 if the sample cannot be interpreted.
+ */
+int fft_eval_decode(const struct fft_eval_sample *sample,
+		    struct fft_eval_spectrum *spectrum, unsigned int flags)
+{
+	enum fft_eval_stage stage;
+	int ret;
+
+	if (flags & FFT_EVAL_DECODE_NOSTATS)
+		return decode_spectrum(sample, spectrum, flags);
+
+	stage = fft_eval_stage_enter(FFT_EVAL_STAGE_DECODE);
+	ret = decode_spectrum(sample, spectrum, flags);
+	fft_eval_stage_enter(stage);
+
+	return ret;
+}
+
+/*
+ * bin_freq - frequency of a single bin, as calculated by decode_spectrum()
+ */
+static int bin_freq(const struct fft_eval_sample *sample, unsigned int flags,
+		    int i, double *freq)
+{
+	const struct fft_sample_ht20_40 *ht40;
+	double centerfreq;
+	double width;
+
+	switch (sample->type) {
+	case ATH_FFT_SAMPLE_HT20:
+		if (flags & FFT_EVAL_DECODE_HT20_20MHZ)
+			*freq = sample->freq - 10.0 + ((20.0 * i) / sample->bins);
+		else
+			*freq = sample->freq - (22.0 * sample->bins / 64.0) / 2 +
+				(22.0 * (i + 0.5) / 64.0);
+		return 0;
+	case ATH_FFT_SAMPLE_HT20_40:
+		ht40 = (const struct fft_sample_ht20_40 *)sample->tlv;
+
+		switch (ht40->channel_type) {
+		case NL80211_CHAN_HT40PLUS:
+			centerfreq = ht40->freq + 10;
+			break;
+		case NL80211_CHAN_HT40MINUS:
+			centerfreq = ht40->freq - 10;
+			break;
+		default:
+			return -1;
+		}
+
+		*freq = centerfreq - (40.0 * sample->bins / 128.0) / 2 +
+			(40.0 * (i + 0.5) / 128.0);
+		return 0;
+	case ATH_FFT_SAMPLE_ATH10K:
+	case ATH_FFT_SAMPLE_ATH11K:
+		width = sample->chan_width;
+		*freq = sample->freq - (sample->chan_width) / 2 +
+			(width * (i + 0.5) / sample->bins);
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+/*
+ * fft_eval_decode_span - frequency range of the bins of a sample
+ *
+ * @sample: decoded sample
+ * @flags: FFT_EVAL_DECODE_* flags, as given to fft_eval_decode()
+ * @low: returns the frequency of the first bin in MHz
+ * @high: returns the frequency of the last bin in MHz
+ *
+ * returns 0 on success, -1 if the sample cannot be interpreted.
+ */
+int fft_eval_decode_span(const struct fft_eval_sample *sample,
+			 unsigned int flags, float *low, float *high)
+{
+	double freq;
+
+	if (sample->bins == 0)
+		return -1;
+
+	if (bin_freq(sample, flags, 0, &freq) < 0)
+		return -1;
+	*low = freq;
+
+	if (bin_freq(sample, flags, sample->bins - 1, &freq) < 0)
+		return -1;
+	*high = freq;
+
+	return 0;
+}
@@ -0,0 +1,126 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * SPDX-FileCopyrightText: 2026 Simon Wunderlich <sw@simonwunderlich.de>
+ */
+
+/*
+ * Converts a spectral scan dump to a columnar Arrow IPC file or stream, which
+ * can be used by analysis tools without parsing the text output of
+ * fft_eval_json.
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fft_eval.h"
+
+static void usage(const char *prog)
+{
+	if (!prog)
+		prog = "fft_eval_export";
+
+	fprintf(stderr, "Usage: %s [-b rows] [-s] [-j threads] [--stats[=file]] scanfile outfile\n", prog);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Writes the samples of scanfile as Arrow IPC file to outfile (\"-\" for stdout)\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  -b  number of samples per record batch (default: %d)\n",
+		FFT_EVAL_ARROW_BATCH_ROWS);
+	fprintf(stderr, "  -s  write the Arrow IPC stream format instead of the file\n");
+	fprintf(stderr, "      format (implied when outfile is \"-\" for stdout)\n");
+	fft_eval_usage(prog);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		FFT_EVAL_LONGOPTS,
+		{ NULL, 0, NULL, 0 },
+	};
+	struct fft_eval_writer out;
+	long batch_rows = FFT_EVAL_ARROW_BATCH_ROWS;
+	char *prog = NULL;
+	int stream = 0;
+	int ret;
+	int fd;
+	int ch;
+
+	if (argc >= 1)
+		prog = argv[0];
+
+	while ((ch = getopt_long(argc, argv, "b:hs" FFT_EVAL_OPTSTRING,
+				 long_options, NULL)) != -1) {
+		switch (ch) {
+		case 'b':
+			/* list offsets are 32 bit, 512 bins per sample at most */
+			batch_rows = atol(optarg);
+			if (batch_rows < 1 || batch_rows > INT32_MAX / 512) {
+				fprintf(stderr, "invalid number of rows per batch: %s\n", optarg);
+				exit(127);
+			}
+			break;
+		case 's':
+			stream = 1;
+			break;
+		case 'h':
+			usage(prog);
+			exit(127);
+		default:
+			if (fft_eval_parse_option(ch, optarg) == 0)
+				break;
+
+			usage(prog);
+			exit(127);
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (argc < 2) {
+		usage(prog);
+		exit(127);
+	}
+
+	if (fft_eval_init(argv[0]) < 0) {
+		fprintf(stderr, "Couldn't read scanfile ...\n");
+		usage(prog);
+		return -1;
+	}
+
+	if (strcmp(argv[1], "-") == 0) {
+		fd = STDOUT_FILENO;
+		stream = 1;
+	} else {
+		fd = open(argv[1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+
+	if (fd < 0) {
+		perror(argv[1]);
+		fft_eval_exit();
+		return -1;
+	}
+
+	if (fft_eval_writer_init(&out, fd, FFT_EVAL_WRITER_SIZE) < 0) {
+		fprintf(stderr, "Couldn't allocate output buffer\n");
+		fft_eval_exit();
+		return -1;
+	}
+
+	fft_eval_stage_enter(FFT_EVAL_STAGE_EMIT);
+
+	ret = fft_eval_write_arrow(&out, &result_store, batch_rows, stream);
+	if (fft_eval_writer_flush(&out) < 0)
+		ret = -1;
+
+	if (ret < 0)
+		fprintf(stderr, "Couldn't write %s\n", argv[1]);
+
+	fft_eval_writer_free(&out);
+	if (fd != STDOUT_FILENO)
+		close(fd);
+	fft_eval_exit();
+
+	return ret;
+}
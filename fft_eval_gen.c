@@ -0,0 +1,397 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * SPDX-FileCopyrightText: 2026 Simon Wunderlich <sw@simonwunderlich.de>
+ */
+
+/*
+ * Generator for synthetic spectral scan dumps.
+ *
+ * The samples show a noise floor with a few transmitters which are switched
+ * on and off randomly, similar to a real scan of a busy 2.4/5 GHz band. The
+ * output is deterministic for a given seed and can be used to test and
+ * benchmark the other tools with dumps of any size.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fft_eval.h"
+
+#define ARRAY_SIZE(x)	(sizeof(x) / sizeof((x)[0]))
+
+/* number of simulated transmitters */
+#define TRANSMITTERS	8
+
+struct gen_format {
+	const char *name;
+	u8 type;
+	u16 bins;
+};
+
+static const struct gen_format gen_formats[] = {
+	{ "ht20",	ATH_FFT_SAMPLE_HT20,	SPECTRAL_HT20_NUM_BINS },
+	{ "ht40",	ATH_FFT_SAMPLE_HT20_40,	SPECTRAL_HT20_40_NUM_BINS },
+	{ "ath10k",	ATH_FFT_SAMPLE_ATH10K,	64 },
+	{ "ath10k",	ATH_FFT_SAMPLE_ATH10K,	128 },
+	{ "ath10k",	ATH_FFT_SAMPLE_ATH10K,	256 },
+	{ "ath11k",	ATH_FFT_SAMPLE_ATH11K,	16 },
+	{ "ath11k",	ATH_FFT_SAMPLE_ATH11K,	32 },
+	{ "ath11k",	ATH_FFT_SAMPLE_ATH11K,	64 },
+	{ "ath11k",	ATH_FFT_SAMPLE_ATH11K,	128 },
+	{ "ath11k",	ATH_FFT_SAMPLE_ATH11K,	256 },
+	{ "ath11k",	ATH_FFT_SAMPLE_ATH11K,	512 },
+};
+
+static const u16 gen_channels[] = {
+	2412, 2417, 2422, 2427, 2432, 2437, 2442, 2447, 2452, 2457, 2462,
+	5180, 5200, 5220, 5240, 5260, 5280, 5300, 5320, 5500, 5540, 5580,
+	5660, 5745, 5785, 5825,
+};
+
+struct gen_transmitter {
+	u16 freq;
+	u8 width;
+	u8 level;
+	int on;
+};
+
+static struct gen_transmitter transmitters[TRANSMITTERS];
+static u64 rng_state = 0x853c49e6748fea9bULL;
+static u64 tsf;
+
+/* xorshift64*, identical output on all platforms */
+static u32 rng(void)
+{
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+
+	return (rng_state * 0x2545f4914f6cdd1dULL) >> 32;
+}
+
+static void put_be16(u8 *buf, size_t offset, u16 value)
+{
+	buf[offset] = value >> 8;
+	buf[offset + 1] = value;
+}
+
+static void put_be32(u8 *buf, size_t offset, u32 value)
+{
+	put_be16(buf, offset, value >> 16);
+	put_be16(buf, offset + 2, value);
+}
+
+static void put_be64(u8 *buf, size_t offset, u64 value)
+{
+	put_be32(buf, offset, value >> 32);
+	put_be32(buf, offset + 4, value);
+}
+
+static void gen_init_transmitters(void)
+{
+	int i;
+
+	for (i = 0; i < TRANSMITTERS; i++) {
+		transmitters[i].freq = gen_channels[rng() % ARRAY_SIZE(gen_channels)];
+		transmitters[i].width = (rng() % 2) ? 20 : 5;
+		transmitters[i].level = 40 + rng() % 150;
+		transmitters[i].on = rng() % 2;
+	}
+}
+
+/*
+ * gen_bins - fills the magnitudes of all bins around the center frequency
+ *
+ * returns the index of the strongest bin.
+ */
+static int gen_bins(u8 *data, int bins, u16 freq, int width, u16 *max_mag)
+{
+	float start = freq - width / 2.0;
+	float bin_freq, dist;
+	int max_index = 0;
+	int i, t, mag;
+
+	/* transmitters are switched on and off occasionally */
+	for (t = 0; t < TRANSMITTERS; t++) {
+		if (rng() % 64 == 0)
+			transmitters[t].on = !transmitters[t].on;
+	}
+
+	*max_mag = 0;
+	for (i = 0; i < bins; i++) {
+		bin_freq = start + width * (i + 0.5) / bins;
+		mag = 1 + rng() % 6;
+
+		for (t = 0; t < TRANSMITTERS; t++) {
+			if (!transmitters[t].on)
+				continue;
+
+			dist = bin_freq - transmitters[t].freq;
+			if (dist < 0)
+				dist = -dist;
+
+			if (dist < transmitters[t].width / 2.0)
+				mag += transmitters[t].level -
+				       rng() % (transmitters[t].level / 4 + 1);
+		}
+
+		if (mag > 255)
+			mag = 255;
+
+		data[i] = mag;
+		if (mag > *max_mag) {
+			*max_mag = mag;
+			max_index = i;
+		}
+	}
+
+	return max_index;
+}
+
+/*
+ * gen_sample - writes one sample in wire format to buf
+ *
+ * returns the length of the sample.
+ */
+static size_t gen_sample(u8 *buf, const struct gen_format *format)
+{
+	u16 freq = gen_channels[rng() % ARRAY_SIZE(gen_channels)];
+	s8 rssi = 5 + rng() % 50;
+	s8 noise = -95 - (int)(rng() % 10);
+	size_t header_len = fft_eval_header_len(format->type);
+	size_t len = header_len + format->bins;
+	int width, max_index;
+	u16 max_mag;
+
+	memset(buf, 0, len);
+	buf[0] = format->type;
+	put_be16(buf, offsetof(struct fft_sample_tlv, length),
+		 len - sizeof(struct fft_sample_tlv));
+
+	tsf += 50 + rng() % 200;
+
+	switch (format->type) {
+	case ATH_FFT_SAMPLE_HT20:
+		max_index = gen_bins(buf + header_len, format->bins, freq, 20,
+				     &max_mag);
+
+		put_be16(buf, offsetof(struct fft_sample_ht20, freq), freq);
+		buf[offsetof(struct fft_sample_ht20, rssi)] = rssi;
+		buf[offsetof(struct fft_sample_ht20, noise)] = noise;
+		put_be16(buf, offsetof(struct fft_sample_ht20, max_magnitude),
+			 max_mag);
+		buf[offsetof(struct fft_sample_ht20, max_index)] = max_index;
+		buf[offsetof(struct fft_sample_ht20, bitmap_weight)] = rng() % 8;
+		put_be64(buf, offsetof(struct fft_sample_ht20, tsf), tsf);
+		break;
+	case ATH_FFT_SAMPLE_HT20_40:
+		/* lower channel of the 40 MHz pair */
+		max_index = gen_bins(buf + header_len, format->bins, freq + 10,
+				     40, &max_mag);
+
+		buf[offsetof(struct fft_sample_ht20_40, channel_type)] = NL80211_CHAN_HT40PLUS;
+		put_be16(buf, offsetof(struct fft_sample_ht20_40, freq), freq);
+		buf[offsetof(struct fft_sample_ht20_40, lower_rssi)] = rssi;
+		buf[offsetof(struct fft_sample_ht20_40, upper_rssi)] = rssi - rng() % 4;
+		put_be64(buf, offsetof(struct fft_sample_ht20_40, tsf), tsf);
+		buf[offsetof(struct fft_sample_ht20_40, lower_noise)] = noise;
+		buf[offsetof(struct fft_sample_ht20_40, upper_noise)] = noise;
+		put_be16(buf, offsetof(struct fft_sample_ht20_40, lower_max_magnitude),
+			 max_mag);
+		put_be16(buf, offsetof(struct fft_sample_ht20_40, upper_max_magnitude),
+			 max_mag);
+		buf[offsetof(struct fft_sample_ht20_40, lower_max_index)] = max_index % 64;
+		buf[offsetof(struct fft_sample_ht20_40, upper_max_index)] = max_index % 64;
+		break;
+	case ATH_FFT_SAMPLE_ATH10K:
+		width = format->bins * 20 / 64;
+		max_index = gen_bins(buf + header_len, format->bins, freq, width,
+				     &max_mag);
+
+		buf[offsetof(struct fft_sample_ath10k, chan_width_mhz)] = width;
+		put_be16(buf, offsetof(struct fft_sample_ath10k, freq1), freq);
+		put_be16(buf, offsetof(struct fft_sample_ath10k, noise), (u16)noise);
+		put_be16(buf, offsetof(struct fft_sample_ath10k, max_magnitude),
+			 max_mag);
+		put_be16(buf, offsetof(struct fft_sample_ath10k, total_gain_db), 50);
+		put_be16(buf, offsetof(struct fft_sample_ath10k, base_pwr_db), 100);
+		put_be64(buf, offsetof(struct fft_sample_ath10k, tsf), tsf);
+		buf[offsetof(struct fft_sample_ath10k, max_index)] = max_index;
+		buf[offsetof(struct fft_sample_ath10k, rssi)] = rssi;
+		break;
+	case ATH_FFT_SAMPLE_ATH11K:
+		width = format->bins <= 64 ? 20 : format->bins * 20 / 64;
+		max_index = gen_bins(buf + header_len, format->bins, freq, width,
+				     &max_mag);
+
+		buf[offsetof(struct fft_sample_ath11k, chan_width_mhz)] = width;
+		buf[offsetof(struct fft_sample_ath11k, max_index)] = max_index;
+		put_be16(buf, offsetof(struct fft_sample_ath11k, freq1), freq);
+		put_be16(buf, offsetof(struct fft_sample_ath11k, max_magnitude),
+			 max_mag);
+		put_be16(buf, offsetof(struct fft_sample_ath11k, rssi), rssi);
+		put_be32(buf, offsetof(struct fft_sample_ath11k, tsf), tsf);
+		put_be32(buf, offsetof(struct fft_sample_ath11k, noise), (u32)(int32_t)noise);
+		break;
+	}
+
+	return len;
+}
+
+static const struct gen_format *find_format(const char *name, int bins)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(gen_formats); i++) {
+		if (strcmp(gen_formats[i].name, name) != 0)
+			continue;
+
+		if (bins && gen_formats[i].bins != bins)
+			continue;
+
+		/* the largest sample is the default */
+		if (!bins && i + 1 < ARRAY_SIZE(gen_formats) &&
+		    strcmp(gen_formats[i + 1].name, name) == 0)
+			continue;
+
+		return &gen_formats[i];
+	}
+
+	return NULL;
+}
+
+static unsigned long long parse_size(const char *arg)
+{
+	unsigned long long size;
+	char *end;
+
+	size = strtoull(arg, &end, 0);
+	switch (*end) {
+	case 'G':
+		size *= 1024;
+		/* fall through */
+	case 'M':
+		size *= 1024;
+		/* fall through */
+	case 'k':
+		size *= 1024;
+		break;
+	}
+
+	return size;
+}
+
+static void usage(const char *prog)
+{
+	size_t i;
+
+	if (!prog)
+		prog = "fft_eval_gen";
+
+	fprintf(stderr, "Usage: %s [-t type] [-b bins] [-n samples] [-s size] [-r seed] outfile\n", prog);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Writes a synthetic spectral scan dump to outfile (\"-\" for stdout)\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  -t  sample type, \"all\" cycles through all of them:\n");
+	for (i = 0; i < ARRAY_SIZE(gen_formats); i++)
+		fprintf(stderr, "        %-6s %3d bins\n", gen_formats[i].name,
+			gen_formats[i].bins);
+	fprintf(stderr, "  -b  number of bins (default: largest of the type)\n");
+	fprintf(stderr, "  -n  number of samples (default: 10000)\n");
+	fprintf(stderr, "  -s  size of the dump instead of -n, suffix k, M or G\n");
+	fprintf(stderr, "  -r  seed of the random generator\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static u8 buf[FFT_EVAL_MAX_SAMPLE_LEN];
+	const struct gen_format *format = NULL;
+	unsigned long long samples = 10000;
+	unsigned long long size = 0;
+	unsigned long long written = 0;
+	unsigned long long i;
+	const char *type = "ath10k";
+	char *prog = NULL;
+	int all = 0;
+	int bins = 0;
+	size_t len;
+	FILE *fp;
+	int ch;
+
+	if (argc >= 1)
+		prog = argv[0];
+
+	while ((ch = getopt(argc, argv, "b:hn:r:s:t:")) != -1) {
+		switch (ch) {
+		case 'b':
+			bins = atoi(optarg);
+			break;
+		case 'n':
+			samples = strtoull(optarg, NULL, 0);
+			break;
+		case 'r':
+			rng_state = strtoull(optarg, NULL, 0) | 1;
+			break;
+		case 's':
+			size = parse_size(optarg);
+			break;
+		case 't':
+			type = optarg;
+			break;
+		case 'h':
+		default:
+			usage(prog);
+			exit(127);
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (argc < 1) {
+		usage(prog);
+		exit(127);
+	}
+
+	if (strcmp(type, "all") == 0) {
+		all = 1;
+	} else {
+		format = find_format(type, bins);
+		if (!format) {
+			fprintf(stderr, "unsupported type %s with %d bins\n", type, bins);
+			usage(prog);
+			exit(127);
+		}
+	}
+
+	if (strcmp(argv[0], "-") == 0)
+		fp = stdout;
+	else
+		fp = fopen(argv[0], "wb");
+
+	if (!fp) {
+		perror(argv[0]);
+		return -1;
+	}
+
+	gen_init_transmitters();
+
+	for (i = 0; size ? written < size : i < samples; i++) {
+		if (all)
+			format = &gen_formats[i % ARRAY_SIZE(gen_formats)];
+
+		len = gen_sample(buf, format);
+		if (fwrite(buf, len, 1, fp) != 1) {
+			perror(argv[0]);
+			return -1;
+		}
+
+		written += len;
+	}
+
+	if (fp != stdout)
+		fclose(fp);
+
+	return 0;
+}
@@ -0,0 +1,600 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * SPDX-FileCopyrightText: 2026 Simon Wunderlich <sw@simonwunderlich.de>
+ */
+
+/*
+ * Renders the views of fft_eval_sdl to image files, without a window.
+ *
+ * Every scanfile is drawn to outdir/<name of the scanfile>.png (or .ppm).
+ * With -p several scanfiles are rendered at the same time, each one in its
+ * own process. The axis labels are left out, as no font is loaded.
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "fft_eval.h"
+
+#define ARRAY_SIZE(x)	(sizeof(x) / sizeof((x)[0]))
+
+#define WIDTH	1600
+#define HEIGHT	650
+
+/* the waterfall covers everything above the frequency labels */
+#define WATERFALL_ROWS	(HEIGHT - 20)
+
+/* same zoom levels as fft_eval_sdl */
+#define ZOOM_MIN	-5
+#define ZOOM_MAX	3
+
+enum view {
+	VIEW_SAMPLES,
+	VIEW_DENSITY,
+	VIEW_WATERFALL,
+};
+
+static const char * const view_names[] = {
+	[VIEW_SAMPLES] = "samples",
+	[VIEW_DENSITY] = "density",
+	[VIEW_WATERFALL] = "waterfall",
+};
+
+enum format {
+	FORMAT_PNG,
+	FORMAT_PPM,
+};
+
+static const char * const format_names[] = {
+	[FORMAT_PNG] = "png",
+	[FORMAT_PPM] = "ppm",
+};
+
+static enum view view = VIEW_SAMPLES;
+static enum format format = FORMAT_PNG;
+static const char *outdir = ".";
+static int width = WIDTH;
+static int color_invert = 0;
+static int zoom = 0;
+static int processes = 1;
+
+/* -1 selects the frequency of the first shown sample */
+static long startfreq = -1;
+
+/* samples first to last, -1 for the last sample of the scanfile */
+static long first_sample = 0;
+static long last_sample = -1;
+static long highlight = -1;
+
+static int parse_name(const char * const *names, int num, const char *arg)
+{
+	int i;
+
+	for (i = 0; i < num; i++) {
+		if (strcmp(names[i], arg) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+static int parse_long(const char *arg, long min, long max, long *value)
+{
+	char *end;
+
+	*value = strtol(arg, &end, 0);
+	if (end == arg || *end != '\0' || *value < min || *value > max)
+		return -1;
+
+	return 0;
+}
+
+/* first[:last] */
+static int parse_range(const char *arg)
+{
+	char *end;
+
+	first_sample = strtol(arg, &end, 0);
+	if (end == arg || first_sample < 0)
+		return -1;
+
+	if (*end == '\0') {
+		last_sample = -1;
+		return 0;
+	}
+
+	if (*end != ':')
+		return -1;
+
+	arg = end + 1;
+	last_sample = strtol(arg, &end, 0);
+	if (end == arg || *end != '\0' || last_sample < first_sample)
+		return -1;
+
+	return 0;
+}
+
+static int decode(size_t rnum, struct fft_eval_spectrum *spectrum)
+{
+	struct fft_eval_sample sample;
+
+	fft_eval_store_get(&result_store, rnum, &sample);
+
+	return fft_eval_decode(&sample, spectrum, 0);
+}
+
+/* frequency at the left border, 20 MHz below the first shown sample */
+static int view_startfreq(size_t first, size_t end)
+{
+	long freq = startfreq;
+
+	if (freq < 0) {
+		freq = FFT_EVAL_MIN_FREQ;
+
+		if (highlight >= 0 && (size_t)highlight < result_store.n)
+			freq = result_store.freq[highlight] - 20;
+		else if (first < end)
+			freq = result_store.freq[first] - 20;
+	}
+
+	if (freq < FFT_EVAL_MIN_FREQ)
+		freq = FFT_EVAL_MIN_FREQ;
+	if (freq > FFT_EVAL_MAX_FREQ)
+		freq = FFT_EVAL_MAX_FREQ;
+
+	return freq;
+}
+
+static int draw_samples(struct fft_eval_canvas *canvas, const u32 *background,
+			size_t first, size_t end, int start)
+{
+	struct fft_eval_spectrum spectrum;
+	struct fft_eval_freq_index index;
+	struct fft_eval_pyramid pyramid;
+	struct fft_eval_layer layer;
+	size_t skip = result_store.n;
+	size_t rnum;
+	int ret;
+
+	if (zoom != 0) {
+		if (fft_eval_pyramid_init(&pyramid) < 0)
+			return -1;
+
+		for (rnum = first; rnum < end; rnum++) {
+			if (decode(rnum, &spectrum) == 0)
+				fft_eval_pyramid_add(&pyramid, &spectrum);
+		}
+		fft_eval_pyramid_update(&pyramid);
+
+		memcpy(canvas->pixels, background,
+		       (size_t)canvas->width * canvas->height * sizeof(*background));
+		fft_eval_render_envelope(canvas, &pyramid, start,
+					 ldexp(FFT_EVAL_X_SCALE, zoom));
+		fft_eval_pyramid_free(&pyramid);
+
+		return 0;
+	}
+
+	/* the highlighted sample is drawn on top */
+	if (highlight >= 0 && (size_t)highlight < result_store.n)
+		skip = highlight;
+
+	if (fft_eval_layer_init(&layer, canvas->width, canvas->height) < 0)
+		return -1;
+
+	if (fft_eval_freq_index_build_range(&index, &result_store, first, end,
+					    0) < 0) {
+		fft_eval_layer_free(&layer);
+		return -1;
+	}
+
+	fft_eval_layer_clear(&layer, color_invert);
+	ret = fft_eval_layer_draw(&layer, &result_store, &index, start, skip,
+				  fft_eval_config.threads);
+	if (ret == 0)
+		fft_eval_layer_compose(canvas, background, &layer);
+
+	fft_eval_freq_index_free(&index);
+	fft_eval_layer_free(&layer);
+
+	return ret;
+}
+
+static int draw_density(struct fft_eval_canvas *canvas, const u32 *background,
+			size_t first, size_t end, int start)
+{
+	struct fft_eval_spectrum spectrum;
+	struct fft_eval_density density;
+	size_t rnum;
+
+	if (fft_eval_density_init(&density) < 0)
+		return -1;
+
+	for (rnum = first; rnum < end; rnum++) {
+		if (decode(rnum, &spectrum) == 0)
+			fft_eval_density_add(&density, &spectrum);
+	}
+
+	memcpy(canvas->pixels, background,
+	       (size_t)canvas->width * canvas->height * sizeof(*background));
+	fft_eval_render_density(canvas, &density, start);
+	fft_eval_density_free(&density);
+
+	return 0;
+}
+
+/* the last sample in the top row, the samples before it below */
+static void draw_waterfall(struct fft_eval_canvas *canvas,
+			   const u32 *background, size_t first, size_t end,
+			   int start)
+{
+	struct fft_eval_spectrum spectrum;
+	struct fft_eval_spectrum *row;
+	size_t rnum = end;
+	int y;
+
+	/* only the frequency labels remain visible */
+	memcpy(canvas->pixels, background,
+	       (size_t)canvas->width * canvas->height * sizeof(*background));
+
+	for (y = 0; y < WATERFALL_ROWS && y < canvas->height; y++) {
+		row = NULL;
+		if (rnum > first) {
+			rnum--;
+			if (decode(rnum, &spectrum) == 0)
+				row = &spectrum;
+		}
+
+		fft_eval_render_row(&canvas->pixels[(size_t)y * canvas->width],
+				    canvas->width, row, start, color_invert);
+	}
+}
+
+static int draw_view(struct fft_eval_canvas *canvas, u32 *background)
+{
+	struct fft_eval_canvas grid = *canvas;
+	struct fft_eval_spectrum spectrum;
+	double scale = ldexp(FFT_EVAL_X_SCALE, zoom);
+	size_t first, end;
+	int start;
+	int ret = 0;
+
+	end = result_store.n;
+	if (last_sample >= 0 && (size_t)last_sample < end)
+		end = last_sample + 1;
+
+	first = first_sample;
+	if (first > end)
+		first = end;
+
+	start = view_startfreq(first, end);
+
+	grid.pixels = background;
+	fft_eval_render_grid(&grid, start, scale, fft_eval_grid_step(scale));
+
+	switch (view) {
+	case VIEW_SAMPLES:
+		ret = draw_samples(canvas, background, first, end, start);
+		break;
+	case VIEW_DENSITY:
+		ret = draw_density(canvas, background, first, end, start);
+		break;
+	case VIEW_WATERFALL:
+		draw_waterfall(canvas, background, first, end, start);
+		break;
+	}
+
+	if (ret < 0 || view == VIEW_WATERFALL || zoom != 0)
+		return ret;
+
+	if (highlight >= 0 && (size_t)highlight < result_store.n &&
+	    decode(highlight, &spectrum) == 0)
+		fft_eval_render_sample(canvas, &spectrum, start, 1);
+
+	return 0;
+}
+
+static int write_image(const char *fname, const struct fft_eval_canvas *canvas)
+{
+	struct fft_eval_writer out;
+	const char *name;
+	char path[4096];
+	int ret;
+	int fd;
+
+	name = strrchr(fname, '/');
+	name = name ? name + 1 : fname;
+	if (strcmp(name, "-") == 0)
+		name = "stdin";
+
+	ret = snprintf(path, sizeof(path), "%s/%s.%s", outdir, name,
+		       format_names[format]);
+	if (ret < 0 || (size_t)ret >= sizeof(path)) {
+		fprintf(stderr, "%s: output path too long\n", fname);
+		return -1;
+	}
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+
+	if (fft_eval_writer_init(&out, fd, FFT_EVAL_WRITER_SIZE) < 0) {
+		fprintf(stderr, "Couldn't allocate output buffer\n");
+		close(fd);
+		return -1;
+	}
+
+	if (format == FORMAT_PNG)
+		ret = fft_eval_write_png(&out, canvas);
+	else
+		ret = fft_eval_write_ppm(&out, canvas);
+
+	if (fft_eval_writer_flush(&out) < 0)
+		ret = -1;
+
+	if (ret < 0)
+		fprintf(stderr, "Couldn't write %s\n", path);
+
+	fft_eval_writer_free(&out);
+	close(fd);
+
+	return ret;
+}
+
+/*
+ * render_file - reads a scanfile and writes the image of the view
+ *
+ * returns 0 on success, -1 on errors.
+ */
+static int render_file(char *fname)
+{
+	struct fft_eval_canvas canvas;
+	enum fft_eval_stage stage;
+	u32 *background;
+	int ret = -1;
+
+	if (fft_eval_init(fname) < 0) {
+		fprintf(stderr, "Couldn't read scanfile %s\n", fname);
+		fft_eval_store_free(&result_store);
+		return -1;
+	}
+
+	canvas.width = width;
+	canvas.height = HEIGHT;
+	canvas.color_invert = color_invert;
+	canvas.pixels = malloc((size_t)width * HEIGHT * sizeof(*canvas.pixels));
+	background = malloc((size_t)width * HEIGHT * sizeof(*background));
+	if (!canvas.pixels || !background) {
+		fprintf(stderr, "Couldn't allocate image\n");
+		goto out;
+	}
+
+	stage = fft_eval_stage_enter(FFT_EVAL_STAGE_RENDER);
+	ret = draw_view(&canvas, background);
+	fft_eval_stage_enter(FFT_EVAL_STAGE_EMIT);
+
+	if (ret < 0)
+		fprintf(stderr, "Couldn't draw %s\n", fname);
+	else
+		ret = write_image(fname, &canvas);
+
+	fft_eval_stage_enter(stage);
+
+out:
+	free(background);
+	free(canvas.pixels);
+	fft_eval_store_free(&result_store);
+
+	return ret;
+}
+
+/* returns 1 if the worker failed */
+static int reap_worker(void)
+{
+	int status;
+
+	if (wait(&status) < 0)
+		return 1;
+
+	return !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+}
+
+/*
+ * render_files - renders every scanfile, in up to processes worker
+ *  processes at the same time
+ *
+ * returns the number of scanfiles which couldn't be rendered.
+ */
+static int render_files(char **fnames, int num)
+{
+	int running = 0;
+	int failed = 0;
+	pid_t pid;
+	int i;
+
+	for (i = 0; i < num; i++) {
+		if (processes <= 1) {
+			if (render_file(fnames[i]) < 0)
+				failed++;
+			continue;
+		}
+
+		if (running == processes) {
+			failed += reap_worker();
+			running--;
+		}
+
+		fflush(stdout);
+		fflush(stderr);
+
+		pid = fork();
+		if (pid == 0)
+			exit(render_file(fnames[i]) < 0 ? 1 : 0);
+
+		if (pid > 0) {
+			running++;
+			continue;
+		}
+
+		/* render it here when no worker could be started */
+		if (render_file(fnames[i]) < 0)
+			failed++;
+	}
+
+	while (running > 0) {
+		failed += reap_worker();
+		running--;
+	}
+
+	return failed;
+}
+
+static void usage(const char *prog)
+{
+	if (!prog)
+		prog = "fft_eval_image";
+
+	fprintf(stderr, "Usage: %s [-v view] [-s startfreq] [-z zoom] [-W width] [-r first[:last]]\n", prog);
+	fprintf(stderr, "       [-H sample] [-i] [-f format] [-o outdir] [-p processes] [-j threads]\n");
+	fprintf(stderr, "       [--stats[=file]] scanfile...\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Draws the view of fft_eval_sdl for every scanfile to outdir/<scanfile>.<format>\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  -v  samples, density or waterfall (default: samples)\n");
+	fprintf(stderr, "  -s  frequency at the left border in MHz\n");
+	fprintf(stderr, "      (default: 20 MHz below the first shown sample)\n");
+	fprintf(stderr, "  -z  zoom of the samples view from %d to %d, other than 0 draws the\n",
+		ZOOM_MIN, ZOOM_MAX);
+	fprintf(stderr, "      envelope of the samples (default: 0)\n");
+	fprintf(stderr, "  -W  width of the image in pixels (default: %d)\n", WIDTH);
+	fprintf(stderr, "  -r  only draw the samples first to last (default: all)\n");
+	fprintf(stderr, "  -H  highlight a sample, the waterfall always starts with the last one\n");
+	fprintf(stderr, "  -i  inverted colors\n");
+	fprintf(stderr, "  -f  png or ppm (default: png)\n");
+	fprintf(stderr, "  -o  directory of the images (default: .)\n");
+	fprintf(stderr, "  -p  number of scanfiles rendered at the same time, in worker\n");
+	fprintf(stderr, "      processes (default: 1). --stats only covers scanfiles rendered\n");
+	fprintf(stderr, "      without workers.\n");
+	fft_eval_usage(prog);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		FFT_EVAL_LONGOPTS,
+		{ NULL, 0, NULL, 0 },
+	};
+	char *prog = NULL;
+	long value;
+	int failed;
+	int ch;
+
+	if (argc >= 1)
+		prog = argv[0];
+
+	while ((ch = getopt_long(argc, argv, "f:hH:io:p:r:s:v:W:z:" FFT_EVAL_OPTSTRING,
+				 long_options, NULL)) != -1) {
+		switch (ch) {
+		case 'f':
+			value = parse_name(format_names, ARRAY_SIZE(format_names), optarg);
+			if (value < 0) {
+				fprintf(stderr, "invalid format: %s\n", optarg);
+				exit(127);
+			}
+			format = value;
+			break;
+		case 'H':
+			if (parse_long(optarg, 0, LONG_MAX, &highlight) < 0) {
+				fprintf(stderr, "invalid sample: %s\n", optarg);
+				exit(127);
+			}
+			break;
+		case 'i':
+			color_invert = 1;
+			break;
+		case 'o':
+			outdir = optarg;
+			break;
+		case 'p':
+			if (parse_long(optarg, 1, 1024, &value) < 0) {
+				fprintf(stderr, "invalid number of processes: %s\n", optarg);
+				exit(127);
+			}
+			processes = value;
+			break;
+		case 'r':
+			if (parse_range(optarg) < 0) {
+				fprintf(stderr, "invalid sample range: %s\n", optarg);
+				exit(127);
+			}
+			break;
+		case 's':
+			if (parse_long(optarg, FFT_EVAL_MIN_FREQ, FFT_EVAL_MAX_FREQ,
+				       &startfreq) < 0) {
+				fprintf(stderr, "invalid start frequency: %s\n", optarg);
+				exit(127);
+			}
+			break;
+		case 'v':
+			value = parse_name(view_names, ARRAY_SIZE(view_names), optarg);
+			if (value < 0) {
+				fprintf(stderr, "invalid view: %s\n", optarg);
+				exit(127);
+			}
+			view = value;
+			break;
+		case 'W':
+			if (parse_long(optarg, 1, 16384, &value) < 0) {
+				fprintf(stderr, "invalid width: %s\n", optarg);
+				exit(127);
+			}
+			width = value;
+			break;
+		case 'z':
+			if (parse_long(optarg, ZOOM_MIN, ZOOM_MAX, &value) < 0) {
+				fprintf(stderr, "invalid zoom: %s\n", optarg);
+				exit(127);
+			}
+			zoom = value;
+			break;
+		case 'h':
+			usage(prog);
+			exit(127);
+		default:
+			if (fft_eval_parse_option(ch, optarg) == 0)
+				break;
+
+			usage(prog);
+			exit(127);
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (argc < 1) {
+		usage(prog);
+		exit(127);
+	}
+
+	if (zoom != 0 && view != VIEW_SAMPLES) {
+		fprintf(stderr, "only the samples view can be zoomed\n");
+		exit(127);
+	}
+
+	failed = render_files(argv, argc);
+	if (failed)
+		fprintf(stderr, "%d of %d scanfiles couldn't be rendered\n",
+			failed, argc);
+
+	fft_eval_exit();
+
+	return failed ? -1 : 0;
+}
@@ -0,0 +1,260 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * SPDX-FileCopyrightText: 2026 Simon Wunderlich <sw@simonwunderlich.de>
+ */
+
+/*
+ * Lookup of samples by TSF.
+ *
+ * The store already finds a sample by its number. The index adds all
+ * samples sorted by TSF, so the sample at a given time is found by a binary
+ * search. Samples are usually already in TSF order, sorting is skipped then.
+ *
+ * The index can be kept next to the dump in <dump>.idx. The file only
+ * matches the dump with the same size, modification time and number of
+ * samples and is rejected otherwise. The samples themselves are not
+ * compared, loading must stay cheaper than sorting them again:
+ *
+ *   header          struct index_header, host endian
+ *   by_tsf[samples] struct fft_eval_tsf_entry, sorted by TSF
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "fft_eval.h"
+
+#define INDEX_MAGIC		"FFTIDX\0\2"
+#define INDEX_BYTE_ORDER	0x01020304
+
+struct index_header {
+	char magic[8];
+	u32 byte_order;
+	u32 reserved;
+	u64 dump_size;
+	u64 dump_mtime;
+	u64 samples;
+};
+
+static int cmp_tsf_entry(const void *a, const void *b)
+{
+	const struct fft_eval_tsf_entry *x = a;
+	const struct fft_eval_tsf_entry *y = b;
+
+	if (x->tsf != y->tsf)
+		return x->tsf < y->tsf ? -1 : 1;
+
+	return (x->rnum > y->rnum) - (x->rnum < y->rnum);
+}
+
+/*
+ * fft_eval_index_build - sorts all samples of a store by TSF
+ *
+ * returns 0 on success, -1 if memory ran out.
+ */
+int fft_eval_index_build(struct fft_eval_index *index,
+			 const struct fft_eval_store *store)
+{
+	int sorted = 1;
+	size_t i;
+
+	index->n = 0;
+	index->by_tsf = malloc((store->n ? store->n : 1) *
+			       sizeof(*index->by_tsf));
+	if (!index->by_tsf)
+		return -1;
+
+	for (i = 0; i < store->n; i++) {
+		index->by_tsf[i].tsf = store->tsf[i];
+		index->by_tsf[i].rnum = i;
+
+		if (i > 0 && store->tsf[i] < store->tsf[i - 1])
+			sorted = 0;
+	}
+
+	if (!sorted)
+		qsort(index->by_tsf, store->n, sizeof(*index->by_tsf),
+		      cmp_tsf_entry);
+
+	index->n = store->n;
+
+	return 0;
+}
+
+void fft_eval_index_free(struct fft_eval_index *index)
+{
+	free(index->by_tsf);
+	index->by_tsf = NULL;
+	index->n = 0;
+}
+
+/*
+ * fft_eval_index_seek_tsf - finds the first sample at or after a TSF
+ *
+ * returns the number of the sample, the one with the largest TSF when all
+ * samples are older. The index must not be empty.
+ */
+size_t fft_eval_index_seek_tsf(const struct fft_eval_index *index, u64 tsf)
+{
+	size_t first = 0, last = index->n;
+	size_t mid;
+
+	while (first < last) {
+		mid = first + (last - first) / 2;
+
+		if (index->by_tsf[mid].tsf < tsf)
+			first = mid + 1;
+		else
+			last = mid;
+	}
+
+	if (first == index->n)
+		first--;
+
+	return index->by_tsf[first].rnum;
+}
+
+static char *index_name(const char *fname)
+{
+	size_t len = strlen(fname);
+	char *name;
+
+	name = malloc(len + sizeof(".idx"));
+	if (!name)
+		return NULL;
+
+	memcpy(name, fname, len);
+	memcpy(name + len, ".idx", sizeof(".idx"));
+
+	return name;
+}
+
+static int index_header_init(struct index_header *header, const char *fname,
+			     size_t samples)
+{
+	struct stat st;
+
+	if (stat(fname, &st) < 0)
+		return -1;
+
+	/* the identity of pipes and character devices says nothing */
+	if (!S_ISREG(st.st_mode)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, INDEX_MAGIC, sizeof(header->magic));
+	header->byte_order = INDEX_BYTE_ORDER;
+	header->dump_size = st.st_size;
+	header->dump_mtime = st.st_mtime;
+	header->samples = samples;
+
+	return 0;
+}
+
+/*
+ * fft_eval_index_load - reads the index of a dump from <fname>.idx
+ *
+ * @index: returns the index
+ * @store: samples read from the dump
+ * @fname: file name of the dump
+ *
+ * returns 0 on success, -1 when there is no index file or it doesn't match
+ * the dump.
+ */
+int fft_eval_index_load(struct fft_eval_index *index,
+			const struct fft_eval_store *store, const char *fname)
+{
+	struct index_header expected, header;
+	char *name;
+	FILE *fp;
+	size_t i;
+
+	memset(index, 0, sizeof(*index));
+
+	if (index_header_init(&expected, fname, store->n) < 0)
+		return -1;
+
+	name = index_name(fname);
+	if (!name)
+		return -1;
+
+	fp = fopen(name, "rb");
+	free(name);
+	if (!fp)
+		return -1;
+
+	if (fread(&header, sizeof(header), 1, fp) != 1 ||
+	    memcmp(&header, &expected, sizeof(header)) != 0)
+		goto err;
+
+	index->by_tsf = malloc((store->n ? store->n : 1) *
+			       sizeof(*index->by_tsf));
+	if (!index->by_tsf)
+		goto err;
+
+	if (fread(index->by_tsf, sizeof(*index->by_tsf), store->n, fp) !=
+	    store->n)
+		goto err;
+
+	for (i = 0; i < store->n; i++) {
+		if (index->by_tsf[i].rnum >= store->n)
+			goto err;
+	}
+
+	index->n = store->n;
+	fclose(fp);
+
+	return 0;
+
+err:
+	fft_eval_index_free(index);
+	fclose(fp);
+
+	return -1;
+}
+
+/*
+ * fft_eval_index_save - writes the index of a dump to <fname>.idx
+ *
+ * returns 0 on success, -1 on error.
+ */
+int fft_eval_index_save(const struct fft_eval_index *index, const char *fname)
+{
+	struct index_header header;
+	char *name;
+	FILE *fp;
+	int ret = 0;
+
+	if (index_header_init(&header, fname, index->n) < 0)
+		return -1;
+
+	name = index_name(fname);
+	if (!name)
+		return -1;
+
+	fp = fopen(name, "wb");
+	if (!fp) {
+		free(name);
+		return -1;
+	}
+
+	if (fwrite(&header, sizeof(header), 1, fp) != 1 ||
+	    fwrite(index->by_tsf, sizeof(*index->by_tsf), index->n, fp) !=
+	    index->n)
+		ret = -1;
+
+	if (fclose(fp) != 0)
+		ret = -1;
+
+	/* a partial index would only be rejected when it is loaded */
+	if (ret < 0)
+		remove(name);
+
+	free(name);
+
+	return ret;
+}
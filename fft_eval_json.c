@@ -11,236 +11,243 @@
  * based chipsets.
  */
 
-#include <inttypes.h>
-#include <math.h>
+#include <getopt.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "fft_eval.h"
 
+static struct fft_eval_writer out;
+
+/* one JSON object per line instead of a single array */
+static int ndjson;
+
+/*
+ * flush policy: the output is written after every flush_records samples
+ * and when flush_interval seconds have passed since the last write. With
+ * an interval, printed samples are also written before the reader waits
+ * for more input, so they are never held back while the input is idle.
+ * With neither set, output is only written when the buffer is full.
+ */
+static unsigned long flush_records;
+static double flush_interval;
+static unsigned long pending_records;
+static double last_flush;
+
+/* samples printed, and skipped because they couldn't be decoded */
+static size_t printed;
+static size_t skipped;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * parse_flush_policy - parses the argument of -f
+ *
+ * "record" flushes after every sample, a plain number N after every N
+ * samples, and a number with the suffix "ms" or "s" after that interval.
+ *
+ * returns 0 on success, -1 on invalid input.
+ */
+static int parse_flush_policy(const char *arg)
+{
+	char *end;
+	double value;
+
+	if (strcmp(arg, "record") == 0) {
+		flush_records = 1;
+		return 0;
+	}
+
+	value = strtod(arg, &end);
+	if (end == arg || value <= 0)
+		return -1;
+
+	if (strcmp(end, "ms") == 0) {
+		flush_interval = value / 1000;
+	} else if (strcmp(end, "s") == 0) {
+		flush_interval = value;
+	} else if (*end == '\0' && value == (unsigned long)value) {
+		flush_records = value;
+	} else {
+		return -1;
+	}
+
+	return 0;
+}
+
+static int flush_output(void)
+{
+	int ret;
+
+	ret = fft_eval_writer_flush(&out);
+	pending_records = 0;
+	if (flush_interval > 0)
+		last_flush = now();
+
+	return ret;
+}
+
+/*
+ * sample_done - flushes the output according to the flush policy
+ *
+ * returns 0 on success, -1 if the output could not be written.
+ */
+static int sample_done(void)
+{
+	pending_records++;
+
+	if (flush_records && pending_records >= flush_records)
+		return flush_output();
+
+	if (flush_interval > 0 && now() - last_flush >= flush_interval)
+		return flush_output();
+
+	return 0;
+}
+
+/*
+ * input_idle - writes the pending samples before the reader waits for input
+ *
+ * An error is kept in out.error and noticed by the next print_sample().
+ */
+static void input_idle(void *arg)
+{
+	(void)arg;
+
+	if (pending_records)
+		flush_output();
+}
+
+static void print_start(void)
+{
+	if (flush_interval > 0)
+		last_flush = now();
+
+	if (!ndjson)
+		fft_eval_write_lit(&out, "[");
+}
+
+static void print_end(void)
+{
+	if (!ndjson)
+		fft_eval_write_lit(&out, "\n]\n");
+
+	if (skipped)
+		fprintf(stderr, "skipped %zu samples which couldn't be decoded\n",
+			skipped);
+}
+
+/*
+ * print_sample - spit out the analyzed values of one sample, JSON-like.
+ *
+ * Samples which can't be decoded are skipped before anything was written.
+ *
+ * returns 0 on success, -1 if the output could not be written.
+ */
+static int print_sample(const struct fft_eval_sample *sample)
+{
+	static struct fft_eval_spectrum spectrum;
+
+	if (fft_eval_decode(sample, &spectrum, FFT_EVAL_DECODE_HT20_20MHZ |
+			    FFT_EVAL_DECODE_ATH11K_RAW) < 0) {
+		skipped++;
+		return 0;
+	}
+
+	if (!ndjson) {
+		if (printed > 0)
+			fft_eval_write_lit(&out, ",");
+
+		fft_eval_write_lit(&out, "\n");
+	}
+
+	fft_eval_write_json(&out, sample, &spectrum);
+
+	if (ndjson)
+		fft_eval_write_lit(&out, "\n");
+
+	printed++;
+	if (sample_done() < 0)
+		return -1;
+
+	return out.error ? -1 : 0;
+}
+
 /*
  * print_values - spit out the analyzed values in text form, JSON-like.
+ *
+ * returns 0 on success, -1 if the output could not be written.
  */
 static int print_values(void)
 {
-	int i, rnum;
-	struct scanresult *result;
-
-	printf("[");
-	rnum = 0;
-	for (result = result_list; result; result = result->next) {
-
-		switch (result->sample.tlv.type) {
-
-		case ATH_FFT_SAMPLE_HT20:
-			{
-				int datamax = 0, datamin = 65536;
-				int datasquaresum = 0;
-
-				/* prints some statistical data about the
-				 * data sample and auxiliary data. */
-				printf("\n{ \"tsf\": %" PRIu64 ", \"central_freq\": %d, \"rssi\": %d, \"noise\": %d, \"data\": [ ", result->sample.ht20.tsf, result->sample.ht20.freq, result->sample.ht20.rssi,
-				       result->sample.ht20.noise);
-				for (i = 0; i < SPECTRAL_HT20_NUM_BINS; i++) {
-					int data;
-					data = (result->sample.ht20.data[i] << result->sample.ht20.max_exp);
-					data *= data;
-					datasquaresum += data;
-					if (data > datamax)
-						datamax = data;
-					if (data < datamin)
-						datamin = data;
-				}
-				for (i = 0; i < SPECTRAL_HT20_NUM_BINS; i++) {
-					float freq;
-					float signal;
-					int data;
-					freq = result->sample.ht20.freq - 10.0 + ((20.0 * i) / SPECTRAL_HT20_NUM_BINS);
-
-					/* This is where the "magic" happens: interpret the signal
-					 * to output some kind of data which looks useful.  */
-
-					data = result->sample.ht20.data[i] << result->sample.ht20.max_exp;
-					if (data == 0)
-						data = 1;
-					signal = result->sample.ht20.noise + result->sample.ht20.rssi + 20 * log10(data) - log10(datasquaresum) * 10;
-
-					printf("[ %f, %f ]", freq, signal);
-					if (i < SPECTRAL_HT20_NUM_BINS - 1)
-						printf(", ");
-				}
-			}
-			break;
-		case ATH_FFT_SAMPLE_HT20_40:
-			{
-				int datamax = 0, datamin = 65536;
-				int datasquaresum_lower = 0;
-				int datasquaresum_upper = 0;
-				int datasquaresum;
-				int i;
-				int centerfreq;
-				s8 noise;
-				s8 rssi;
-				//todo build average
-
-				printf("\n{ \"tsf\": %" PRIu64 ", \"central_freq\": %d, \"rssi\": %d, \"noise\": %d, \"data\": [ ", result->sample.ht40.tsf, result->sample.ht40.freq, result->sample.ht40.lower_rssi,
-				       result->sample.ht40.lower_noise);
-				for (i = 0; i < SPECTRAL_HT20_40_NUM_BINS / 2; i++) {
-					int data;
-
-					data = result->sample.ht40.data[i];
-					data <<= result->sample.ht40.max_exp;
-					data *= data;
-					datasquaresum_lower += data;
-
-					if (data > datamax)
-						datamax = data;
-					if (data < datamin)
-						datamin = data;
-				}
-
-				for (i = SPECTRAL_HT20_40_NUM_BINS / 2; i < SPECTRAL_HT20_40_NUM_BINS; i++) {
-					int data;
-
-					data = result->sample.ht40.data[i];
-					data <<= result->sample.ht40.max_exp;
-					datasquaresum_upper += data;
-
-					if (data > datamax)
-						datamax = data;
-					if (data < datamin)
-						datamin = data;
-				}
-
-				switch (result->sample.ht40.channel_type) {
-				case NL80211_CHAN_HT40PLUS:
-					centerfreq = result->sample.ht40.freq + 10;
-					break;
-				case NL80211_CHAN_HT40MINUS:
-					centerfreq = result->sample.ht40.freq - 10;
-					break;
-				default:
-					return -1;
-				}
-
-				for (i = 0; i < SPECTRAL_HT20_40_NUM_BINS; i++) {
-					float freq;
-					int data;
-
-					freq = centerfreq - (40.0 * SPECTRAL_HT20_40_NUM_BINS / 128.0) / 2 + (40.0 * (i + 0.5) / 128.0);
-
-					if (i < SPECTRAL_HT20_40_NUM_BINS / 2) {
-						noise = result->sample.ht40.lower_noise;
-						datasquaresum = datasquaresum_lower;
-						rssi = result->sample.ht40.lower_rssi;
-					} else {
-						noise = result->sample.ht40.upper_noise;
-						datasquaresum = datasquaresum_upper;
-						rssi = result->sample.ht40.upper_rssi;
-					}
-
-					data = result->sample.ht40.data[i];
-					data <<= result->sample.ht40.max_exp;
-					if (data == 0)
-						data = 1;
-
-					float signal = noise + rssi + 20 * log10(data) - log10(datasquaresum) * 10;
-
-					printf("[ %f, %f ]", freq, signal);
-					if (i < SPECTRAL_HT20_40_NUM_BINS - 1)
-						printf(", ");
-				}
-			}
-			break;
-		case ATH_FFT_SAMPLE_ATH10K:
-			{
-				int datamax = 0, datamin = 65536;
-				int datasquaresum = 0;
-				int i, bins;
-				printf("\n{ \"tsf\": %" PRIu64 ", \"central_freq\": %d, \"rssi\": %d, \"noise\": %d, \"data\": [ ", result->sample.ath10k.header.tsf, result->sample.ath10k.header.freq1,
-				       result->sample.ath10k.header.rssi, result->sample.ath10k.header.noise);
-
-				bins = result->sample.tlv.length - (sizeof(result->sample.ath10k.header) - sizeof(result->sample.ath10k.header.tlv));
-
-				for (i = 0; i < bins; i++) {
-					int data;
-
-					data = (result->sample.ath10k.data[i] << result->sample.ath10k.header.max_exp);
-					data *= data;
-					datasquaresum += data;
-					if (data > datamax)
-						datamax = data;
-					if (data < datamin)
-						datamin = data;
-				}
-
-				for (i = 0; i < bins; i++) {
-					float freq;
-					int data;
-					float signal;
-					freq = result->sample.ath10k.header.freq1 - (result->sample.ath10k.header.chan_width_mhz) / 2 + (result->sample.ath10k.header.chan_width_mhz * (i + 0.5) / bins);
-
-					data = result->sample.ath10k.data[i] << result->sample.ath10k.header.max_exp;
-					if (data == 0)
-						data = 1;
-					signal = result->sample.ath10k.header.noise + result->sample.ath10k.header.rssi + 20 * log10(data) - log10(datasquaresum) * 10;
-					printf("[ %f, %f ]", freq, signal);
-					if (i < bins - 1)
-						printf(", ");
-
-				}
+	struct fft_eval_sample sample;
+	size_t rnum;
 
-			}
-			break;
-		case ATH_FFT_SAMPLE_ATH11K:
-			{
-				int datamax = 0, datamin = 65536;
-				int datasquaresum = 0;
-				int i, bins;
-				printf("\n{ \"tsf\": %08d, \"central_freq\": %d, \"rssi\": %d, \"noise\": %d, \"data\": [ ", result->sample.ath11k.header.tsf, result->sample.ath11k.header.freq1,
-				       result->sample.ath11k.header.rssi, result->sample.ath11k.header.noise);
-
-				bins = result->sample.tlv.length - (sizeof(result->sample.ath11k.header) - sizeof(result->sample.ath11k.header.tlv));
-
-				for (i = 0; i < bins; i++) {
-					int data;
-
-					data = result->sample.ath11k.data[i];
-					data *= data;
-					datasquaresum += data;
-					if (data > datamax)
-						datamax = data;
-					if (data < datamin)
-						datamin = data;
-				}
-
-				for (i = 0; i < bins; i++) {
-					float freq;
-					int data;
-					float signal;
-					freq = result->sample.ath11k.header.freq1 - (result->sample.ath11k.header.chan_width_mhz) / 2 + (result->sample.ath11k.header.chan_width_mhz * (i + 0.5) / bins);
-
-					data = result->sample.ath11k.data[i];
-					if (data == 0)
-						data = 1;
-					signal = result->sample.ath11k.header.noise + result->sample.ath11k.header.rssi + 20 * log10f(data) - log10f(datasquaresum) * 10;
-					printf("[ %f, %f ]", freq, signal);
-					if (i < bins - 1)
-						printf(", ");
-
-				}
-			}
+	fft_eval_stage_enter(FFT_EVAL_STAGE_EMIT);
+
+	print_start();
+	for (rnum = 0; rnum < result_store.n; rnum++) {
+		fft_eval_store_get(&result_store, rnum, &sample);
+
+		if (print_sample(&sample) < 0)
+			return -1;
+	}
+	print_end();
+
+	return out.error ? -1 : 0;
+}
+
+/*
+ * stream_values - like print_values but decodes and prints one sample at a
+ * time while the dump is read. Memory usage does not depend on the size of
+ * the input.
+ *
+ * returns 0 on success, -1 if the dump could not be opened and -2 if the
+ * output could not be written.
+ */
+static int stream_values(char *fname)
+{
+	static struct fft_eval_reader reader;
+	struct fft_eval_sample sample;
+	int ret = 0;
+
+	if (fft_eval_reader_open(&reader, fname) < 0)
+		return -1;
+
+	if (flush_interval > 0)
+		reader.idle = input_idle;
+
+	fft_eval_stage_enter(FFT_EVAL_STAGE_EMIT);
+
+	print_start();
+	while (fft_eval_reader_next(&reader, &sample) > 0) {
+		if (print_sample(&sample) < 0) {
+			ret = -2;
 			break;
 		}
+	}
 
-		printf(" ] }");
-		if (result->next)
-			printf(",");
-		rnum++;
+	if (ret == 0) {
+		print_end();
+		if (out.error)
+			ret = -2;
 	}
-	printf("\n]\n");
 
-	return 0;
+	fprintf(stderr, "read %zu scan results\n", reader.samples);
+	fft_eval_reader_close(&reader);
+
+	return ret;
 }
 
 static void usage(const char *prog)
@@ -248,32 +255,130 @@ static void usage(const char *prog)
 	if (!prog)
 		prog = "fft_eval";
 
-	fprintf(stderr, "Usage: %s scanfile\n", prog);
+	fprintf(stderr, "Usage: %s [-n] [-s] [-f policy] [-p precision] [-j threads]\n", prog);
+	fprintf(stderr, "       [--stats[=file]] scanfile\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  -n  NDJSON: print one sample object per line\n");
+	fprintf(stderr, "  -s  stream: print each sample as soon as it was read\n");
+	fprintf(stderr, "      (implied when scanfile is \"-\" for stdin)\n");
+	fprintf(stderr, "  -f  flush output after every sample (\"record\"), after every\n");
+	fprintf(stderr, "      N samples (\"N\") or after an interval (\"Nms\", \"Ns\")\n");
+	fprintf(stderr, "      (default: \"record\" in stream mode, otherwise only\n");
+	fprintf(stderr, "      when the output buffer is full)\n");
+	fprintf(stderr, "  -p  number of decimals for frequency and signal (default: 6,\n");
+	fprintf(stderr, "      identical to the output of older versions)\n");
 	fft_eval_usage(prog);
 }
 
 int main(int argc, char *argv[])
 {
+	static const struct option long_options[] = {
+		FFT_EVAL_LONGOPTS,
+		{ NULL, 0, NULL, 0 },
+	};
+	int ch;
+	int ret;
+	int stream = 0;
+	int flush_policy = 0;
+	int precision = 6;
+	long val;
+	char *end;
 	char *ss_name = NULL;
 	char *prog = NULL;
 
 	if (argc >= 1)
 		prog = argv[0];
 
-	if (argc >= 2)
-		ss_name = argv[1];
+	while ((ch = getopt_long(argc, argv, "f:hnp:s" FFT_EVAL_OPTSTRING,
+				 long_options, NULL)) != -1) {
+		switch (ch) {
+		case 'f':
+			if (parse_flush_policy(optarg) < 0) {
+				fprintf(stderr, "invalid flush policy: %s\n", optarg);
+				exit(127);
+			}
+			flush_policy = 1;
+			break;
+		case 'n':
+			ndjson = 1;
+			break;
+		case 's':
+			stream = 1;
+			break;
+		case 'p':
+			val = strtol(optarg, &end, 0);
+			if (*end != '\0' || end == optarg || val < 0 || val > 9) {
+				fprintf(stderr, "precision must be between 0 and 9\n");
+				exit(127);
+			}
+			precision = val;
+			break;
+		case 'h':
+			usage(prog);
+			exit(127);
+		default:
+			if (fft_eval_parse_option(ch, optarg) == 0)
+				break;
+
+			usage(prog);
+			exit(127);
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (argc >= 1)
+		ss_name = argv[0];
+
+	if (ss_name && strcmp(ss_name, "-") == 0)
+		stream = 1;
+
+	if (stream && !flush_policy)
+		flush_records = 1;
 
 	fprintf(stderr, "WARNING: Experimental Software! Don't trust anything you see. :)\n");
 	fprintf(stderr, "\n");
 
+	if (fft_eval_writer_init(&out, STDOUT_FILENO, FFT_EVAL_WRITER_SIZE) < 0) {
+		fprintf(stderr, "Couldn't allocate output buffer\n");
+		return -1;
+	}
+	out.precision = precision;
+
+	if (stream) {
+		ret = stream_values(ss_name);
+		if (ret == -1) {
+			fprintf(stderr, "Couldn't read scanfile ...\n");
+			usage(prog);
+			fft_eval_writer_free(&out);
+			return -1;
+		}
+
+		if (fft_eval_writer_free(&out) < 0)
+			ret = -1;
+
+		if (ret < 0)
+			fprintf(stderr, "Couldn't write the output\n");
+
+		fft_eval_exit();
+		return ret < 0 ? -1 : 0;
+	}
+
 	if (fft_eval_init(ss_name) < 0) {
 		fprintf(stderr, "Couldn't read scanfile ...\n");
 		usage(prog);
+		fft_eval_writer_free(&out);
 		return -1;
 	}
 
-	print_values();
+	ret = print_values();
+	if (fft_eval_writer_free(&out) < 0)
+		ret = -1;
+
+	if (ret < 0)
+		fprintf(stderr, "Couldn't write the output\n");
+
 	fft_eval_exit();
 
-	return 0;
+	return ret;
 }
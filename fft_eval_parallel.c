@@ -0,0 +1,262 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * SPDX-FileCopyrightText: 2026 Simon Wunderlich <sw@simonwunderlich.de>
+ */
+
+/*
+ * Parallel parsing of mapped dumps.
+ *
+ * The dump is split into one chunk per thread. The start of each chunk is
+ * moved forward to the first position which looks like a chain of valid
+ * TLVs, then every thread decodes its chunk into its own store. A TLV chain
+ * is only defined by the TLV lengths from the start of the file, so the
+ * guessed chunk starts are verified afterwards: a chunk whose start is not
+ * exactly where the chain of the previous chunk ended is parsed again from
+ * the correct position. The result is therefore always identical to the
+ * serial parser.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fft_eval.h"
+
+/* number of consecutive plausible TLVs required to accept a chunk start */
+#define SYNC_TLVS		8
+
+/*
+ * number of rejected TLVs per chunk which are passed on to
+ * fft_eval_report_reject(), which only prints the first few anyway
+ */
+#define REJECT_LOG		64
+
+struct parse_chunk {
+	const u8 *data;
+	size_t len;
+
+	size_t start;
+	size_t end;
+	size_t stop;
+	int truncated;
+
+	struct fft_eval_counts counts;
+	size_t rejects;
+	size_t reject_pos[REJECT_LOG];
+
+	struct fft_eval_store store;
+	pthread_t thread;
+	int failed;
+};
+
+/*
+ * plausible_chain - checks whether a chain of valid TLVs starts at pos
+ *
+ * The checks of fft_eval_check_tlv() are used for every TLV of the chain.
+ * Samples with zero noise are structurally valid and are accepted here.
+ */
+static int plausible_chain(const u8 *data, size_t len, size_t pos)
+{
+	const struct fft_sample_tlv *tlv;
+	enum fft_eval_reject reason;
+	size_t sample_len;
+	int i;
+
+	for (i = 0; i < SYNC_TLVS; i++) {
+		if (pos == len)
+			return 1;
+
+		if (len - pos < sizeof(*tlv))
+			return 0;
+
+		tlv = (const struct fft_sample_tlv *)(data + pos);
+		sample_len = sizeof(*tlv) + fft_eval_tlv_length(tlv);
+		if (len - pos < sample_len)
+			return 0;
+
+		reason = fft_eval_check_tlv(tlv, sample_len);
+		if (reason != FFT_EVAL_ACCEPT &&
+		    reason != FFT_EVAL_REJECT_ZERO_NOISE)
+			return 0;
+
+		pos += sample_len;
+	}
+
+	return 1;
+}
+
+static size_t find_chunk_start(const u8 *data, size_t len, size_t pos)
+{
+	for (; pos < len; pos++) {
+		if (plausible_chain(data, len, pos))
+			return pos;
+	}
+
+	return len;
+}
+
+/*
+ * parse_chunk - decodes all TLVs starting in [chunk->start, chunk->end)
+ *
+ * TLVs which start before chunk->end may extend past it. chunk->stop is set
+ * to the position after the last TLV of the chunk.
+ */
+static void *parse_chunk(void *arg)
+{
+	struct parse_chunk *chunk = arg;
+	struct fft_eval_cursor cursor;
+	const struct fft_sample_tlv *tlv;
+	enum fft_eval_reject reason;
+	size_t sample_len;
+
+	fft_eval_cursor_init(&cursor, chunk->data, chunk->len);
+	cursor.pos = chunk->start;
+
+	chunk->truncated = 0;
+	chunk->failed = 0;
+	chunk->rejects = 0;
+	memset(&chunk->counts, 0, sizeof(chunk->counts));
+
+	while (cursor.pos < chunk->end) {
+		tlv = fft_eval_cursor_next(&cursor, &sample_len);
+		if (!tlv) {
+			chunk->truncated = 1;
+			break;
+		}
+
+		reason = fft_eval_select_tlv(tlv, sample_len);
+		fft_eval_count_tlv(&chunk->counts, tlv, sample_len, reason);
+		if (reason == FFT_EVAL_REJECT_ZERO_NOISE ||
+		    reason == FFT_EVAL_REJECT_FILTERED)
+			continue;
+
+		if (reason != FFT_EVAL_ACCEPT) {
+			if (chunk->rejects < REJECT_LOG)
+				chunk->reject_pos[chunk->rejects] = cursor.pos - sample_len;
+			chunk->rejects++;
+			continue;
+		}
+
+		if (fft_eval_store_add(&chunk->store, tlv, sample_len,
+				       cursor.pos - sample_len) < 0)
+			chunk->failed = 1;
+	}
+
+	chunk->stop = cursor.pos;
+
+	return NULL;
+}
+
+static void report_rejects(const struct parse_chunk *chunk)
+{
+	const struct fft_sample_tlv *tlv;
+	size_t sample_len;
+	size_t i;
+
+	for (i = 0; i < chunk->rejects && i < REJECT_LOG; i++) {
+		tlv = (const struct fft_sample_tlv *)(chunk->data + chunk->reject_pos[i]);
+		sample_len = sizeof(*tlv) + fft_eval_tlv_length(tlv);
+
+		fft_eval_report_reject(&fft_eval_stats, tlv, sample_len,
+				       fft_eval_check_tlv(tlv, sample_len));
+	}
+
+	if (chunk->rejects > REJECT_LOG)
+		fft_eval_stats.suppressed += chunk->rejects - REJECT_LOG;
+}
+
+/*
+ * fft_eval_parse_parallel - decodes a mapped dump using multiple threads
+ *
+ * @data: dump in wire format
+ * @len: length of the dump
+ * @threads: number of threads to use
+ * @store: store to which the decoded samples are appended in file order
+ * @end: set to the position after the last complete TLV
+ *
+ * returns 0 on success, -1 if the decoded samples couldn't be stored.
+ */
+int fft_eval_parse_parallel(const u8 *data, size_t len, int threads,
+			    struct fft_eval_store *store, size_t *end)
+{
+	struct parse_chunk *chunks;
+	size_t expected = 0;
+	size_t start;
+	int started;
+	int ret = 0;
+	int i;
+
+	/* the caller parses the whole dump serially */
+	*end = 0;
+
+	chunks = calloc(threads, sizeof(*chunks));
+	if (!chunks)
+		return 0;
+
+	for (i = 0; i < threads; i++) {
+		chunks[i].data = data;
+		chunks[i].len = len;
+
+		if (i == 0) {
+			chunks[i].start = 0;
+			continue;
+		}
+
+		start = len / threads * i;
+		if (start < chunks[i - 1].start)
+			start = chunks[i - 1].start;
+
+		chunks[i].start = find_chunk_start(data, len, start);
+		chunks[i - 1].end = chunks[i].start;
+	}
+	chunks[threads - 1].end = len;
+
+	for (i = 1; i < threads; i++) {
+		if (pthread_create(&chunks[i].thread, NULL, parse_chunk,
+				   &chunks[i]) != 0)
+			break;
+	}
+	started = i;
+
+	parse_chunk(&chunks[0]);
+
+	for (i = 1; i < started; i++)
+		pthread_join(chunks[i].thread, NULL);
+
+	for (i = started; i < threads; i++)
+		parse_chunk(&chunks[i]);
+
+	for (i = 0; i < threads; i++) {
+		if (chunks[i].start != expected) {
+			/* the guessed start was not on the TLV chain */
+			fft_eval_store_free(&chunks[i].store);
+			chunks[i].start = expected;
+			parse_chunk(&chunks[i]);
+		}
+
+		report_rejects(&chunks[i]);
+		fft_eval_counts_add(&fft_eval_stats.counts, &chunks[i].counts);
+
+		if (chunks[i].failed ||
+		    fft_eval_store_append(store, &chunks[i].store) < 0) {
+			fprintf(stderr, "Out of memory while parsing chunk at position 0x%zx\n",
+				chunks[i].start);
+			ret = -1;
+		}
+
+		fft_eval_store_free(&chunks[i].store);
+		expected = chunks[i].stop;
+
+		if (ret < 0 || chunks[i].truncated)
+			break;
+	}
+
+	for (i++; i < threads; i++)
+		fft_eval_store_free(&chunks[i].store);
+
+	free(chunks);
+
+	*end = expected;
+
+	return ret;
+}
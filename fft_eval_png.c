@@ -0,0 +1,341 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * SPDX-FileCopyrightText: 2026 Simon Wunderlich <sw@simonwunderlich.de>
+ */
+
+/*
+ * Image files of a canvas, without depending on an image library.
+ *
+ * PPM is written as is. PNG uses the "up" filter on every row and a single
+ * deflate block with the fixed Huffman codes, which only knows runs of
+ * repeated bytes or pixels. That is all a plot needs: the background and
+ * unchanged rows turn into long runs of zeros, while the samples themselves
+ * are stored as literals.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fft_eval.h"
+
+#define ARRAY_SIZE(x)	(sizeof(x) / sizeof((x)[0]))
+
+#define PNG_FILTER_UP	2
+
+#define DEFLATE_MIN_MATCH	3
+#define DEFLATE_MAX_MATCH	258
+
+struct bit_writer {
+	u8 *buf;
+	size_t len;
+	u32 bits;
+	int nbits;
+};
+
+static const u16 length_base[] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+
+static const u8 length_extra[] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+
+static u32 crc_table[256];
+static int crc_table_ready = 0;
+
+static void crc_table_init(void)
+{
+	u32 crc;
+	int i, bit;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (bit = 0; bit < 8; bit++)
+			crc = crc & 1 ? 0xedb88320 ^ (crc >> 1) : crc >> 1;
+		crc_table[i] = crc;
+	}
+
+	crc_table_ready = 1;
+}
+
+static u32 crc32_update(u32 crc, const u8 *data, size_t len)
+{
+	size_t i;
+
+	crc = ~crc;
+	for (i = 0; i < len; i++)
+		crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+static u32 adler32(const u8 *data, size_t len)
+{
+	u32 a = 1, b = 0;
+	size_t chunk;
+
+	while (len > 0) {
+		/* largest chunk which cannot overflow b */
+		chunk = len < 5552 ? len : 5552;
+		len -= chunk;
+
+		while (chunk--) {
+			a += *data++;
+			b += a;
+		}
+
+		a %= 65521;
+		b %= 65521;
+	}
+
+	return b << 16 | a;
+}
+
+static void put_be32(u8 *out, u32 value)
+{
+	out[0] = value >> 24;
+	out[1] = value >> 16;
+	out[2] = value >> 8;
+	out[3] = value;
+}
+
+/* adds bits, least significant bit first */
+static void put_bits(struct bit_writer *bw, u32 value, int nbits)
+{
+	bw->bits |= value << bw->nbits;
+	bw->nbits += nbits;
+
+	while (bw->nbits >= 8) {
+		bw->buf[bw->len++] = bw->bits;
+		bw->bits >>= 8;
+		bw->nbits -= 8;
+	}
+}
+
+/* adds a Huffman code, which is stored most significant bit first */
+static void put_code(struct bit_writer *bw, u32 code, int nbits)
+{
+	u32 reversed = 0;
+	int i;
+
+	for (i = 0; i < nbits; i++)
+		reversed |= ((code >> i) & 1) << (nbits - 1 - i);
+
+	put_bits(bw, reversed, nbits);
+}
+
+/* literal/length symbol with the fixed Huffman code */
+static void put_symbol(struct bit_writer *bw, int symbol)
+{
+	if (symbol < 144)
+		put_code(bw, 0x30 + symbol, 8);
+	else if (symbol < 256)
+		put_code(bw, 0x190 + symbol - 144, 9);
+	else if (symbol < 280)
+		put_code(bw, symbol - 256, 7);
+	else
+		put_code(bw, 0xc0 + symbol - 280, 8);
+}
+
+static void put_match(struct bit_writer *bw, size_t len, int distance_code)
+{
+	size_t code = ARRAY_SIZE(length_base) - 1;
+
+	while (length_base[code] > len)
+		code--;
+
+	put_symbol(bw, 257 + code);
+	put_bits(bw, len - length_base[code], length_extra[code]);
+
+	/* distances 1 and 3 have no extra bits */
+	put_code(bw, distance_code, 5);
+}
+
+static size_t match_len(const u8 *data, size_t pos, size_t len,
+			size_t distance)
+{
+	size_t n = 0;
+
+	if (pos < distance)
+		return 0;
+
+	while (pos + n < len && n < DEFLATE_MAX_MATCH &&
+	       data[pos + n] == data[pos + n - distance])
+		n++;
+
+	return n;
+}
+
+/*
+ * zlib_compress - compresses data into a zlib stream
+ *
+ * @out: room for at least len * 9 / 8 + 16 bytes
+ *
+ * returns the length of the stream.
+ */
+static size_t zlib_compress(u8 *out, const u8 *data, size_t len)
+{
+	struct bit_writer bw = { .buf = out };
+	size_t pos = 0;
+	size_t run, pixel_run;
+
+	/* deflate, 32K window, no dictionary */
+	bw.buf[bw.len++] = 0x78;
+	bw.buf[bw.len++] = 0x01;
+
+	/* last block, fixed Huffman codes */
+	put_bits(&bw, 1, 1);
+	put_bits(&bw, 1, 2);
+
+	while (pos < len) {
+		run = match_len(data, pos, len, 1);
+		pixel_run = match_len(data, pos, len, 3);
+
+		if (run >= DEFLATE_MIN_MATCH && run >= pixel_run) {
+			put_match(&bw, run, 0);
+			pos += run;
+		} else if (pixel_run >= DEFLATE_MIN_MATCH) {
+			put_match(&bw, pixel_run, 2);
+			pos += pixel_run;
+		} else {
+			put_symbol(&bw, data[pos]);
+			pos++;
+		}
+	}
+
+	put_symbol(&bw, 256);
+	if (bw.nbits)
+		put_bits(&bw, 0, 8 - bw.nbits);
+
+	put_be32(&bw.buf[bw.len], adler32(data, len));
+	bw.len += 4;
+
+	return bw.len;
+}
+
+static void write_chunk(struct fft_eval_writer *writer, const char *type,
+			const u8 *data, size_t len)
+{
+	u8 header[8];
+	u8 crc[4];
+	u32 sum;
+
+	put_be32(header, len);
+	memcpy(&header[4], type, 4);
+
+	sum = crc32_update(0, &header[4], 4);
+	sum = crc32_update(sum, data, len);
+	put_be32(crc, sum);
+
+	fft_eval_write(writer, header, sizeof(header));
+	fft_eval_write(writer, data, len);
+	fft_eval_write(writer, crc, sizeof(crc));
+}
+
+static void canvas_rgb(const struct fft_eval_canvas *canvas, int y, u8 *rgb)
+{
+	const u32 *pixels = &canvas->pixels[(size_t)y * canvas->width];
+	int x;
+
+	for (x = 0; x < canvas->width; x++) {
+		rgb[x * 3 + 0] = (pixels[x] & FFT_EVAL_RMASK) >> FFT_EVAL_RBITS;
+		rgb[x * 3 + 1] = (pixels[x] & FFT_EVAL_GMASK) >> FFT_EVAL_GBITS;
+		rgb[x * 3 + 2] = (pixels[x] & FFT_EVAL_BMASK) >> FFT_EVAL_BBITS;
+	}
+}
+
+/*
+ * fft_eval_write_ppm - writes the canvas as binary PPM (P6)
+ *
+ * returns 0 on success, -1 on allocation failures.
+ */
+int fft_eval_write_ppm(struct fft_eval_writer *writer,
+		       const struct fft_eval_canvas *canvas)
+{
+	size_t stride = (size_t)canvas->width * 3;
+	u8 *rgb;
+	int y;
+
+	rgb = malloc(stride ? stride : 1);
+	if (!rgb)
+		return -1;
+
+	fft_eval_write_lit(writer, "P6\n");
+	fft_eval_write_u64(writer, canvas->width);
+	fft_eval_write_lit(writer, " ");
+	fft_eval_write_u64(writer, canvas->height);
+	fft_eval_write_lit(writer, "\n255\n");
+
+	for (y = 0; y < canvas->height; y++) {
+		canvas_rgb(canvas, y, rgb);
+		fft_eval_write(writer, rgb, stride);
+	}
+
+	free(rgb);
+
+	return 0;
+}
+
+/*
+ * fft_eval_write_png - writes the canvas as 8 bit RGB PNG
+ *
+ * returns 0 on success, -1 on allocation failures.
+ */
+int fft_eval_write_png(struct fft_eval_writer *writer,
+		       const struct fft_eval_canvas *canvas)
+{
+	static const u8 signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	size_t stride = (size_t)canvas->width * 3 + 1;
+	size_t raw_len = stride * canvas->height;
+	u8 *raw, *row, *prev, *zlib;
+	u8 ihdr[13];
+	size_t zlib_len;
+	size_t x;
+	int y;
+
+	if (!crc_table_ready)
+		crc_table_init();
+
+	raw = malloc(raw_len ? raw_len : 1);
+	zlib = malloc(raw_len * 9 / 8 + 16);
+	if (!raw || !zlib) {
+		free(raw);
+		free(zlib);
+		return -1;
+	}
+
+	for (y = 0; y < canvas->height; y++) {
+		row = &raw[y * stride];
+		row[0] = PNG_FILTER_UP;
+		canvas_rgb(canvas, y, &row[1]);
+	}
+
+	/* every row is stored as difference to the row above */
+	for (y = canvas->height - 1; y > 0; y--) {
+		row = &raw[y * stride];
+		prev = row - stride;
+		for (x = 1; x < stride; x++)
+			row[x] -= prev[x];
+	}
+
+	zlib_len = zlib_compress(zlib, raw, raw_len);
+
+	put_be32(&ihdr[0], canvas->width);
+	put_be32(&ihdr[4], canvas->height);
+	ihdr[8] = 8;	/* bit depth */
+	ihdr[9] = 2;	/* RGB */
+	ihdr[10] = 0;	/* deflate */
+	ihdr[11] = 0;	/* adaptive filtering */
+	ihdr[12] = 0;	/* no interlace */
+
+	fft_eval_write(writer, signature, sizeof(signature));
+	write_chunk(writer, "IHDR", ihdr, sizeof(ihdr));
+	write_chunk(writer, "IDAT", zlib, zlib_len);
+	write_chunk(writer, "IEND", NULL, 0);
+
+	free(zlib);
+	free(raw);
+
+	return 0;
+}
@@ -0,0 +1,186 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * SPDX-FileCopyrightText: 2026 Simon Wunderlich <sw@simonwunderlich.de>
+ */
+
+/*
+ * Multi-resolution summary of the signal over the frequency range.
+ *
+ * Level 0 has one bucket per FFT_EVAL_PYRAMID_RES of a MHz between
+ * FFT_EVAL_MIN_FREQ and FFT_EVAL_MAX_FREQ, every following level merges two
+ * buckets of the level below. Every bucket keeps minimum, maximum, sum and
+ * number of the bins in its range, so any frequency range can be summarized
+ * by merging a few buckets of the right level, no matter how many samples
+ * were added.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fft_eval.h"
+
+static void bucket_clear(struct fft_eval_bucket *bucket)
+{
+	memset(bucket, 0, sizeof(*bucket));
+}
+
+static void bucket_merge(struct fft_eval_bucket *dst,
+			 const struct fft_eval_bucket *src)
+{
+	if (!src->count)
+		return;
+
+	if (!dst->count || src->min < dst->min)
+		dst->min = src->min;
+	if (!dst->count || src->max > dst->max)
+		dst->max = src->max;
+
+	dst->sum += src->sum;
+	dst->count += src->count;
+}
+
+int fft_eval_pyramid_init(struct fft_eval_pyramid *pyramid)
+{
+	size_t len = FFT_EVAL_PYRAMID_BUCKETS;
+	int level;
+
+	memset(pyramid, 0, sizeof(*pyramid));
+
+	for (level = 0; level < FFT_EVAL_PYRAMID_LEVELS; level++) {
+		pyramid->level[level] = calloc(len, sizeof(*pyramid->level[level]));
+		if (!pyramid->level[level]) {
+			fft_eval_pyramid_free(pyramid);
+			return -1;
+		}
+
+		pyramid->len[level] = len;
+		len = (len + 1) / 2;
+	}
+
+	pyramid->dirty_first = FFT_EVAL_PYRAMID_BUCKETS;
+	pyramid->dirty_last = 0;
+
+	return 0;
+}
+
+void fft_eval_pyramid_free(struct fft_eval_pyramid *pyramid)
+{
+	int level;
+
+	for (level = 0; level < FFT_EVAL_PYRAMID_LEVELS; level++) {
+		free(pyramid->level[level]);
+		pyramid->level[level] = NULL;
+	}
+}
+
+/*
+ * fft_eval_pyramid_add - adds the bins of a sample to level 0
+ *
+ * The other levels are brought up to date by fft_eval_pyramid_update().
+ */
+void fft_eval_pyramid_add(struct fft_eval_pyramid *pyramid,
+			  const struct fft_eval_spectrum *spectrum)
+{
+	struct fft_eval_bucket *bucket;
+	float signal;
+	long pos;
+	int i;
+
+	for (i = 0; i < spectrum->bins; i++) {
+		pos = FFT_EVAL_PYRAMID_RES *
+		      (spectrum->freq[i] - FFT_EVAL_MIN_FREQ);
+		if (pos < 0 || pos >= FFT_EVAL_PYRAMID_BUCKETS)
+			continue;
+
+		signal = spectrum->signal[i];
+		bucket = &pyramid->level[0][pos];
+
+		if (!bucket->count || signal < bucket->min)
+			bucket->min = signal;
+		if (!bucket->count || signal > bucket->max)
+			bucket->max = signal;
+
+		bucket->sum += signal;
+		bucket->count++;
+
+		if ((size_t)pos < pyramid->dirty_first)
+			pyramid->dirty_first = pos;
+		if ((size_t)pos > pyramid->dirty_last)
+			pyramid->dirty_last = pos;
+	}
+}
+
+/*
+ * fft_eval_pyramid_update - merges the changed buckets into the upper levels
+ */
+void fft_eval_pyramid_update(struct fft_eval_pyramid *pyramid)
+{
+	struct fft_eval_bucket *bucket;
+	size_t first = pyramid->dirty_first;
+	size_t last = pyramid->dirty_last;
+	size_t pos;
+	int level;
+
+	if (first > last)
+		return;
+
+	for (level = 1; level < FFT_EVAL_PYRAMID_LEVELS; level++) {
+		first /= 2;
+		last /= 2;
+
+		for (pos = first; pos <= last; pos++) {
+			bucket = &pyramid->level[level][pos];
+
+			bucket_clear(bucket);
+			bucket_merge(bucket, &pyramid->level[level - 1][pos * 2]);
+			if (pos * 2 + 1 < pyramid->len[level - 1])
+				bucket_merge(bucket,
+					     &pyramid->level[level - 1][pos * 2 + 1]);
+		}
+	}
+
+	pyramid->dirty_first = FFT_EVAL_PYRAMID_BUCKETS;
+	pyramid->dirty_last = 0;
+}
+
+/*
+ * fft_eval_pyramid_query - summarizes a frequency range
+ *
+ * @pyramid: updated pyramid
+ * @low: start of the range in MHz
+ * @high: end of the range in MHz
+ * @result: returns minimum, maximum, sum and number of bins
+ *
+ * The coarsest level whose buckets are not wider than the range is used,
+ * so at most three buckets are merged. The result covers the range rounded
+ * to whole buckets of that level.
+ */
+void fft_eval_pyramid_query(const struct fft_eval_pyramid *pyramid,
+			    double low, double high,
+			    struct fft_eval_bucket *result)
+{
+	double width = (high - low) * FFT_EVAL_PYRAMID_RES;
+	long first, last, pos;
+	int level = 0;
+
+	bucket_clear(result);
+
+	while (level + 1 < FFT_EVAL_PYRAMID_LEVELS &&
+	       (double)(2L << level) <= width)
+		level++;
+
+	first = (low - FFT_EVAL_MIN_FREQ) * FFT_EVAL_PYRAMID_RES / (1L << level);
+	last = (high - FFT_EVAL_MIN_FREQ) * FFT_EVAL_PYRAMID_RES / (1L << level);
+
+	/* high is not part of the range */
+	if (last > first &&
+	    (high - FFT_EVAL_MIN_FREQ) * FFT_EVAL_PYRAMID_RES == last * (1L << level))
+		last--;
+
+	if (first < 0)
+		first = 0;
+	if (last >= (long)pyramid->len[level])
+		last = pyramid->len[level] - 1;
+
+	for (pos = first; pos <= last; pos++)
+		bucket_merge(result, &pyramid->level[level][pos]);
+}
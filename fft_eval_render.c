@@ -0,0 +1,1172 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * SPDX-FileCopyrightText: 2012 Simon Wunderlich <sw@simonwunderlich.de>
+ * SPDX-FileCopyrightText: 2012 Fraunhofer-Gesellschaft zur Foerderung der angewandten Forschung e.V.
+ * SPDX-FileCopyrightText: 2013 Gui Iribarren <gui@altermundi.net>
+ * SPDX-FileCopyrightText: 2017 Nico Pace <nicopace@altermundi.net>
+ */
+
+/*
+ * Rasterizer for the spectrum plot.
+ *
+ * Samples are drawn into a plain 32 bit pixel buffer, so this code does not
+ * depend on SDL and can also be used by the benchmarks.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+  #include <arm_neon.h>
+#endif
+
+#include "fft_eval.h"
+
+#define SIZE 3
+
+/*
+ * Every datapoint is drawn as 2*SIZE x 2*SIZE blob which is blended with the
+ * pixels below: the color, scaled by the opacity, is added to every channel
+ * and clipped at 255. With color_invert, the inverted color is subtracted
+ * instead and clipped at 0. This is a saturating byte wise addition or
+ * subtraction of a packed pixel, which the SIMD units can do 16 bytes at a
+ * time.
+ */
+#if defined(__SSE2__)
+static void blend_blobs(u32 *pixels, int width, const u32 *offsets, int num,
+			u32 amount, int invert)
+{
+	__m128i va = _mm_set1_epi32(amount);
+	__m128i alpha = _mm_set1_epi32(FFT_EVAL_AMASK);
+	__m128i v, w;
+	u32 *p;
+	int i, y;
+
+	for (i = 0; i < num; i++) {
+		p = pixels + offsets[i];
+
+		/* 4 + 2 pixels per row */
+		for (y = 0; y < 2 * SIZE; y++, p += width) {
+			v = _mm_loadu_si128((__m128i *)p);
+			w = _mm_loadl_epi64((__m128i *)(p + 4));
+
+			if (invert) {
+				v = _mm_or_si128(_mm_subs_epu8(v, va), alpha);
+				w = _mm_or_si128(_mm_subs_epu8(w, va), alpha);
+			} else {
+				v = _mm_adds_epu8(v, va);
+				w = _mm_adds_epu8(w, va);
+			}
+
+			_mm_storeu_si128((__m128i *)p, v);
+			_mm_storel_epi64((__m128i *)(p + 4), w);
+		}
+	}
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+static void blend_blobs(u32 *pixels, int width, const u32 *offsets, int num,
+			u32 amount, int invert)
+{
+	uint8x16_t va = vreinterpretq_u8_u32(vdupq_n_u32(amount));
+	uint8x16_t alpha = vreinterpretq_u8_u32(vdupq_n_u32(FFT_EVAL_AMASK));
+	uint8x16_t v;
+	uint8x8_t w;
+	u8 *p;
+	int i, y;
+
+	for (i = 0; i < num; i++) {
+		p = (u8 *)(pixels + offsets[i]);
+
+		/* 4 + 2 pixels per row */
+		for (y = 0; y < 2 * SIZE; y++, p += width * sizeof(*pixels)) {
+			v = vld1q_u8(p);
+			w = vld1_u8(p + 16);
+
+			if (invert) {
+				v = vorrq_u8(vqsubq_u8(v, va), alpha);
+				w = vorr_u8(vqsub_u8(w, vget_low_u8(va)),
+					    vget_low_u8(alpha));
+			} else {
+				v = vqaddq_u8(v, va);
+				w = vqadd_u8(w, vget_low_u8(va));
+			}
+
+			vst1q_u8(p, v);
+			vst1_u8(p + 16, w);
+		}
+	}
+}
+#else
+static void blend_blobs(u32 *pixels, int width, const u32 *offsets, int num,
+			u32 amount, int invert)
+{
+	int i, x1, y1, shift;
+	u32 *p, pixel;
+
+	for (i = 0; i < num; i++) {
+		p = pixels + offsets[i];
+
+		for (y1 = 0; y1 < 2 * SIZE; y1++, p += width)
+		for (x1 = 0; x1 < 2 * SIZE; x1++) {
+			pixel = 0;
+
+			for (shift = 0; shift < 32; shift += 8) {
+				int c = (p[x1] >> shift) & 0xff;
+				int a = (amount >> shift) & 0xff;
+
+				if (invert) {
+					c -= a;
+					if (c < 0) c = 0;
+				} else {
+					c += a;
+					if (c > 255) c = 255;
+				}
+
+				pixel |= (u32)c << shift;
+			}
+
+			if (invert)
+				pixel |= FFT_EVAL_AMASK;
+
+			p[x1] = pixel;
+		}
+	}
+}
+#endif
+
+/*
+ * blend_amount - packed amount blend_blobs() adds or subtracts per channel
+ *
+ * The alpha channel of the result is always opaque: it saturates when
+ * adding, and is set by blend_blobs() when subtracting.
+ */
+static u32 blend_amount(u32 color, u32 opacity, int invert)
+{
+	u32 r, g, b;
+
+	if (invert)
+		color ^= FFT_EVAL_RMASK | FFT_EVAL_GMASK | FFT_EVAL_BMASK;
+
+	r = (((color & FFT_EVAL_RMASK) >> FFT_EVAL_RBITS) * opacity) / 255;
+	g = (((color & FFT_EVAL_GMASK) >> FFT_EVAL_GBITS) * opacity) / 255;
+	b = (((color & FFT_EVAL_BMASK) >> FFT_EVAL_BBITS) * opacity) / 255;
+
+	return r << FFT_EVAL_RBITS | g << FFT_EVAL_GBITS | b << FFT_EVAL_BBITS |
+	       (invert ? 0 : FFT_EVAL_AMASK);
+}
+
+static void datapoint_pos(float freq, float startfreq, float signal,
+			  int *x, int *y)
+{
+	*x = (FFT_EVAL_X_SCALE * (freq - startfreq));
+	*y = 400 - (400.0 + FFT_EVAL_Y_SCALE * signal);
+}
+
+static void datapoint_color(int highlight, u32 *color, u32 *opacity)
+{
+	if (highlight) {
+		*color = FFT_EVAL_RMASK | FFT_EVAL_AMASK;
+		*opacity = 255;
+	} else {
+		*color = FFT_EVAL_BMASK | FFT_EVAL_AMASK;
+		*opacity = 30;
+	}
+}
+
+/*
+ * fft_eval_render_grid - clears the canvas and draws the grid at any zoom
+ *
+ * @canvas: target
+ * @startfreq: frequency at the left border in MHz
+ * @scale: pixels per MHz
+ * @step: MHz between the vertical lines, which are drawn at multiples of it
+ *
+ * Horizontal lines are drawn every 10 dB.
+ */
+void fft_eval_render_grid(struct fft_eval_canvas *canvas, double startfreq,
+			  double scale, int step)
+{
+	u32 *pixels = canvas->pixels;
+	int width = canvas->width;
+	int x, y, i;
+
+	for (y = 0; y < canvas->height; y++)
+		for (x = 0; x < width; x++) {
+			if (canvas->color_invert)
+				pixels[x + y * width] = FFT_EVAL_RMASK | FFT_EVAL_GMASK | FFT_EVAL_BMASK | FFT_EVAL_AMASK;
+			else
+				pixels[x + y * width] = FFT_EVAL_AMASK;
+		}
+
+	/* vertical lines (frequency) */
+	for (i = (FFT_EVAL_MIN_FREQ + step - 1) / step * step;
+	     i < FFT_EVAL_MAX_FREQ; i += step) {
+		x = (scale * (i - startfreq));
+
+		if (x < 0 || x >= width)
+			continue;
+
+		for (y = 0; y < canvas->height - 20; y++)
+			pixels[x + y * width] = 0x40404040 | FFT_EVAL_AMASK;
+	}
+
+	/* horizontal lines (dBm) */
+	for (i = 0; i < 150; i += 10) {
+		y = 600 - FFT_EVAL_Y_SCALE * i;
+		if (y < 0 || y >= canvas->height)
+			continue;
+
+		for (x = 0; x < width; x++)
+			pixels[x + y * width] = 0x40404040 | FFT_EVAL_AMASK;
+	}
+}
+
+/*
+ * fft_eval_grid_step - distance of the vertical grid lines in MHz, so they
+ *  are at least 100 pixels apart at scale pixels per MHz
+ */
+int fft_eval_grid_step(double scale)
+{
+	static const int steps[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000 };
+	size_t i;
+
+	for (i = 0; i < sizeof(steps) / sizeof(steps[0]) - 1; i++) {
+		if (steps[i] * scale >= 100)
+			break;
+	}
+
+	return steps[i];
+}
+
+/*
+ * fft_eval_render_background - clears the canvas and draws the grid
+ *
+ * @canvas: target
+ * @startfreq: frequency at the left border in MHz
+ *
+ * Vertical lines are drawn every 10 MHz, horizontal lines every 10 dB.
+ */
+void fft_eval_render_background(struct fft_eval_canvas *canvas, int startfreq)
+{
+	fft_eval_render_grid(canvas, startfreq, FFT_EVAL_X_SCALE, 10);
+}
+
+/*
+ * fft_eval_render_sample - draws every bin of a decoded sample
+ *
+ * @canvas: target
+ * @spectrum: decoded sample
+ * @startfreq: frequency at the left border in MHz
+ * @highlight: draw the sample opaque in red instead of translucent blue
+ */
+void fft_eval_render_sample(struct fft_eval_canvas *canvas,
+			    const struct fft_eval_spectrum *spectrum,
+			    float startfreq, int highlight)
+{
+	u32 offsets[SPECTRAL_ATH11K_MAX_NUM_BINS];
+	u32 color, opacity;
+	int num = 0;
+	int x, y;
+	int i;
+
+	/* top left pixel of the blobs which are completely on the canvas */
+	for (i = 0; i < spectrum->bins; i++) {
+		datapoint_pos(spectrum->freq[i], startfreq, spectrum->signal[i],
+			      &x, &y);
+
+		if (x - SIZE < 0 || x + SIZE >= canvas->width)
+			continue;
+		if (y - SIZE < 0 || y + SIZE >= canvas->height)
+			continue;
+
+		offsets[num++] = (x - SIZE) + (y - SIZE) * canvas->width;
+	}
+
+	datapoint_color(highlight, &color, &opacity);
+
+	blend_blobs(canvas->pixels, canvas->width, offsets, num,
+		    blend_amount(color, opacity, canvas->color_invert),
+		    canvas->color_invert);
+}
+
+/*
+ * Every blend of blend_blobs() adds (or subtracts with color_invert) a fixed
+ * amount per channel and clamps the result. As all amounts of a layer have
+ * the same sign, clamping once after summing them up gives the same pixels.
+ */
+
+int fft_eval_layer_init(struct fft_eval_layer *layer, int width, int height)
+{
+	layer->sum = calloc((size_t)width * height * 3, sizeof(*layer->sum));
+	if (!layer->sum)
+		return -1;
+
+	layer->width = width;
+	layer->height = height;
+	layer->color_invert = 0;
+
+	return 0;
+}
+
+void fft_eval_layer_free(struct fft_eval_layer *layer)
+{
+	free(layer->sum);
+	layer->sum = NULL;
+}
+
+/*
+ * fft_eval_layer_clear - removes all samples
+ *
+ * @color_invert: color mode of the canvas the layer will be composed on
+ */
+void fft_eval_layer_clear(struct fft_eval_layer *layer, int color_invert)
+{
+	memset(layer->sum, 0,
+	       (size_t)layer->width * layer->height * 3 * sizeof(*layer->sum));
+	layer->color_invert = color_invert;
+}
+
+static int layer_contains(const struct fft_eval_layer *layer, int x, int y)
+{
+	if (x - SIZE < 0 || x + SIZE >= layer->width)
+		return 0;
+	if (y - SIZE < 0 || y + SIZE >= layer->height)
+		return 0;
+
+	return 1;
+}
+
+/* adds the rows first to last - 1 of a blob to the layer */
+static void layer_blob_rows(struct fft_eval_layer *layer, int x, int y,
+			    u32 amount, int sign, int first, int last)
+{
+	u32 *sum;
+	u32 r, g, b;
+	int x1, y1;
+
+	if (first < y - SIZE)
+		first = y - SIZE;
+	if (last > y + SIZE)
+		last = y + SIZE;
+
+	/* unsigned wrap around turns the addition into a subtraction */
+	r = sign * ((amount & FFT_EVAL_RMASK) >> FFT_EVAL_RBITS);
+	g = sign * ((amount & FFT_EVAL_GMASK) >> FFT_EVAL_GBITS);
+	b = sign * ((amount & FFT_EVAL_BMASK) >> FFT_EVAL_BBITS);
+
+	for (y1 = first; y1 < last; y1++) {
+		sum = &layer->sum[((x - SIZE) + y1 * layer->width) * 3];
+
+		for (x1 = x - SIZE; x1 < x + SIZE; x1++) {
+			*sum++ += r;
+			*sum++ += g;
+			*sum++ += b;
+		}
+	}
+}
+
+static void layer_blob(struct fft_eval_layer *layer, int x, int y,
+		       u32 amount, int sign)
+{
+	if (!layer_contains(layer, x, y))
+		return;
+
+	layer_blob_rows(layer, x, y, amount, sign, y - SIZE, y + SIZE);
+}
+
+/*
+ * fft_eval_layer_add - adds or removes a translucent sample
+ *
+ * @layer: target
+ * @spectrum: decoded sample
+ * @startfreq: frequency at the left border in MHz
+ * @sign: 1 to add the sample, -1 to remove a sample added before
+ */
+void fft_eval_layer_add(struct fft_eval_layer *layer,
+			const struct fft_eval_spectrum *spectrum,
+			float startfreq, int sign)
+{
+	u32 color, opacity, amount;
+	int x, y;
+	int i;
+
+	datapoint_color(0, &color, &opacity);
+	amount = blend_amount(color, opacity, layer->color_invert);
+
+	for (i = 0; i < spectrum->bins; i++) {
+		datapoint_pos(spectrum->freq[i], startfreq,
+			      spectrum->signal[i], &x, &y);
+		layer_blob(layer, x, y, amount, sign);
+	}
+}
+
+/*
+ * Drawing a layer with multiple threads
+ *
+ * The samples in view are processed in batches. First, every thread decodes
+ * its share of the batch and sorts the blob positions into one list per
+ * band of rows. Then every thread adds the blobs of all lists of its own
+ * band, clipped to the band. Additions are order independent, so the result
+ * is identical to drawing all samples by a single thread.
+ */
+#define RENDER_BATCH	8192
+
+struct render_job;
+
+struct render_worker {
+	struct render_job *job;
+	int id;
+	pthread_t thread;
+
+	/* blob centers of the current batch, y << 16 | x, for every band */
+	u32 **blobs;
+	size_t *num;
+	size_t *alloc;
+	int failed;
+};
+
+struct render_job {
+	struct fft_eval_layer *layer;
+	const struct fft_eval_store *store;
+	float startfreq;
+	u32 amount;
+
+	const size_t *rnums;
+	size_t start;
+	size_t end;
+
+	int threads;
+	int band_height;
+	struct render_worker *workers;
+};
+
+static void render_add_blob(struct render_worker *worker, int band, u32 pos)
+{
+	size_t alloc;
+	u32 *tmp;
+
+	if (worker->num[band] == worker->alloc[band]) {
+		alloc = worker->alloc[band] ? worker->alloc[band] * 2 : 1024;
+		tmp = realloc(worker->blobs[band], alloc * sizeof(*tmp));
+		if (!tmp) {
+			worker->failed = 1;
+			return;
+		}
+
+		worker->blobs[band] = tmp;
+		worker->alloc[band] = alloc;
+	}
+
+	worker->blobs[band][worker->num[band]++] = pos;
+}
+
+static int render_band_of(const struct render_job *job, int y)
+{
+	int band = y / job->band_height;
+
+	/* the last band also gets the remaining rows */
+	if (band >= job->threads)
+		band = job->threads - 1;
+
+	return band;
+}
+
+static void *render_decode(void *arg)
+{
+	struct render_worker *worker = arg;
+	struct render_job *job = worker->job;
+	struct fft_eval_spectrum spectrum;
+	struct fft_eval_sample sample;
+	size_t len = job->end - job->start;
+	size_t first = job->start + len * worker->id / job->threads;
+	size_t last = job->start + len * (worker->id + 1) / job->threads;
+	int band, last_band;
+	int x, y;
+	size_t i;
+	int j;
+
+	for (band = 0; band < job->threads; band++)
+		worker->num[band] = 0;
+
+	for (i = first; i < last; i++) {
+		fft_eval_store_get(job->store, job->rnums[i], &sample);
+		if (fft_eval_decode(&sample, &spectrum, FFT_EVAL_DECODE_NOSTATS) < 0)
+			continue;
+
+		for (j = 0; j < spectrum.bins; j++) {
+			datapoint_pos(spectrum.freq[j], job->startfreq,
+				      spectrum.signal[j], &x, &y);
+			if (!layer_contains(job->layer, x, y))
+				continue;
+
+			/* a blob can reach into the next band */
+			last_band = render_band_of(job, y + SIZE - 1);
+			for (band = render_band_of(job, y - SIZE);
+			     band <= last_band; band++)
+				render_add_blob(worker, band, y << 16 | x);
+		}
+	}
+
+	return NULL;
+}
+
+static void *render_band(void *arg)
+{
+	struct render_worker *worker = arg;
+	struct render_job *job = worker->job;
+	int first = worker->id * job->band_height;
+	int last = first + job->band_height;
+	const struct render_worker *source;
+	size_t i;
+	int w;
+
+	if (worker->id == job->threads - 1)
+		last = job->layer->height;
+
+	for (w = 0; w < job->threads; w++) {
+		source = &job->workers[w];
+
+		for (i = 0; i < source->num[worker->id]; i++) {
+			u32 pos = source->blobs[worker->id][i];
+
+			layer_blob_rows(job->layer, pos & 0xffff, pos >> 16,
+					job->amount, 1, first, last);
+		}
+	}
+
+	return NULL;
+}
+
+/* runs fn for every worker, in the calling thread if no thread can be started */
+static void render_run(struct render_job *job, void *(*fn)(void *))
+{
+	int started;
+	int i;
+
+	for (i = 1; i < job->threads; i++) {
+		if (pthread_create(&job->workers[i].thread, NULL, fn,
+				   &job->workers[i]) != 0)
+			break;
+	}
+	started = i;
+
+	fn(&job->workers[0]);
+
+	for (i = 1; i < started; i++)
+		pthread_join(job->workers[i].thread, NULL);
+
+	for (i = started; i < job->threads; i++)
+		fn(&job->workers[i]);
+}
+
+static int render_parallel(struct render_job *job, size_t num)
+{
+	struct render_worker *worker;
+	int failed = 0;
+	int i;
+
+	job->workers = calloc(job->threads, sizeof(*job->workers));
+	if (!job->workers)
+		return -1;
+
+	for (i = 0; i < job->threads; i++) {
+		worker = &job->workers[i];
+		worker->job = job;
+		worker->id = i;
+		worker->blobs = calloc(job->threads, sizeof(*worker->blobs));
+		worker->num = calloc(job->threads, sizeof(*worker->num));
+		worker->alloc = calloc(job->threads, sizeof(*worker->alloc));
+		if (!worker->blobs || !worker->num || !worker->alloc)
+			failed = 1;
+	}
+
+	for (job->start = 0; job->start < num && !failed;
+	     job->start = job->end) {
+		job->end = job->start + RENDER_BATCH;
+		if (job->end > num)
+			job->end = num;
+
+		render_run(job, render_decode);
+
+		for (i = 0; i < job->threads; i++)
+			failed |= job->workers[i].failed;
+		if (failed)
+			break;
+
+		render_run(job, render_band);
+	}
+
+	for (i = 0; i < job->threads; i++) {
+		worker = &job->workers[i];
+
+		if (worker->blobs) {
+			int band;
+
+			for (band = 0; band < job->threads; band++)
+				free(worker->blobs[band]);
+		}
+
+		free(worker->blobs);
+		free(worker->num);
+		free(worker->alloc);
+	}
+	free(job->workers);
+
+	return failed ? -1 : 0;
+}
+
+/*
+ * fft_eval_layer_draw - adds all samples in view to a layer
+ *
+ * @layer: target, cleared before
+ * @store: samples
+ * @index: frequency index of the samples, to skip the ones out of view
+ * @startfreq: frequency at the left border in MHz
+ * @skip: number of a sample which is not drawn (e.g. the highlighted one),
+ *  or any number past the end of the store
+ * @threads: number of threads, 0 for one per CPU
+ *
+ * returns 0 on success, -1 on allocation failures.
+ */
+int fft_eval_layer_draw(struct fft_eval_layer *layer,
+			const struct fft_eval_store *store,
+			const struct fft_eval_freq_index *index,
+			float startfreq, size_t skip, int threads)
+{
+	struct fft_eval_spectrum spectrum;
+	struct fft_eval_sample sample;
+	struct render_job job;
+	u32 color, opacity;
+	float high = startfreq + layer->width / FFT_EVAL_X_SCALE;
+	size_t *rnums;
+	size_t num = 0;
+	size_t rnum;
+	size_t pos;
+	size_t i;
+
+	if (threads == 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	/* every band must be higher than a blob */
+	if (threads > layer->height / (2 * SIZE))
+		threads = layer->height / (2 * SIZE);
+	if (threads < 1)
+		threads = 1;
+
+	rnums = malloc((index->n ? index->n : 1) * sizeof(*rnums));
+	if (!rnums)
+		return -1;
+
+	pos = fft_eval_freq_index_start(index, startfreq);
+	while (fft_eval_freq_index_next(index, &pos, startfreq, high, &rnum)) {
+		if (rnum != skip)
+			rnums[num++] = rnum;
+	}
+
+	if (threads > 1) {
+		datapoint_color(0, &color, &opacity);
+
+		job.layer = layer;
+		job.store = store;
+		job.startfreq = startfreq;
+		job.amount = blend_amount(color, opacity, layer->color_invert);
+		job.rnums = rnums;
+		job.threads = threads;
+		job.band_height = layer->height / threads;
+
+		if (render_parallel(&job, num) == 0) {
+			free(rnums);
+			return 0;
+		}
+
+		/* start again with a single thread */
+		fft_eval_layer_clear(layer, layer->color_invert);
+	}
+
+	for (i = 0; i < num; i++) {
+		fft_eval_store_get(store, rnums[i], &sample);
+		if (fft_eval_decode(&sample, &spectrum, 0) < 0)
+			continue;
+
+		fft_eval_layer_add(layer, &spectrum, startfreq, 1);
+	}
+
+	free(rnums);
+
+	return 0;
+}
+
+static u32 compose_channel(u32 pixel, u32 mask, int bits, u32 sum, int invert)
+{
+	long value = (pixel & mask) >> bits;
+
+	if (invert) {
+		value -= sum;
+		if (value < 0) value = 0;
+	} else {
+		value += sum;
+		if (value > 255) value = 255;
+	}
+
+	return value << bits;
+}
+
+/*
+ * fft_eval_layer_compose - draws the samples of a layer on a background
+ *
+ * @canvas: target, must have the size of the layer
+ * @background: pixels drawn by fft_eval_render_background() in the color
+ *  mode of the layer
+ * @layer: samples to blend into the background
+ */
+void fft_eval_layer_compose(struct fft_eval_canvas *canvas,
+			    const u32 *background,
+			    const struct fft_eval_layer *layer)
+{
+	size_t num = (size_t)layer->width * layer->height;
+	const u32 *sum = layer->sum;
+	int invert = layer->color_invert;
+	u32 *pixels = canvas->pixels;
+	size_t i;
+
+	for (i = 0; i < num; i++, sum += 3) {
+		if (!sum[0] && !sum[1] && !sum[2]) {
+			pixels[i] = background[i];
+			continue;
+		}
+
+		pixels[i] = compose_channel(background[i], FFT_EVAL_RMASK,
+					    FFT_EVAL_RBITS, sum[0], invert) |
+			    compose_channel(background[i], FFT_EVAL_GMASK,
+					    FFT_EVAL_GBITS, sum[1], invert) |
+			    compose_channel(background[i], FFT_EVAL_BMASK,
+					    FFT_EVAL_BBITS, sum[2], invert) |
+			    FFT_EVAL_AMASK;
+	}
+}
+
+static int compare_span(const void *a, const void *b)
+{
+	const struct fft_eval_freq_span *span_a = a;
+	const struct fft_eval_freq_span *span_b = b;
+
+	if (span_a->low != span_b->low)
+		return span_a->low < span_b->low ? -1 : 1;
+
+	/* keep the order of the store for samples at the same frequency */
+	if (span_a->rnum != span_b->rnum)
+		return span_a->rnum < span_b->rnum ? -1 : 1;
+
+	return 0;
+}
+
+/*
+ * fft_eval_freq_index_build_range - sorts some samples of a store by
+ *  frequency
+ *
+ * @index: index to fill, free with fft_eval_freq_index_free()
+ * @store: samples to index
+ * @first: number of the first sample to index
+ * @end: number of the sample after the last one to index
+ * @flags: FFT_EVAL_DECODE_* flags used to draw the samples
+ *
+ * Samples which cannot be decoded are not part of the index.
+ *
+ * returns 0 on success, -1 on allocation failures.
+ */
+int fft_eval_freq_index_build_range(struct fft_eval_freq_index *index,
+				    const struct fft_eval_store *store,
+				    size_t first, size_t end,
+				    unsigned int flags)
+{
+	struct fft_eval_freq_span *span;
+	struct fft_eval_sample sample;
+	size_t rnum;
+
+	if (end > store->n)
+		end = store->n;
+	if (first > end)
+		first = end;
+
+	index->n = 0;
+	index->max_width = 0;
+	index->spans = malloc((end > first ? end - first : 1) *
+			      sizeof(*index->spans));
+	if (!index->spans)
+		return -1;
+
+	for (rnum = first; rnum < end; rnum++) {
+		span = &index->spans[index->n];
+
+		fft_eval_store_get(store, rnum, &sample);
+		if (fft_eval_decode_span(&sample, flags, &span->low,
+					 &span->high) < 0)
+			continue;
+
+		span->rnum = rnum;
+		if (span->high - span->low > index->max_width)
+			index->max_width = span->high - span->low;
+
+		index->n++;
+	}
+
+	qsort(index->spans, index->n, sizeof(*index->spans), compare_span);
+
+	return 0;
+}
+
+/*
+ * fft_eval_freq_index_build - sorts all samples of a store by frequency
+ */
+int fft_eval_freq_index_build(struct fft_eval_freq_index *index,
+			      const struct fft_eval_store *store,
+			      unsigned int flags)
+{
+	return fft_eval_freq_index_build_range(index, store, 0, store->n,
+					       flags);
+}
+
+void fft_eval_freq_index_free(struct fft_eval_freq_index *index)
+{
+	free(index->spans);
+	index->spans = NULL;
+	index->n = 0;
+}
+
+/*
+ * fft_eval_freq_index_start - position of the first sample which can
+ *  overlap a frequency range starting at low
+ */
+size_t fft_eval_freq_index_start(const struct fft_eval_freq_index *index,
+				 float low)
+{
+	size_t first = 0, last = index->n;
+	size_t mid;
+
+	/* no sample starting before this can reach low */
+	low -= index->max_width;
+
+	while (first < last) {
+		mid = first + (last - first) / 2;
+
+		if (index->spans[mid].low < low)
+			first = mid + 1;
+		else
+			last = mid;
+	}
+
+	return first;
+}
+
+/*
+ * fft_eval_freq_index_next - next sample overlapping a frequency range
+ *
+ * @index: index of the samples
+ * @pos: position in the index, start with fft_eval_freq_index_start()
+ * @low: lowest frequency of the range in MHz
+ * @high: highest frequency of the range in MHz
+ * @rnum: returns the number of the sample in the store
+ *
+ * returns 1 if a sample was found, 0 at the end of the range.
+ */
+int fft_eval_freq_index_next(const struct fft_eval_freq_index *index,
+			     size_t *pos, float low, float high, size_t *rnum)
+{
+	const struct fft_eval_freq_span *span;
+
+	for (; *pos < index->n; (*pos)++) {
+		span = &index->spans[*pos];
+
+		if (span->low > high)
+			break;
+
+		if (span->high < low)
+			continue;
+
+		*rnum = span->rnum;
+		(*pos)++;
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Density view
+ *
+ * Every bin counts for the columns its blob would cover in the row of its
+ * signal in full dB. The counts are mapped logarithmically to a palette
+ * from dark blue (rare) over green and yellow to red (most frequent). The
+ * waterfall view uses the same palette for the power.
+ */
+static const u8 palette_stops[][3] = {
+	{   0,   0, 128 },
+	{   0,   0, 255 },
+	{   0, 255, 255 },
+	{   0, 255,   0 },
+	{ 255, 255,   0 },
+	{ 255,   0,   0 },
+};
+
+static u32 palette[256];
+static int palette_ready = 0;
+
+static void palette_init(void)
+{
+	int stops = sizeof(palette_stops) / sizeof(palette_stops[0]);
+	int i, stop, c;
+	double pos, frac;
+	u8 rgb[3];
+
+	for (i = 0; i < 256; i++) {
+		pos = i / 255.0 * (stops - 1);
+		stop = pos;
+		if (stop >= stops - 1)
+			stop = stops - 2;
+		frac = pos - stop;
+
+		for (c = 0; c < 3; c++)
+			rgb[c] = palette_stops[stop][c] +
+				 frac * (palette_stops[stop + 1][c] -
+					 palette_stops[stop][c]);
+
+		palette[i] = rgb[0] << FFT_EVAL_RBITS | rgb[1] << FFT_EVAL_GBITS |
+			     rgb[2] << FFT_EVAL_BBITS | FFT_EVAL_AMASK;
+	}
+
+	palette_ready = 1;
+}
+
+int fft_eval_density_init(struct fft_eval_density *density)
+{
+	density->count = calloc((size_t)FFT_EVAL_DENSITY_COLUMNS *
+				FFT_EVAL_DENSITY_ROWS, sizeof(*density->count));
+	if (!density->count)
+		return -1;
+
+	density->max = 0;
+
+	return 0;
+}
+
+void fft_eval_density_free(struct fft_eval_density *density)
+{
+	free(density->count);
+	density->count = NULL;
+}
+
+/*
+ * fft_eval_density_add - counts the bins of a sample
+ *
+ * Samples can be added at any time, e.g. when they are read.
+ */
+void fft_eval_density_add(struct fft_eval_density *density,
+			  const struct fft_eval_spectrum *spectrum)
+{
+	u32 *count;
+	int column, row;
+	int i, x;
+
+	for (i = 0; i < spectrum->bins; i++) {
+		row = -spectrum->signal[i];
+		if (spectrum->signal[i] > 0 || row >= FFT_EVAL_DENSITY_ROWS)
+			continue;
+
+		column = FFT_EVAL_X_SCALE * (spectrum->freq[i] - FFT_EVAL_MIN_FREQ);
+		if (column - SIZE < 0 || column + SIZE > FFT_EVAL_DENSITY_COLUMNS)
+			continue;
+
+		count = &density->count[(size_t)row * FFT_EVAL_DENSITY_COLUMNS];
+		for (x = column - SIZE; x < column + SIZE; x++) {
+			count[x]++;
+			if (count[x] > density->max)
+				density->max = count[x];
+		}
+	}
+}
+
+/*
+ * fft_eval_render_density - draws the density view over the background
+ *
+ * @canvas: target, with the background already drawn
+ * @density: counted bins
+ * @startfreq: frequency at the left border in MHz
+ *
+ * The time needed only depends on the size of the canvas.
+ */
+void fft_eval_render_density(struct fft_eval_canvas *canvas,
+			     const struct fft_eval_density *density,
+			     int startfreq)
+{
+	int offset = (startfreq - FFT_EVAL_MIN_FREQ) * FFT_EVAL_X_SCALE;
+	double scale = 0;
+	const u32 *count;
+	u32 *pixels;
+	u32 color;
+	int first, last;
+	int row, x, y;
+
+	if (!palette_ready)
+		palette_init();
+
+	if (density->max > 1)
+		scale = 254 / log(density->max);
+
+	/* columns of the canvas which are part of the density */
+	first = offset < 0 ? -offset : 0;
+	last = FFT_EVAL_DENSITY_COLUMNS - offset;
+	if (last > canvas->width)
+		last = canvas->width;
+
+	for (row = 0; row < FFT_EVAL_DENSITY_ROWS; row++) {
+		count = &density->count[(size_t)row * FFT_EVAL_DENSITY_COLUMNS];
+
+		for (x = first; x < last; x++) {
+			if (!count[offset + x])
+				continue;
+
+			color = palette[1 + (int)(scale * log(count[offset + x]))];
+			if (canvas->color_invert)
+				color ^= FFT_EVAL_RMASK | FFT_EVAL_GMASK | FFT_EVAL_BMASK;
+
+			for (y = row * FFT_EVAL_Y_SCALE;
+			     y < (row + 1) * FFT_EVAL_Y_SCALE && y < canvas->height;
+			     y++) {
+				pixels = &canvas->pixels[(size_t)y * canvas->width];
+				pixels[x] = color;
+			}
+		}
+	}
+}
+
+/*
+ * fft_eval_render_row - draws a sample as one row of the waterfall view
+ *
+ * @pixels: row of width pixels
+ * @spectrum: decoded sample, or NULL for an empty row
+ * @startfreq: frequency at the left border in MHz
+ * @color_invert: use the inverted colors
+ *
+ * The power of every bin is mapped to the palette, from dark blue at
+ * FFT_EVAL_ROW_MIN_DBM to red at FFT_EVAL_ROW_MAX_DBM. Overlapping bins show
+ * the highest power.
+ */
+void fft_eval_render_row(u32 *pixels, int width,
+			 const struct fft_eval_spectrum *spectrum,
+			 float startfreq, int color_invert)
+{
+	const double range = FFT_EVAL_ROW_MAX_DBM - FFT_EVAL_ROW_MIN_DBM;
+	u32 empty = FFT_EVAL_AMASK;
+	u32 level;
+	int i, x, x1;
+
+	if (!palette_ready)
+		palette_init();
+
+	if (color_invert)
+		empty |= FFT_EVAL_RMASK | FFT_EVAL_GMASK | FFT_EVAL_BMASK;
+
+	/* the palette index is collected in the pixels first, 0 is empty */
+	memset(pixels, 0, width * sizeof(*pixels));
+
+	for (i = 0; spectrum && i < spectrum->bins; i++) {
+		x = FFT_EVAL_X_SCALE * (spectrum->freq[i] - startfreq);
+		if (x + SIZE <= 0 || x - SIZE >= width)
+			continue;
+
+		if (spectrum->signal[i] <= FFT_EVAL_ROW_MIN_DBM)
+			level = 1;
+		else if (spectrum->signal[i] >= FFT_EVAL_ROW_MAX_DBM)
+			level = 255;
+		else
+			level = 1 + 254 * ((spectrum->signal[i] -
+					    FFT_EVAL_ROW_MIN_DBM) / range);
+
+		for (x1 = x - SIZE; x1 < x + SIZE; x1++) {
+			if (x1 < 0 || x1 >= width)
+				continue;
+
+			if (level > pixels[x1])
+				pixels[x1] = level;
+		}
+	}
+
+	for (x = 0; x < width; x++) {
+		if (!pixels[x]) {
+			pixels[x] = empty;
+			continue;
+		}
+
+		pixels[x] = palette[pixels[x]];
+		if (color_invert)
+			pixels[x] ^= FFT_EVAL_RMASK | FFT_EVAL_GMASK | FFT_EVAL_BMASK;
+	}
+}
+
+static int envelope_y(float signal)
+{
+	return -FFT_EVAL_Y_SCALE * signal;
+}
+
+/*
+ * fft_eval_render_envelope - draws the signal summary of every column
+ *
+ * @canvas: target, usually prepared with fft_eval_render_grid()
+ * @pyramid: updated pyramid of the samples
+ * @startfreq: frequency at the left border in MHz
+ * @scale: pixels per MHz
+ *
+ * Every column shows the range between the weakest and the strongest bin
+ * in its frequency range and marks the mean signal. The work per frame only
+ * depends on the width of the canvas, not on the number of samples.
+ */
+void fft_eval_render_envelope(struct fft_eval_canvas *canvas,
+			      const struct fft_eval_pyramid *pyramid,
+			      double startfreq, double scale)
+{
+	u32 range_color = (0x90 << FFT_EVAL_BBITS) | (0x30 << FFT_EVAL_GBITS) |
+			  FFT_EVAL_AMASK;
+	u32 mean_color = FFT_EVAL_RMASK | FFT_EVAL_GMASK | FFT_EVAL_AMASK;
+	struct fft_eval_bucket bucket;
+	u32 *pixels = canvas->pixels;
+	int width = canvas->width;
+	/* keep the frequency labels below the grid readable */
+	int height = canvas->height - 20;
+	int x, y, top, bottom, mean;
+
+	if (canvas->color_invert) {
+		range_color ^= FFT_EVAL_RMASK | FFT_EVAL_GMASK | FFT_EVAL_BMASK;
+		mean_color ^= FFT_EVAL_RMASK | FFT_EVAL_GMASK | FFT_EVAL_BMASK;
+	}
+
+	for (x = 0; x < width; x++) {
+		fft_eval_pyramid_query(pyramid, startfreq + x / scale,
+				       startfreq + (x + 1) / scale, &bucket);
+		if (!bucket.count)
+			continue;
+
+		top = envelope_y(bucket.max);
+		bottom = envelope_y(bucket.min);
+		mean = envelope_y(bucket.sum / bucket.count);
+
+		if (top < 0)
+			top = 0;
+		if (bottom >= height)
+			bottom = height - 1;
+
+		for (y = top; y <= bottom; y++)
+			pixels[x + y * width] = range_color;
+
+		for (y = mean - 1; y <= mean + 1; y++) {
+			if (y < 0 || y >= height)
+				continue;
+
+			pixels[x + y * width] = mean_color;
+		}
+	}
+}
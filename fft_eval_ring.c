@@ -0,0 +1,129 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * SPDX-FileCopyrightText: 2026 Simon Wunderlich <sw@simonwunderlich.de>
+ */
+
+/*
+ * Single producer, single consumer ring of decoded samples.
+ *
+ * head is only written by the producer, tail by the consumer when it took
+ * a sample and by the producer when it drops the oldest sample of a full
+ * ring. Both compare and swap tail, so every sample is either taken or
+ * dropped exactly once. The consumer copies a slot before it claims it:
+ * when the producer dropped and overwrote the slot meanwhile, the claim
+ * fails and the copy is thrown away.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fft_eval.h"
+
+/*
+ * fft_eval_ring_init - allocates a ring
+ *
+ * @size: number of slots, a power of two
+ *
+ * returns 0 on success, -1 on allocation failures.
+ */
+int fft_eval_ring_init(struct fft_eval_ring *ring, size_t size)
+{
+	memset(ring, 0, sizeof(*ring));
+
+	if (!size || (size & (size - 1)))
+		return -1;
+
+	ring->slots = malloc(size * sizeof(*ring->slots));
+	if (!ring->slots)
+		return -1;
+
+	ring->mask = size - 1;
+
+	return 0;
+}
+
+void fft_eval_ring_free(struct fft_eval_ring *ring)
+{
+	free(ring->slots);
+	ring->slots = NULL;
+}
+
+/* points sample into the buffer of slot */
+static void slot_rebase(struct fft_eval_ring_slot *slot,
+			const struct fft_eval_sample *sample)
+{
+	size_t header_len = sample->data - (const u8 *)sample->tlv;
+
+	slot->sample.tlv = (const struct fft_sample_tlv *)slot->buf;
+	slot->sample.data = slot->buf + header_len;
+}
+
+/*
+ * fft_eval_ring_push - adds a sample, drops the oldest one when full
+ *
+ * Must only be called by the producer.
+ */
+void fft_eval_ring_push(struct fft_eval_ring *ring,
+			const struct fft_eval_sample *sample)
+{
+	size_t head = ring->head;
+	size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	struct fft_eval_ring_slot *slot;
+
+	/* fails when the consumer just took the oldest sample itself */
+	if (head - tail > ring->mask &&
+	    __atomic_compare_exchange_n(&ring->tail, &tail, tail + 1, 0,
+					__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		__atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+
+	slot = &ring->slots[head & ring->mask];
+	slot->sample = *sample;
+	memcpy(slot->buf, sample->tlv,
+	       sizeof(*sample->tlv) + sample->tlv->length);
+	slot_rebase(slot, sample);
+
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * fft_eval_ring_pop - takes the oldest sample
+ *
+ * @slot: returns a copy of the sample, which stays valid after the slot in
+ *  the ring is reused
+ *
+ * Must only be called by the consumer.
+ *
+ * returns 1 when a sample was taken, 0 when the ring is empty.
+ */
+int fft_eval_ring_pop(struct fft_eval_ring *ring,
+		      struct fft_eval_ring_slot *slot)
+{
+	size_t head, tail;
+
+	tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+	while (1) {
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		if (tail == head)
+			return 0;
+
+		memcpy(slot, &ring->slots[tail & ring->mask], sizeof(*slot));
+
+		/* on failure, tail is updated to the sample after the dropped */
+		if (__atomic_compare_exchange_n(&ring->tail, &tail, tail + 1, 0,
+						__ATOMIC_ACQ_REL,
+						__ATOMIC_ACQUIRE))
+			break;
+	}
+
+	slot_rebase(slot, &slot->sample);
+
+	return 1;
+}
+
+/*
+ * fft_eval_ring_dropped - number of samples dropped so far
+ */
+u64 fft_eval_ring_dropped(struct fft_eval_ring *ring)
+{
+	return __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+}
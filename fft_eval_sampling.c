@@ -0,0 +1,164 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * SPDX-FileCopyrightText: 2026 Simon Wunderlich <sw@simonwunderlich.de>
+ */
+
+/*
+ * Sampling of oversized dumps.
+ *
+ * Background scans produce far more samples than can be drawn or are
+ * needed for statistics. The sampling modes keep a subset of the accepted
+ * samples, so the size of the store and the cost of drawing it depend on
+ * the requested number of samples instead of the size of the dump. The
+ * modes can be combined and are applied in this order:
+ *
+ *   --every=N        every Nth sample
+ *   --bucket=N/usec  at most N samples of each usec long TSF interval
+ *   --reservoir=N    a uniform random choice of N samples of the whole dump
+ *
+ * The decisions only need the TSF in wire format, samples which are not
+ * kept are never decoded. For the reservoir (Algorithm R) only the
+ * positions of the chosen TLVs are kept; they are decoded in file order
+ * when the whole dump was parsed. The PRNG always starts with the same
+ * seed, so the same dump gives the same samples every time.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fft_eval.h"
+
+#define SAMPLER_SEED		0x9e3779b97f4a7c15ULL
+
+/* smallest reservoir allocation, it grows up to --reservoir entries */
+#define RESERVOIR_MIN		1024
+
+int fft_eval_sampling_active(void)
+{
+	const struct fft_eval_sampling *sampling = &fft_eval_config.sampling;
+
+	return sampling->every || sampling->bucket_max || sampling->reservoir;
+}
+
+void fft_eval_sampler_init(struct fft_eval_sampler *sampler)
+{
+	memset(sampler, 0, sizeof(*sampler));
+	sampler->bucket = UINT64_MAX;
+	sampler->rand = SAMPLER_SEED;
+}
+
+void fft_eval_sampler_free(struct fft_eval_sampler *sampler)
+{
+	free(sampler->reservoir);
+	sampler->reservoir = NULL;
+	sampler->n = 0;
+	sampler->size = 0;
+}
+
+/* xorshift64* */
+static u64 sampler_rand(struct fft_eval_sampler *sampler)
+{
+	sampler->rand ^= sampler->rand >> 12;
+	sampler->rand ^= sampler->rand << 25;
+	sampler->rand ^= sampler->rand >> 27;
+
+	return sampler->rand * 0x2545f4914f6cdd1dULL;
+}
+
+static int reservoir_grow(struct fft_eval_sampler *sampler, u64 max)
+{
+	size_t size = sampler->size ? sampler->size * 2 : RESERVOIR_MIN;
+	u64 *reservoir;
+
+	if (size > max)
+		size = max;
+
+	reservoir = realloc(sampler->reservoir, size * sizeof(*reservoir));
+	if (!reservoir)
+		return -1;
+
+	sampler->reservoir = reservoir;
+	sampler->size = size;
+
+	return 0;
+}
+
+/*
+ * fft_eval_sampler_keep - decides whether an accepted TLV is kept
+ *
+ * @sampler: sampler state
+ * @tlv: TLV in wire format which was accepted
+ * @pos: position of the TLV in the dump
+ *
+ * returns 1 when the TLV has to be added now, 0 when it is dropped or was
+ * put into the reservoir and -1 if memory ran out.
+ */
+int fft_eval_sampler_keep(struct fft_eval_sampler *sampler,
+			  const struct fft_sample_tlv *tlv, u64 pos)
+{
+	const struct fft_eval_sampling *sampling = &fft_eval_config.sampling;
+	u64 bucket;
+	u64 i;
+
+	sampler->seen++;
+
+	if (sampling->every) {
+		if (sampler->every++ % sampling->every != 0)
+			return 0;
+	}
+
+	if (sampling->bucket_max) {
+		bucket = fft_eval_tlv_tsf(tlv) / sampling->bucket_len;
+		if (bucket != sampler->bucket) {
+			sampler->bucket = bucket;
+			sampler->in_bucket = 0;
+		}
+
+		if (sampler->in_bucket >= sampling->bucket_max)
+			return 0;
+
+		sampler->in_bucket++;
+	}
+
+	if (!sampling->reservoir)
+		return 1;
+
+	sampler->offered++;
+
+	if (sampler->n < sampling->reservoir) {
+		if (sampler->n == sampler->size &&
+		    reservoir_grow(sampler, sampling->reservoir) < 0)
+			return -1;
+
+		sampler->reservoir[sampler->n++] = pos;
+		return 0;
+	}
+
+	/* replace a random entry with probability reservoir / offered */
+	i = sampler_rand(sampler) % sampler->offered;
+	if (i < sampling->reservoir)
+		sampler->reservoir[i] = pos;
+
+	return 0;
+}
+
+static int cmp_pos(const void *a, const void *b)
+{
+	const u64 *x = a;
+	const u64 *y = b;
+
+	return (*x > *y) - (*x < *y);
+}
+
+/*
+ * fft_eval_sampler_finish - sorts the reservoir in file order
+ *
+ * returns the number of positions in sampler->reservoir.
+ */
+size_t fft_eval_sampler_finish(struct fft_eval_sampler *sampler)
+{
+	if (sampler->n)
+		qsort(sampler->reservoir, sampler->n,
+		      sizeof(*sampler->reservoir), cmp_pos);
+
+	return sampler->n;
+}
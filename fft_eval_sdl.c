@@ -12,7 +12,9 @@
  */
 
 #include <errno.h>
+#include <getopt.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 
 #ifndef __NOSDL__
@@ -21,6 +23,7 @@
 #endif
 
 #include <inttypes.h>
+#include <pthread.h>
 #include <unistd.h>
 
 #include "fft_eval.h"
@@ -29,22 +32,160 @@
 #define HEIGHT	650
 #define BPP	32
 
-#define X_SCALE	10
-#define Y_SCALE	4
+#define X_SCALE	FFT_EVAL_X_SCALE
+#define Y_SCALE	FFT_EVAL_Y_SCALE
 
-#define	RMASK 	0x000000ff
-#define RBITS	0
-#define	GMASK	0x0000ff00
-#define GBITS	8
-#define	BMASK	0x00ff0000
-#define	BBITS	16
-#define	AMASK	0xff000000
+#define	RMASK 	FFT_EVAL_RMASK
+#define	GMASK	FFT_EVAL_GMASK
+#define	BMASK	FFT_EVAL_BMASK
+#define	AMASK	FFT_EVAL_AMASK
 
 
+/* the waterfall covers everything above the frequency labels */
+#define WATERFALL_ROWS	(HEIGHT - 20)
+
+/* number of labels at the axes, at most one every MHz or 10 dB */
+#define FREQ_LABELS	(FFT_EVAL_MAX_FREQ - FFT_EVAL_MIN_FREQ)
+#define DBM_LABELS	15
+
+/*
+ * zoom of the sample view, the frequency axis has X_SCALE * 2^zoom pixels
+ * per MHz. Zoom 0 draws every sample, all others the envelope of the
+ * samples from the pyramid.
+ */
+#define ZOOM_MIN	-5
+#define ZOOM_MAX	3
+
 static SDL_Renderer *renderer = NULL;
 static TTF_Font *font = NULL;
 static int color_invert = 0;
 
+/* the frame is drawn into the same surface and texture every time */
+static SDL_Surface *frame = NULL;
+static SDL_Texture *frame_texture = NULL;
+
+/*
+ * grid and labels only change with startfreq and color_invert. They are
+ * drawn once into the background and copied to the frame before the samples
+ * are blended in.
+ */
+static SDL_Surface *background = NULL;
+static int background_startfreq;
+static int background_zoom;
+static int background_invert;
+static int background_valid = 0;
+
+/*
+ * all samples except the highlighted one. Moving the highlight only moves
+ * two samples in or out of the cloud, the cloud is only drawn again when
+ * startfreq or color_invert change.
+ */
+static struct fft_eval_layer cloud;
+static struct fft_eval_freq_index freq_index;
+static size_t freq_index_samples;
+static int cloud_startfreq;
+static size_t cloud_highlight;
+static size_t cloud_samples;
+static int cloud_valid = 0;
+
+/*
+ * live mode: an ingest thread follows the scanfile and hands the samples
+ * to the main loop through the ring. The main loop appends them to the
+ * store and redraws at most LIVE_FPS times per second.
+ */
+#define LIVE_FPS	25
+
+static int live = 0;
+static struct fft_eval_reader live_reader;
+static struct fft_eval_ring live_ring;
+static pthread_t live_thread;
+static int live_running = 0;
+static Uint32 live_drawn;
+
+/*
+ * animation clock: while the view scrolls or live mode is on, a timer posts
+ * an SDL_USEREVENT every ANIM_STEP_MS. Scrolling advances one step per
+ * ANIM_STEP_MS that passed, no matter how long the frames take to draw.
+ * anim_pending keeps the timer from queueing another tick before the main
+ * loop took the last one.
+ */
+#define ANIM_STEP_MS	16
+#define ANIM_MAX_STEPS	20
+
+static SDL_TimerID anim_timer = 0;
+static Uint32 anim_clock;
+static int anim_pending = 0;
+
+/* draw times of the last frames, shown with 'f' */
+#define FRAME_TIMES	128
+
+static double frame_ms[FRAME_TIMES];
+static size_t frame_count = 0;
+static int show_frame_times = 0;
+static SDL_Texture *frame_times_texture = NULL;
+static SDL_Rect frame_times_rect;
+static char frame_times_text[64];
+static int frame_times_invert;
+
+/*
+ * samples sorted by TSF, to jump to a time. In live mode it is built again
+ * when samples were added since it was used last.
+ */
+static struct fft_eval_index sample_index;
+static int index_file = 0;	/* -i */
+
+/* jump to a sample, typed in after 'g' or 't' or given with -n or -t */
+enum jump {
+	JUMP_NONE,
+	JUMP_SAMPLE,	/* by sample number */
+	JUMP_TSF,	/* to the first sample at or after a TSF */
+};
+
+static enum jump jump = JUMP_NONE;
+static char jump_text[24];
+static size_t jump_len;
+static enum jump start_jump = JUMP_NONE;
+static u64 start_value;
+
+enum view {
+	VIEW_SAMPLES,
+	VIEW_DENSITY,	/* 'd' */
+	VIEW_WATERFALL,	/* 'w' */
+};
+
+static enum view view = VIEW_SAMPLES;
+static int zoom = 0;
+
+/*
+ * envelope of the samples at zoom levels other than 0. Like the density,
+ * samples are only added once.
+ */
+static struct fft_eval_pyramid pyramid;
+static size_t pyramid_samples = 0;
+
+/*
+ * density view. Samples are only counted once, when the view is shown for
+ * the first time after they were read.
+ */
+static struct fft_eval_density density;
+static size_t density_samples = 0;
+
+/*
+ * waterfall view: one row per sample, the highlighted sample at the top and
+ * the samples before it below. The rows are kept in a ring in the texture,
+ * the row of sample n is WATERFALL_ROWS - 1 - n % WATERFALL_ROWS, so
+ * moving on to the next sample only needs to draw one row.
+ */
+static SDL_Texture *waterfall_texture = NULL;
+static long waterfall_last;
+static int waterfall_startfreq;
+static int waterfall_invert;
+static int waterfall_valid = 0;
+
+/* rendered label text, for each value of color_invert */
+static SDL_Surface *freq_labels[2][FREQ_LABELS];
+static SDL_Surface *dbm_labels[2][DBM_LABELS];
+
 static int graphics_init_sdl(char *name, const char *fontdir)
 {
 	SDL_Window *window;
@@ -72,6 +213,25 @@ static int graphics_init_sdl(char *name, const char *fontdir)
 		return -1;
 	}
 
+	frame = SDL_CreateRGBSurface(SDL_SWSURFACE, WIDTH, HEIGHT, BPP, RMASK, GMASK, BMASK, AMASK);
+	background = SDL_CreateRGBSurface(SDL_SWSURFACE, WIDTH, HEIGHT, BPP, RMASK, GMASK, BMASK, AMASK);
+	frame_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ABGR8888,
+					  SDL_TEXTUREACCESS_STREAMING,
+					  WIDTH, HEIGHT);
+	waterfall_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ABGR8888,
+					      SDL_TEXTUREACCESS_STREAMING,
+					      WIDTH, WATERFALL_ROWS);
+	if (!frame || !background || !frame_texture || !waterfall_texture ||
+	    fft_eval_layer_init(&cloud, WIDTH, HEIGHT) < 0 ||
+	    fft_eval_density_init(&density) < 0 ||
+	    fft_eval_pyramid_init(&pyramid) < 0 ||
+	    fft_eval_freq_index_build(&freq_index, &result_store, 0) < 0) {
+		fprintf(stderr, "Initializing SDL frame buffer failed\n");
+		return -1;
+	}
+
+	freq_index_samples = result_store.n;
+
 	if (TTF_Init() < 0) {
 		fprintf(stderr, "Initializing SDL TTF failed\n");
 		return -1;
@@ -90,60 +250,79 @@ static int graphics_init_sdl(char *name, const char *fontdir)
 	return 0;
 }
 
-static void graphics_quit_sdl(void)
+static void free_labels(SDL_Surface **labels, size_t num)
 {
-	if (font) {
-		TTF_CloseFont(font);
-		font = NULL;
-	}
+	size_t i;
 
-	TTF_Quit();
-	SDL_Quit();
+	for (i = 0; i < num; i++) {
+		if (labels[i])
+			SDL_FreeSurface(labels[i]);
+		labels[i] = NULL;
+	}
 }
 
-#define SIZE 3
-/* this function blends a 2*SIZE x 2*SIZE blob at the given position with
- * the defined opacity. */
-static int bigpixel(Uint32 *pixels, int x, int y, Uint32 color, uint8_t opacity)
+static void graphics_quit_sdl(void)
 {
-	int x1, y1;
+	free_labels(freq_labels[0], FREQ_LABELS);
+	free_labels(freq_labels[1], FREQ_LABELS);
+	free_labels(dbm_labels[0], DBM_LABELS);
+	free_labels(dbm_labels[1], DBM_LABELS);
+
+	if (frame_texture) {
+		SDL_DestroyTexture(frame_texture);
+		frame_texture = NULL;
+	}
 
-	if (x - SIZE < 0 || x + SIZE >= WIDTH)
-		return -1;
-	if (y - SIZE < 0 || y + SIZE >= HEIGHT)
-		return -1;
+	if (waterfall_texture) {
+		SDL_DestroyTexture(waterfall_texture);
+		waterfall_texture = NULL;
+	}
+	waterfall_valid = 0;
 
-	if (color_invert)
-		color ^= RMASK | GMASK | BMASK;
+	if (frame_times_texture) {
+		SDL_DestroyTexture(frame_times_texture);
+		frame_times_texture = NULL;
+	}
+	frame_times_text[0] = '\0';
 
-	for (x1 = x - SIZE; x1 < x + SIZE; x1++)
-	for (y1 = y - SIZE; y1 < y + SIZE; y1++) {
-		int r, g, b;
+	if (frame) {
+		SDL_FreeSurface(frame);
+		frame = NULL;
+	}
 
-		if (color_invert) {
-			r = ((pixels[x1 + y1 * WIDTH] & RMASK) >> RBITS) - ((((color & RMASK) >> RBITS) * opacity) / 255);
-			if (r < 0) r = 0;
-			g = ((pixels[x1 + y1 * WIDTH] & GMASK) >> GBITS) - ((((color & GMASK) >> GBITS) * opacity) / 255);
-			if (g < 0) g = 0;
-			b = ((pixels[x1 + y1 * WIDTH] & BMASK) >> BBITS) - ((((color & BMASK) >> BBITS) * opacity) / 255);
-			if (b < 0) b = 0;
-		} else {
-			r = ((pixels[x1 + y1 * WIDTH] & RMASK) >> RBITS) + ((((color & RMASK) >> RBITS) * opacity) / 255);
-			if (r > 255) r = 255;
-			g = ((pixels[x1 + y1 * WIDTH] & GMASK) >> GBITS) + ((((color & GMASK) >> GBITS) * opacity) / 255);
-			if (g > 255) g = 255;
-			b = ((pixels[x1 + y1 * WIDTH] & BMASK) >> BBITS) + ((((color & BMASK) >> BBITS) * opacity) / 255);
-			if (b > 255) b = 255;
-		}
+	if (background) {
+		SDL_FreeSurface(background);
+		background = NULL;
+	}
+	background_valid = 0;
+
+	fft_eval_layer_free(&cloud);
+	fft_eval_freq_index_free(&freq_index);
+	cloud_valid = 0;
 
-		pixels[x1 + y1 * WIDTH] = r << RBITS | g << GBITS | b << BBITS | (color & AMASK);
+	fft_eval_density_free(&density);
+	density_samples = 0;
+
+	fft_eval_pyramid_free(&pyramid);
+	pyramid_samples = 0;
+
+	if (font) {
+		TTF_CloseFont(font);
+		font = NULL;
 	}
-	return 0;
+
+	TTF_Quit();
+	SDL_Quit();
 }
 
-static int render_text(SDL_Surface *surface, char *text, int x, int y)
+/*
+ * render_text - blits a label to the surface
+ *
+ * @label: cache of the rendered text, filled on the first use
+ */
+static int render_text(SDL_Surface *surface, SDL_Surface **label,
+		       const char *text, int x, int y)
 {
-	SDL_Surface *text_surface;
 	SDL_Color fontcolor_white = {255, 255, 255, 255};
 	SDL_Color fontcolor_black = {0, 0, 0, 255};
 	SDL_Color fontcolor;
@@ -158,399 +337,864 @@ static int render_text(SDL_Surface *surface, char *text, int x, int y)
 		fontcolor = fontcolor_white;
 	}
 
-	text_surface = TTF_RenderText_Solid(font, text, fontcolor);
-	if (!text_surface)
+	if (!*label)
+		*label = TTF_RenderText_Solid(font, text, fontcolor);
+	if (!*label)
 		return -1;
 
-	SDL_BlitSurface(text_surface, NULL, surface, &fontdest);
-	SDL_FreeSurface(text_surface);
+	SDL_BlitSurface(*label, NULL, surface, &fontdest);
 
 	return 0;
 }
 
+/* pixels per MHz at the current zoom */
+static double view_scale(void)
+{
+	return ldexp(X_SCALE, zoom);
+}
+
+/* MHz shown in the window at the current zoom */
+static int view_width(void)
+{
+	return WIDTH / view_scale();
+}
 
-static int plot_datapoint(Uint32 *pixels, float freq, float startfreq,
-			  int noise, int rssi, int data, int datasquaresum,
-			  int highlight)
+/*
+ * draw_background - draws grid and labels unless they are still valid
+ */
+static void draw_background(int startfreq)
 {
-	Uint32 color, opacity;
-	int x, y;
-	float signal;
+	struct fft_eval_canvas canvas;
+	double scale = view_scale();
+	int step = fft_eval_grid_step(scale);
+	char text[32];
+	int x, y, i;
+
+	if (background_valid && background_startfreq == startfreq &&
+	    background_zoom == zoom && background_invert == color_invert)
+		return;
 
-	/* This is where the "magic" happens: interpret the signal
-	 * to output some kind of data which looks useful.  */
+	canvas.pixels = (Uint32 *) background->pixels;
+	canvas.width = WIDTH;
+	canvas.height = HEIGHT;
+	canvas.color_invert = color_invert;
 
-	x = (X_SCALE * (freq - startfreq));
-	if (data == 0)
-		data = 1;
-	signal = noise + rssi + 20 * log10f(data) - log10f(datasquaresum) * 10;
+	fft_eval_render_grid(&canvas, startfreq, scale, step);
 
-	y = 400 - (400.0 + Y_SCALE * signal);
+	/* frequency labels */
+	for (i = (FFT_EVAL_MIN_FREQ + step - 1) / step * step;
+	     i < FFT_EVAL_MAX_FREQ; i += step) {
+		x = (scale * (i - startfreq));
 
-	if (highlight) {
-		color = RMASK | AMASK;
-		opacity = 255;
-	} else {
-		color = BMASK | AMASK;
-		opacity = 30;
+		if (x < 0 || x >= WIDTH)
+			continue;
+
+		snprintf(text, sizeof(text), "%d MHz", i);
+		render_text(background,
+			    &freq_labels[color_invert][i - FFT_EVAL_MIN_FREQ],
+			    text, x - 30, HEIGHT - 20);
 	}
 
-	if (bigpixel(pixels, x, y, color, opacity) < 0)
-		return -1;
-	return 0;
+	/* dBm labels */
+	for (i = 0; i < 150; i += 10) {
+		y = 600 - Y_SCALE * i;
+
+		snprintf(text, sizeof(text), "-%d dBm", (150 - i));
+		render_text(background, &dbm_labels[color_invert][i / 10],
+			    text, 5, y - 15);
+	}
+
+	background_startfreq = startfreq;
+	background_zoom = zoom;
+	background_invert = color_invert;
+	background_valid = 1;
 }
 
 
-static int draw_sample_ht20(Uint32 *pixels, struct scanresult *result,
-			    float startfreq, int highlight)
+/* prints some statistical data about the currently selected
+ * data sample and auxiliary data. */
+static void print_highlight(const struct fft_eval_sample *sample,
+			    const struct fft_eval_spectrum *spectrum)
+{
+	const struct fft_sample_ht20 *ht20;
+	const struct fft_sample_ht20_40 *ht40;
+	const struct fft_sample_ath10k *ath10k;
+	const struct fft_sample_ath11k *ath11k;
+
+	switch (sample->type) {
+	case ATH_FFT_SAMPLE_HT20:
+		ht20 = (const struct fft_sample_ht20 *)sample->tlv;
+		printf("result: freq %04d rssi %03d, noise %03d, max_magnitude %04d max_index %03d bitmap_weight %03d tsf %"PRIu64" | ",
+			ht20->freq, ht20->rssi, ht20->noise,
+			ht20->max_magnitude, ht20->max_index, ht20->bitmap_weight,
+			ht20->tsf);
+		printf("datamax = %.0f, datamin = %.0f, datasquaresum = %.0f\n",
+		       spectrum->datamax, spectrum->datamin,
+		       spectrum->datasquaresum[0]);
+		break;
+	case ATH_FFT_SAMPLE_HT20_40:
+		ht40 = (const struct fft_sample_ht20_40 *)sample->tlv;
+		printf("result: freq %04d lower_rssi %03d, upper_rssi %03d, lower_noise %03d, upper_noise %03d, lower_max_magnitude %04d upper_max_magnitude %04d lower_max_index %03d upper_max_index %03d lower_bitmap_weight %03d upper_bitmap_weight %03d tsf %"PRIu64" | ",
+		       ht40->freq, ht40->lower_rssi,
+		       ht40->upper_rssi,
+		       ht40->lower_noise,
+		       ht40->upper_noise,
+		       ht40->lower_max_magnitude,
+		       ht40->upper_max_magnitude,
+		       ht40->lower_max_index,
+		       ht40->upper_max_index,
+		       ht40->lower_bitmap_weight,
+		       ht40->upper_bitmap_weight,
+		       ht40->tsf);
+		printf("datamax = %.0f, datamin = %.0f, datasquaresum_lower = %.0f\n",
+		       spectrum->datamax, spectrum->datamin,
+		       spectrum->datasquaresum[0]);
+		printf("datamax = %.0f, datamin = %.0f, datasquaresum_upper = %.0f\n",
+		       spectrum->datamax, spectrum->datamin,
+		       spectrum->datasquaresum[1]);
+		break;
+	case ATH_FFT_SAMPLE_ATH10K:
+		ath10k = (const struct fft_sample_ath10k *)sample->tlv;
+		printf("result: freq %04d/%04d (width %d MHz), %d bins, rssi %03d, noise %03d, max_magnitude %04d max_index %03d tsf %"PRIu64" | ",
+		       ath10k->freq1, ath10k->freq1,
+		       ath10k->chan_width_mhz,
+		       sample->bins, ath10k->rssi,
+		       ath10k->noise, ath10k->max_magnitude,
+		       ath10k->max_index, ath10k->tsf);
+		printf("datamax = %.0f, datamin = %.0f, datasquaresum = %.0f\n",
+		       spectrum->datamax, spectrum->datamin,
+		       spectrum->datasquaresum[0]);
+		break;
+	case ATH_FFT_SAMPLE_ATH11K:
+		ath11k = (const struct fft_sample_ath11k *)sample->tlv;
+		printf("result: freq %04d/%04d (width %d MHz), %d bins, rssi %04d, noise %04d, max_magnitude %04d max_index %03d max_exp %03d tsf %08d | ",
+		       ath11k->freq1, ath11k->freq1,
+		       ath11k->chan_width_mhz,
+		       sample->bins, ath11k->rssi,
+		       ath11k->noise, ath11k->max_magnitude,
+		       ath11k->max_index, ath11k->max_exp,
+		       ath11k->tsf);
+		printf("datamax = %.0f, datamin = %.0f, datasquaresum = %.0f\n",
+		       spectrum->datamax, spectrum->datamin,
+		       spectrum->datasquaresum[0]);
+		break;
+	}
+}
+
+/* adds (sign 1) or removes (sign -1) a sample to the cloud */
+static void cloud_sample(size_t rnum, int startfreq, int sign)
 {
-	int datamax = 0, datamin = 65536;
-	int datasquaresum = 0;
-	int i;
+	struct fft_eval_spectrum spectrum;
+	struct fft_eval_sample sample;
+
+	if (rnum >= result_store.n)
+		return;
 
-	for (i = 0; i < SPECTRAL_HT20_NUM_BINS; i++) {
-		int data;
+	fft_eval_store_get(&result_store, rnum, &sample);
+	if (fft_eval_decode(&sample, &spectrum, 0) < 0)
+		return;
 
-		data = (result->sample.ht20.data[i] << result->sample.ht20.max_exp);
-		data *= data;
-		datasquaresum += data;
-		if (data > datamax) datamax = data;
-		if (data < datamin) datamin = data;
+	fft_eval_layer_add(&cloud, &spectrum, startfreq, sign);
+}
+
+/*
+ * draw_cloud - brings the cloud up to date for the view and highlight
+ *
+ * Samples which were added to the store since the cloud was drawn are
+ * added one by one. The frequency index is only built again when the whole
+ * cloud has to be drawn.
+ */
+static void draw_cloud(size_t highlight, int startfreq)
+{
+	if (cloud_valid && cloud_startfreq == startfreq &&
+	    cloud.color_invert == color_invert) {
+		for (; cloud_samples < result_store.n; cloud_samples++) {
+			if (cloud_samples != cloud_highlight)
+				cloud_sample(cloud_samples, startfreq, 1);
+		}
+
+		if (cloud_highlight != highlight) {
+			cloud_sample(cloud_highlight, startfreq, 1);
+			cloud_sample(highlight, startfreq, -1);
+			cloud_highlight = highlight;
+		}
+		return;
 	}
 
-	if (highlight) {
-		/* prints some statistical data about the currently selected
-		 * data sample and auxiliary data. */
-		printf("result: freq %04d rssi %03d, noise %03d, max_magnitude %04d max_index %03d bitmap_weight %03d tsf %"PRIu64" | ",
-			result->sample.ht20.freq, result->sample.ht20.rssi, result->sample.ht20.noise,
-			result->sample.ht20.max_magnitude, result->sample.ht20.max_index, result->sample.ht20.bitmap_weight,
-			result->sample.ht20.tsf);
-		printf("datamax = %d, datamin = %d, datasquaresum = %d\n", datamax, datamin, datasquaresum);
-	}
-
-	for (i = 0; i < SPECTRAL_HT20_NUM_BINS; i++) {
-		float freq;
-		int data;
-		/*
-		 * According to Dave Aragon from University of Washington,
-		 * formerly Trapeze/Juniper Networks, in 2.4 GHz it should
-		 * divide 22 MHz channel width into 64 subcarriers but
-		 * only report the middle 56 subcarriers.
-		 *
-		 * For 5 GHz we do not know (Atheros claims it does not support
-		 * this frequency band, but it works).
-		 *
-		 * Since all these calculations map pretty much to -10/+10 MHz,
-		 * and we don't know better, use this assumption as well in 5 GHz.
-		 */
-		freq = result->sample.ht20.freq -
-				(22.0 * SPECTRAL_HT20_NUM_BINS / 64.0) / 2 +
-				(22.0 * (i + 0.5) / 64.0);
-
-		data = result->sample.ht20.data[i] << result->sample.ht20.max_exp;
-		plot_datapoint(pixels, freq, startfreq, result->sample.ht20.noise,
-			       result->sample.ht20.rssi, data, datasquaresum,
-			       highlight);
+	cloud_valid = 0;
+
+	if (freq_index_samples != result_store.n) {
+		fft_eval_freq_index_free(&freq_index);
+		if (fft_eval_freq_index_build(&freq_index, &result_store, 0) < 0)
+			return;
+
+		freq_index_samples = result_store.n;
 	}
 
-	return 0;
+	fft_eval_layer_clear(&cloud, color_invert);
+	if (fft_eval_layer_draw(&cloud, &result_store, &freq_index, startfreq,
+				highlight, fft_eval_config.threads) < 0)
+		return;
+
+	cloud_startfreq = startfreq;
+	cloud_highlight = highlight;
+	cloud_samples = result_store.n;
+	cloud_valid = 1;
 }
 
+/*
+ * draw_density - counts the samples which were not counted before
+ */
+static void draw_density(void)
+{
+	struct fft_eval_spectrum spectrum;
+	struct fft_eval_sample sample;
 
-static int draw_sample_ht20_40(Uint32 *pixels, struct scanresult *result,
-			       float startfreq, int highlight)
+	for (; density_samples < result_store.n; density_samples++) {
+		fft_eval_store_get(&result_store, density_samples, &sample);
+		if (fft_eval_decode(&sample, &spectrum, 0) < 0)
+			continue;
+
+		fft_eval_density_add(&density, &spectrum);
+	}
+}
+
+/*
+ * draw_pyramid - adds the samples which were not added before
+ */
+static void draw_pyramid(void)
 {
-	int datamax = 0, datamin = 65536;
-	int datasquaresum_lower = 0;
-	int datasquaresum_upper = 0;
-	int datasquaresum;
-	int i;
-	int centerfreq;
-	s8 noise;
-	s8 rssi;
+	struct fft_eval_spectrum spectrum;
+	struct fft_eval_sample sample;
 
-	for (i = 0; i < SPECTRAL_HT20_40_NUM_BINS / 2; i++) {
-		int data;
+	for (; pyramid_samples < result_store.n; pyramid_samples++) {
+		fft_eval_store_get(&result_store, pyramid_samples, &sample);
+		if (fft_eval_decode(&sample, &spectrum, 0) < 0)
+			continue;
 
-		data = result->sample.ht40.data[i];
-		data <<= result->sample.ht40.max_exp;
-		data *= data;
-		datasquaresum_lower += data;
+		fft_eval_pyramid_add(&pyramid, &spectrum);
+	}
 
-		if (data > datamax) datamax = data;
-		if (data < datamin) datamin = data;
+	fft_eval_pyramid_update(&pyramid);
+}
+
+/*
+ * waterfall_row - draws the row of a sample, an empty row if there is no
+ *  sample with this number
+ */
+static void waterfall_row(long rnum, int startfreq)
+{
+	struct fft_eval_spectrum spectrum;
+	struct fft_eval_spectrum *row = NULL;
+	struct fft_eval_sample sample;
+	Uint32 pixels[WIDTH];
+	SDL_Rect rect;
+
+	if (rnum >= 0 && (size_t)rnum < result_store.n) {
+		fft_eval_store_get(&result_store, rnum, &sample);
+		if (fft_eval_decode(&sample, &spectrum, 0) == 0)
+			row = &spectrum;
 	}
 
-	for (i = SPECTRAL_HT20_40_NUM_BINS / 2; i < SPECTRAL_HT20_40_NUM_BINS; i++) {
-		int data;
+	fft_eval_render_row(pixels, WIDTH, row, startfreq, color_invert);
 
-		data = result->sample.ht40.data[i];
-		data <<= result->sample.ht40.max_exp;
-		datasquaresum_upper += data;
+	rect.x = 0;
+	rect.y = WATERFALL_ROWS - 1 -
+		 ((rnum % WATERFALL_ROWS) + WATERFALL_ROWS) % WATERFALL_ROWS;
+	rect.w = WIDTH;
+	rect.h = 1;
+	SDL_UpdateTexture(waterfall_texture, &rect, pixels, sizeof(pixels));
+}
 
-		if (data > datamax) datamax = data;
-		if (data < datamin) datamin = data;
+/*
+ * draw_waterfall - brings the waterfall up to date and copies it to the
+ *  renderer
+ *
+ * @last: sample shown in the top row
+ *
+ * Only the rows of samples which were not shown before are drawn.
+ */
+static void draw_waterfall(long last, int startfreq)
+{
+	SDL_Rect src, dst;
+	long first, end;
+	long rnum;
+	int top;
+
+	if (waterfall_valid && waterfall_startfreq == startfreq &&
+	    waterfall_invert == color_invert &&
+	    labs(last - waterfall_last) < WATERFALL_ROWS) {
+		if (last >= waterfall_last) {
+			/* new rows at the top */
+			first = waterfall_last + 1;
+			end = last + 1;
+		} else {
+			/* new rows at the bottom */
+			first = last - WATERFALL_ROWS + 1;
+			end = waterfall_last - WATERFALL_ROWS + 1;
+		}
+	} else {
+		first = last - WATERFALL_ROWS + 1;
+		end = last + 1;
 	}
 
-	switch (result->sample.ht40.channel_type) {
-	case NL80211_CHAN_HT40PLUS:
-		centerfreq = result->sample.ht40.freq + 10;
+	for (rnum = first; rnum < end; rnum++)
+		waterfall_row(rnum, startfreq);
+
+	waterfall_last = last;
+	waterfall_startfreq = startfreq;
+	waterfall_invert = color_invert;
+	waterfall_valid = 1;
+
+	/* from the top row to the end of the texture, then the rest */
+	top = WATERFALL_ROWS - 1 - last % WATERFALL_ROWS;
+
+	src.x = 0;
+	src.y = top;
+	src.w = WIDTH;
+	src.h = WATERFALL_ROWS - top;
+	dst = src;
+	dst.y = 0;
+	SDL_RenderCopy(renderer, waterfall_texture, &src, &dst);
+
+	if (top == 0)
+		return;
+
+	src.y = 0;
+	src.h = top;
+	dst = src;
+	dst.y = WATERFALL_ROWS - top;
+	SDL_RenderCopy(renderer, waterfall_texture, &src, &dst);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * frame_time_percentile - draw time in ms which p percent of the last
+ *  FRAME_TIMES frames didn't exceed
+ */
+static double frame_time_percentile(const double *sorted, size_t n, int p)
+{
+	return sorted[(n - 1) * p / 100];
+}
+
+/*
+ * draw_frame_times - shows the median and 99th percentile of the last frame
+ *  draw times in the top right corner
+ *
+ * The text is only rendered again when it changed.
+ */
+static void draw_frame_times(void)
+{
+	SDL_Color fontcolor_white = {255, 255, 255, 255};
+	SDL_Color fontcolor_black = {0, 0, 0, 255};
+	double sorted[FRAME_TIMES];
+	SDL_Surface *surface;
+	char text[64];
+	size_t n;
+
+	n = frame_count < FRAME_TIMES ? frame_count : FRAME_TIMES;
+	if (n == 0)
+		return;
+
+	memcpy(sorted, frame_ms, n * sizeof(*sorted));
+	qsort(sorted, n, sizeof(*sorted), cmp_double);
+
+	snprintf(text, sizeof(text), "frame p50 %.1f ms p99 %.1f ms",
+		 frame_time_percentile(sorted, n, 50),
+		 frame_time_percentile(sorted, n, 99));
+
+	if (!frame_times_texture || frame_times_invert != color_invert ||
+	    strcmp(text, frame_times_text) != 0) {
+		if (frame_times_texture)
+			SDL_DestroyTexture(frame_times_texture);
+		frame_times_texture = NULL;
+
+		surface = TTF_RenderText_Solid(font, text, color_invert ?
+					       fontcolor_black :
+					       fontcolor_white);
+		if (!surface)
+			return;
+
+		frame_times_texture = SDL_CreateTextureFromSurface(renderer,
+								   surface);
+		frame_times_rect.w = surface->w;
+		frame_times_rect.h = surface->h;
+		frame_times_rect.x = WIDTH - surface->w - 10;
+		frame_times_rect.y = 5;
+		SDL_FreeSurface(surface);
+
+		if (!frame_times_texture)
+			return;
+
+		strcpy(frame_times_text, text);
+		frame_times_invert = color_invert;
+	}
+
+	SDL_RenderCopy(renderer, frame_times_texture, NULL, &frame_times_rect);
+}
+
+/*
+ * draw_picture - draws the current screen.
+ *
+ * @highlight: the index of the dataset to be highlighted
+ *
+ * returns the center frequency of the currently highlighted dataset
+ */
+static int draw_picture(int highlight, int startfreq)
+{
+	struct fft_eval_canvas canvas;
+	int highlight_freq = startfreq + 20;
+	struct fft_eval_spectrum spectrum;
+	struct fft_eval_sample sample;
+	enum fft_eval_stage stage;
+	SDL_Rect DestR;
+
+	stage = fft_eval_stage_enter(FFT_EVAL_STAGE_RENDER);
+
+	draw_background(startfreq);
+
+	canvas.pixels = (Uint32 *) frame->pixels;
+	canvas.width = WIDTH;
+	canvas.height = HEIGHT;
+	canvas.color_invert = color_invert;
+
+	switch (view) {
+	case VIEW_SAMPLES:
+		if (zoom != 0) {
+			draw_pyramid();
+			memcpy(frame->pixels, background->pixels,
+			       (size_t)frame->pitch * HEIGHT);
+			fft_eval_render_envelope(&canvas, &pyramid, startfreq,
+						 view_scale());
+			break;
+		}
+
+		draw_cloud(highlight, startfreq);
+		fft_eval_layer_compose(&canvas, (Uint32 *) background->pixels,
+				       &cloud);
 		break;
-	case NL80211_CHAN_HT40MINUS:
-		centerfreq = result->sample.ht40.freq - 10;
+	case VIEW_DENSITY:
+		draw_density();
+		memcpy(frame->pixels, background->pixels,
+		       (size_t)frame->pitch * HEIGHT);
+		fft_eval_render_density(&canvas, &density, startfreq);
+		break;
+	case VIEW_WATERFALL:
+		/* only the frequency labels remain visible */
+		memcpy(frame->pixels, background->pixels,
+		       (size_t)frame->pitch * HEIGHT);
 		break;
-	default:
-		return -1;
 	}
 
-	if (highlight) {
-		/* prints some statistical data about the currently selected
-		 * data sample and auxiliary data. */
-		printf("result: freq %04d lower_rssi %03d, upper_rssi %03d, lower_noise %03d, upper_noise %03d, lower_max_magnitude %04d upper_max_magnitude %04d lower_max_index %03d upper_max_index %03d lower_bitmap_weight %03d upper_bitmap_weight %03d tsf %"PRIu64" | ",
-		       result->sample.ht40.freq, result->sample.ht40.lower_rssi,
-		       result->sample.ht40.upper_rssi,
-		       result->sample.ht40.lower_noise,
-		       result->sample.ht40.upper_noise,
-		       result->sample.ht40.lower_max_magnitude,
-		       result->sample.ht40.upper_max_magnitude,
-		       result->sample.ht40.lower_max_index,
-		       result->sample.ht40.upper_max_index,
-		       result->sample.ht40.lower_bitmap_weight,
-		       result->sample.ht40.upper_bitmap_weight,
-		       result->sample.ht40.tsf);
-		printf("datamax = %d, datamin = %d, datasquaresum_lower = %d\n",
-		       datamax, datamin, datasquaresum_lower);
-		printf("datamax = %d, datamin = %d, datasquaresum_upper = %d\n",
-		       datamax, datamin, datasquaresum_upper);
-	}
-
-	for (i = 0; i < SPECTRAL_HT20_40_NUM_BINS; i++) {
-		float freq;
-		int data;
-
-		freq = centerfreq -
-				(40.0 * SPECTRAL_HT20_40_NUM_BINS / 128.0) / 2 +
-				(40.0 * (i + 0.5) / 128.0);
-
-		if (i < SPECTRAL_HT20_40_NUM_BINS / 2) {
-			noise = result->sample.ht40.lower_noise;
-			datasquaresum = datasquaresum_lower;
-			rssi = result->sample.ht40.lower_rssi;
-		} else {
-			noise = result->sample.ht40.upper_noise;
-			datasquaresum = datasquaresum_upper;
-			rssi = result->sample.ht40.upper_rssi;
-		}
+	if ((size_t)highlight < result_store.n) {
+		fft_eval_store_get(&result_store, highlight, &sample);
+		highlight_freq = sample.freq;
 
-		data = result->sample.ht40.data[i];
-		data <<= result->sample.ht40.max_exp;
-		plot_datapoint(pixels, freq, startfreq, noise, rssi, data,
-			       datasquaresum, highlight);
+		if (fft_eval_decode(&sample, &spectrum, 0) == 0) {
+			print_highlight(&sample, &spectrum);
+			if (view != VIEW_WATERFALL && zoom == 0)
+				fft_eval_render_sample(&canvas, &spectrum,
+						       startfreq, 1);
+		}
 	}
 
-	return 0;
+	SDL_UpdateTexture(frame_texture, NULL, frame->pixels, frame->pitch);
+
+	DestR.x = 0;
+	DestR.y = 0;
+	DestR.w = WIDTH;
+	DestR.h = HEIGHT;
+
+	SDL_RenderClear(renderer);
+	SDL_RenderCopy(renderer, frame_texture, NULL, &DestR);
+
+	if (view == VIEW_WATERFALL)
+		draw_waterfall(highlight, startfreq);
+
+	if (show_frame_times)
+		draw_frame_times();
+
+	SDL_RenderPresent(renderer);
+
+	fft_eval_stage_enter(stage);
+
+	return highlight_freq;
 }
 
-static int draw_sample_ath10k(Uint32 *pixels, struct scanresult *result,
-			      float startfreq, int highlight)
+static void *live_ingest(void *arg)
 {
-	int datamax = 0, datamin = 65536;
-	int datasquaresum = 0;
-	int i, bins;
+	struct fft_eval_sample sample;
 
-	bins = result->sample.tlv.length -
-	       (sizeof(result->sample.ath10k.header) -
-		sizeof(result->sample.ath10k.header.tlv));
+	(void)arg;
 
+	while (fft_eval_reader_next(&live_reader, &sample) > 0)
+		fft_eval_ring_push(&live_ring, &sample);
 
-	for (i = 0; i < bins; i++) {
-		int data;
+	return NULL;
+}
 
-		data = (result->sample.ath10k.data[i] << result->sample.ath10k.header.max_exp);
-		data *= data;
-		datasquaresum += data;
-		if (data > datamax) datamax = data;
-		if (data < datamin) datamin = data;
+/*
+ * live_start - opens the scanfile and starts the ingest thread
+ *
+ * returns 0 on success, -1 on error.
+ */
+static int live_start(const char *fname)
+{
+	if (fft_eval_ring_init(&live_ring, FFT_EVAL_RING_SIZE) < 0) {
+		fprintf(stderr, "Couldn't allocate the sample ring\n");
+		return -1;
 	}
 
-	if (highlight) {
-		/* prints some statistical data about the currently selected
-		 * data sample and auxiliary data. */
-		printf("result: freq %04d/%04d (width %d MHz), %d bins, rssi %03d, noise %03d, max_magnitude %04d max_index %03d tsf %"PRIu64" | ",
-		       result->sample.ath10k.header.freq1, result->sample.ath10k.header.freq1,
-		       result->sample.ath10k.header.chan_width_mhz,
-		       bins, result->sample.ath10k.header.rssi,
-		       result->sample.ath10k.header.noise, result->sample.ath10k.header.max_magnitude,
-		       result->sample.ath10k.header.max_index, result->sample.ath10k.header.tsf);
-		printf("datamax = %d, datamin = %d, datasquaresum = %d\n", datamax, datamin, datasquaresum);
+	if (fft_eval_reader_open(&live_reader, fname) < 0) {
+		perror(fname);
+		fft_eval_ring_free(&live_ring);
+		return -1;
 	}
 
-	for (i = 0; i < bins; i++) {
-		float freq;
-		int data;
-		freq = result->sample.ath10k.header.freq1 -
-				(result->sample.ath10k.header.chan_width_mhz ) / 2 +
-				(result->sample.ath10k.header.chan_width_mhz * (i + 0.5) / bins);
+	live_reader.flags = FFT_EVAL_READER_FOLLOW | FFT_EVAL_READER_NOSTATS;
 
-		data = result->sample.ath10k.data[i] << result->sample.ath10k.header.max_exp;
-		plot_datapoint(pixels, freq, startfreq, result->sample.ath10k.header.noise,
-			       result->sample.ath10k.header.rssi, data, datasquaresum,
-			       highlight);
+	if (pthread_create(&live_thread, NULL, live_ingest, NULL) != 0) {
+		fprintf(stderr, "Couldn't start the ingest thread\n");
+		fft_eval_reader_close(&live_reader);
+		fft_eval_ring_free(&live_ring);
+		return -1;
 	}
 
+	live_running = 1;
+
 	return 0;
 }
 
-static int draw_sample_ath11k(Uint32 *pixels, struct scanresult *result,
-			      float startfreq, int highlight)
+/*
+ * live_stop - stops the ingest thread, which usually waits for more data
+ *
+ * The counters of the reader are only added to fft_eval_stats after the
+ * thread ended.
+ */
+static void live_stop(void)
 {
-	int datamax = 0, datamin = 65536;
-	int datasquaresum = 0;
-	int i, bins;
+	if (!live_running)
+		return;
 
-	bins = result->sample.tlv.length -
-	       (sizeof(result->sample.ath11k.header) -
-		sizeof(result->sample.ath11k.header.tlv));
+	fft_eval_reader_stop(&live_reader);
+	pthread_join(live_thread, NULL);
+	live_running = 0;
 
-	for (i = 0; i < bins; i++) {
-		int data;
+	live_reader.stats.dropped = fft_eval_ring_dropped(&live_ring);
+	if (live_reader.stats.dropped)
+		fprintf(stderr, "dropped %llu samples\n",
+			(unsigned long long)live_reader.stats.dropped);
 
-		data = (result->sample.ath11k.data[i] << result->sample.ath11k.header.max_exp);
-		data *= data;
-		datasquaresum += data;
-		if (data > datamax) datamax = data;
-		if (data < datamin) datamin = data;
+	fft_eval_reader_close(&live_reader);
+	fft_eval_ring_free(&live_ring);
+}
+
+/*
+ * live_update - appends the samples of the ring to the store
+ *
+ * @highlight: moved along to the newest sample when it was on the last one
+ *
+ * returns 1 when the picture should be drawn again.
+ */
+static int live_update(int *highlight)
+{
+	static struct fft_eval_ring_slot slot;
+	static int pending = 0;
+	int follow = (size_t)*highlight + 1 >= result_store.n;
+	Uint32 now;
+
+	while (fft_eval_ring_pop(&live_ring, &slot)) {
+		if (fft_eval_store_add_sample(&result_store, &slot.sample) < 0)
+			break;
+
+		pending = 1;
 	}
 
-	if (highlight) {
-		/* prints some statistical data about the currently selected
-		 * data sample and auxiliary data. */
-		printf("result: freq %04d/%04d (width %d MHz), %d bins, rssi %04d, noise %04d, max_magnitude %04d max_index %03d max_exp %03d tsf %08d | ",
-		       result->sample.ath11k.header.freq1, result->sample.ath11k.header.freq1,
-		       result->sample.ath11k.header.chan_width_mhz,
-		       bins, result->sample.ath11k.header.rssi,
-		       result->sample.ath11k.header.noise, result->sample.ath11k.header.max_magnitude,
-		       result->sample.ath11k.header.max_index, result->sample.ath11k.header.max_exp,
-		       result->sample.ath11k.header.tsf);
-		printf("datamax = %d, datamin = %d, datasquaresum = %d\n", datamax, datamin, datasquaresum);
+	if (follow && result_store.n > 0)
+		*highlight = result_store.n - 1;
+
+	now = SDL_GetTicks();
+	if (!pending || now - live_drawn < 1000 / LIVE_FPS)
+		return 0;
+
+	pending = 0;
+	live_drawn = now;
+
+	return 1;
+}
+
+/*
+ * index_update - brings the TSF index up to date with the store
+ *
+ * returns 0 on success, -1 if memory ran out.
+ */
+static int index_update(void)
+{
+	if (sample_index.by_tsf && sample_index.n == result_store.n)
+		return 0;
+
+	fft_eval_index_free(&sample_index);
+
+	return fft_eval_index_build(&sample_index, &result_store);
+}
+
+/*
+ * index_init - sets up the TSF index after the scanfile was read
+ *
+ * With -i, the index is read from fname.idx when it matches the scanfile
+ * and written there otherwise.
+ */
+static void index_init(const char *fname)
+{
+	if (index_file &&
+	    fft_eval_index_load(&sample_index, &result_store, fname) == 0)
+		return;
+
+	if (index_update() < 0) {
+		fprintf(stderr, "Couldn't build the sample index\n");
+		return;
 	}
 
-	for (i = 0; i < bins; i++) {
-		float freq;
-		int data;
-		freq = result->sample.ath11k.header.freq1 -
-				(result->sample.ath11k.header.chan_width_mhz ) / 2 +
-				(result->sample.ath11k.header.chan_width_mhz * (i + 0.5) / bins);
+	if (index_file &&
+	    fft_eval_index_save(&sample_index, fname) < 0)
+		fprintf(stderr, "Couldn't write %s.idx: %s\n", fname,
+			strerror(errno));
+}
 
-		data = result->sample.ath11k.data[i] << result->sample.ath11k.header.max_exp;
-		plot_datapoint(pixels, freq, startfreq, result->sample.ath11k.header.noise,
-			       result->sample.ath11k.header.rssi, data, datasquaresum,
-			       highlight);
+/*
+ * find_sample - looks up the target of a jump
+ *
+ * returns the sample number, -1 if there is no such sample.
+ */
+static long find_sample(enum jump how, u64 value)
+{
+	if (result_store.n == 0)
+		return -1;
+
+	switch (how) {
+	case JUMP_SAMPLE:
+		if (value >= result_store.n)
+			return -1;
+
+		return value;
+	case JUMP_TSF:
+		if (index_update() < 0)
+			return -1;
+
+		return fft_eval_index_seek_tsf(&sample_index, value);
+	default:
+		return -1;
 	}
+}
 
-	return 0;
+/* starts typing in the target of a jump, echoed on the terminal */
+static void jump_start(enum jump how)
+{
+	jump = how;
+	jump_len = 0;
+	jump_text[0] = '\0';
+
+	printf(how == JUMP_TSF ? "go to TSF: " : "go to sample: ");
+	fflush(stdout);
 }
 
 /*
- * draw_picture - draws the current screen.
+ * jump_key - handles a key while the target of a jump is typed in
  *
- * @highlight: the index of the dataset to be highlighted
+ * Digits are added, backspace removes the last one, return jumps and every
+ * other key cancels.
  *
- * returns the center frequency of the currently highlighted dataset
+ * returns the sample to jump to, -1 if the highlight stays.
  */
-static int draw_picture(int highlight, int startfreq)
+static long jump_key(int key)
 {
-	Uint32 *pixels;
-	int x, y, i, rnum;
-	int highlight_freq = startfreq + 20;
-	char text[1024];
-	struct scanresult *result;
-	SDL_Surface *surface;
-	SDL_Rect DestR;
+	long rnum = -1;
+
+	if (key >= '0' && key <= '9') {
+		if (jump_len + 1 < sizeof(jump_text)) {
+			jump_text[jump_len++] = key;
+			jump_text[jump_len] = '\0';
+			putchar(key);
+			fflush(stdout);
+		}
+
+		return -1;
+	}
 
-	surface = SDL_CreateRGBSurface(SDL_SWSURFACE, WIDTH, HEIGHT, BPP, RMASK, GMASK, BMASK, AMASK);
-	pixels = (Uint32 *) surface->pixels;
-	for (y = 0; y < HEIGHT; y++)
-		for (x = 0; x < WIDTH; x++) {
-			if (color_invert)
-				pixels[x + y * WIDTH] = RMASK | GMASK | BMASK | AMASK;
-			else
-				pixels[x + y * WIDTH] = AMASK;
+	switch (key) {
+	case SDLK_BACKSPACE:
+		if (jump_len > 0) {
+			jump_text[--jump_len] = '\0';
+			printf("\b \b");
+			fflush(stdout);
 		}
 
-	/* vertical lines (frequency) */
-	for (i = 2300; i < 6000; i += 10) {
-		x = (X_SCALE * (i - startfreq));
+		return -1;
+	case SDLK_RETURN:
+	case SDLK_KP_ENTER:
+		printf("\n");
+		if (jump_len > 0) {
+			rnum = find_sample(jump, strtoull(jump_text, NULL, 10));
+			if (rnum < 0)
+				printf("no such sample\n");
+		}
+		break;
+	default:
+		printf(" (cancelled)\n");
+		break;
+	}
 
-		if (x < 0 || x > WIDTH)
-			continue;
+	jump = JUMP_NONE;
 
-		for (y = 0; y < HEIGHT - 20; y++)
-			pixels[x + y * WIDTH] = 0x40404040 | AMASK;
+	return rnum;
+}
 
-		snprintf(text, sizeof(text), "%d MHz", i);
-		render_text(surface, text, x - 30, HEIGHT - 20);
-	}
+/*
+ * set_zoom - changes the zoom, keeping the center of the window in place
+ *
+ * returns the new startfreq.
+ */
+static int set_zoom(int new_zoom, int startfreq)
+{
+	int center = startfreq + view_width() / 2;
 
-	/* horizontal lines (dBm) */
-	for (i = 0; i < 150; i += 10) {
-		y = 600 - Y_SCALE * i;
-		
-		for (x = 0; x < WIDTH; x++)
-			pixels[x + y * WIDTH] = 0x40404040 | AMASK;
+	if (new_zoom < ZOOM_MIN)
+		new_zoom = ZOOM_MIN;
+	if (new_zoom > ZOOM_MAX)
+		new_zoom = ZOOM_MAX;
 
-		snprintf(text, sizeof(text), "-%d dBm", (150 - i));
-		render_text(surface, text, 5, y - 15);
-	}
+	zoom = new_zoom;
 
+	return center - view_width() / 2;
+}
 
-	rnum = 0;
-	for (result = result_list; result ; result = result->next) {
-		switch (result->sample.tlv.type) {
-		case ATH_FFT_SAMPLE_HT20:
-			if (rnum == highlight)
-				highlight_freq = result->sample.ht20.freq;
+/* scales a movement of the window at zoom 0 to the current zoom */
+static int zoom_move(int mhz)
+{
+	double move = ldexp(mhz, -zoom);
 
-			draw_sample_ht20(pixels, result, startfreq, rnum == highlight);
-			break;
-		case ATH_FFT_SAMPLE_HT20_40:
-			if (rnum == highlight)
-				highlight_freq = result->sample.ht40.freq;
+	if (move > 0 && move < 1)
+		return 1;
+	if (move < 0 && move > -1)
+		return -1;
 
-			draw_sample_ht20_40(pixels, result, startfreq, rnum == highlight);
-			break;
-		case ATH_FFT_SAMPLE_ATH10K:
-			if (rnum == highlight)
-				highlight_freq = result->sample.ath10k.header.freq1;
+	return move;
+}
 
-			draw_sample_ath10k(pixels, result, startfreq, rnum == highlight);
-			/* TODO */
-			break;
-		case ATH_FFT_SAMPLE_ATH11K:
-			if (rnum == highlight)
-				highlight_freq = result->sample.ath11k.header.freq1;
+/*
+ * follow_highlight - scrolls towards the highlighted sample when it is not
+ *  in the window
+ *
+ * returns the new accel.
+ */
+static int follow_highlight(int highlight_freq, int startfreq, int accel)
+{
+	/* move to highlighted object */
+	if (highlight_freq - 20 < startfreq)
+		accel = -10;
+	if (highlight_freq > (startfreq + view_width()))
+		accel = 10;
 
-			draw_sample_ath11k(pixels, result, startfreq, rnum == highlight);
-			break;
-		}
-		rnum++;
+	/* if we are "far off", move a little bit faster */
+	if (highlight_freq + 300 < startfreq)
+		accel = -100;
+
+	if (highlight_freq - 300 > (startfreq + view_width()))
+		accel = 100;
+
+	return accel;
+}
+
+/*
+ * scroll_step - moves the window by one animation step and slows down
+ *
+ * returns the new startfreq.
+ */
+static int scroll_step(int startfreq, int *accel)
+{
+	if (*accel < -20)		*accel = -20;
+	if (*accel >  20)		*accel = 20;
+
+	startfreq += zoom_move(*accel);
+	if (*accel > 0)			(*accel)--;
+	if (*accel < 0)			(*accel)++;
+
+	if (startfreq < FFT_EVAL_MIN_FREQ)	startfreq = FFT_EVAL_MIN_FREQ;
+	if (startfreq > FFT_EVAL_MAX_FREQ)	startfreq = FFT_EVAL_MAX_FREQ;
+
+	return startfreq;
+}
+
+/* runs in the timer thread of SDL */
+static Uint32 anim_tick(Uint32 interval, void *param)
+{
+	SDL_Event event;
+
+	(void)param;
+
+	if (__atomic_exchange_n(&anim_pending, 1, __ATOMIC_ACQ_REL))
+		return interval;
+
+	memset(&event, 0, sizeof(event));
+	event.type = SDL_USEREVENT;
+	if (SDL_PushEvent(&event) != 1)
+		__atomic_store_n(&anim_pending, 0, __ATOMIC_RELEASE);
+
+	return interval;
+}
+
+/*
+ * anim_run - starts or stops the animation clock
+ *
+ * @run: the view scrolls or new samples are expected
+ */
+static void anim_run(int run)
+{
+	if (run && !anim_timer) {
+		anim_clock = SDL_GetTicks();
+		anim_timer = SDL_AddTimer(ANIM_STEP_MS, anim_tick, NULL);
+	} else if (!run && anim_timer) {
+		SDL_RemoveTimer(anim_timer);
+		anim_timer = 0;
 	}
+}
 
-	SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
-	SDL_FreeSurface(surface);
+/*
+ * anim_steps - takes a tick of the animation clock
+ *
+ * returns the number of animation steps which are due.
+ */
+static int anim_steps(void)
+{
+	Uint32 steps;
 
-	DestR.x = 0;
-	DestR.y = 0;
-	DestR.w = WIDTH;
-	DestR.h = HEIGHT;
+	__atomic_store_n(&anim_pending, 0, __ATOMIC_RELEASE);
 
-	SDL_RenderClear(renderer);
-	SDL_RenderCopy(renderer, texture, NULL, &DestR);
-	SDL_DestroyTexture(texture);
+	steps = (SDL_GetTicks() - anim_clock) / ANIM_STEP_MS;
+	anim_clock += steps * ANIM_STEP_MS;
 
-	SDL_RenderPresent(renderer);
+	/* don't jump after the main loop was stalled */
+	if (steps > ANIM_MAX_STEPS)
+		steps = ANIM_MAX_STEPS;
 
-	return highlight_freq;
+	return steps;
+}
+
+/* stores how long a frame took to draw */
+static void frame_time(Uint64 start)
+{
+	Uint64 end = SDL_GetPerformanceCounter();
+
+	frame_ms[frame_count % FRAME_TIMES] =
+		(double)(end - start) * 1000 / SDL_GetPerformanceFrequency();
+	frame_count++;
 }
 
 /*
@@ -566,12 +1210,29 @@ static void graphics_main(char *name, char *fontdir)
 	int change = 1, scroll = 0;
 	int startfreq = 2350, accel = 0;
 	int highlight_freq = startfreq;
+	Uint64 start;
+	long rnum;
+	int steps;
 
 	if (graphics_init_sdl(name, fontdir) < 0) {
 		fprintf(stderr, "Failed to initialize graphics.\n");
 		return;
 	}
 
+	if (live && live_start(name) < 0) {
+		graphics_quit_sdl();
+		return;
+	}
+
+	if (start_jump != JUMP_NONE) {
+		rnum = find_sample(start_jump, start_value);
+		if (rnum >= 0)
+			highlight = rnum;
+		else
+			fprintf(stderr, "No sample %"PRIu64" to start with\n",
+				start_value);
+	}
+
 	/* don't hang forever with dummy video driver */
 	videodrv = getenv("SDL_VIDEODRIVER");
 	if (videodrv && strcmp(videodrv, "dummy") == 0)
@@ -579,95 +1240,161 @@ static void graphics_main(char *name, char *fontdir)
 
 	while (!quit) {
 		if (change) {
+			start = SDL_GetPerformanceCounter();
 			highlight_freq = draw_picture(highlight, startfreq);
+			frame_time(start);
 			change = 0;
 		}
 
-		if (!scroll) {
-			/* move to highlighted object */
-			if (highlight_freq - 20 < startfreq)
-				accel = -10;
-			if (highlight_freq > (startfreq + WIDTH/X_SCALE))
-				accel = 10;
-			
-			/* if we are "far off", move a little bit faster */
-			if (highlight_freq + 300 < startfreq)
-				accel = -100;
-	
-			if (highlight_freq - 300 > (startfreq + WIDTH/X_SCALE))
-				accel = 100;
-		}
+		if (!scroll)
+			accel = follow_highlight(highlight_freq, startfreq, accel);
 
-		if (accel)
-			SDL_PollEvent(&event);
-		else
-			SDL_WaitEvent(&event);
+		anim_run(accel || live);
 
-		switch (event.type) {
-		case SDL_QUIT:
-			quit = 1;
-			break;
-		case SDL_KEYDOWN:
-			switch (event.key.keysym.sym) {
-			case SDLK_LEFT:
-				if (highlight > 0) {
-					highlight--;
-					scroll = 0;
+		/* take all queued events, then draw once for all of them */
+		SDL_WaitEvent(&event);
+		do {
+			switch (event.type) {
+			case SDL_QUIT:
+				quit = 1;
+				break;
+			case SDL_USEREVENT:
+				steps = anim_steps();
+				for (; steps > 0 && accel; steps--) {
+					if (!scroll)
+						accel = follow_highlight(highlight_freq,
+									 startfreq,
+									 accel);
+					startfreq = scroll_step(startfreq, &accel);
 					change = 1;
 				}
+
+				if (live && live_update(&highlight))
+					change = 1;
 				break;
-			case SDLK_RIGHT:
-				if (highlight < scanresults_n - 1){
-					highlight++;
-					scroll = 0;
+			case SDL_KEYDOWN:
+				if (jump != JUMP_NONE) {
+					rnum = jump_key(event.key.keysym.sym);
+					if (rnum >= 0) {
+						highlight = rnum;
+						scroll = 0;
+						change = 1;
+					}
+					break;
+				}
+
+				switch (event.key.keysym.sym) {
+				case SDLK_LEFT:
+					if (highlight > 0) {
+						highlight--;
+						scroll = 0;
+						change = 1;
+					}
+					break;
+				case SDLK_RIGHT:
+					if ((size_t)highlight + 1 < result_store.n) {
+						highlight++;
+						scroll = 0;
+						change = 1;
+					}
+					break;
+				case SDLK_HOME:
+					if (result_store.n > 0) {
+						highlight = 0;
+						scroll = 0;
+						change = 1;
+					}
+					break;
+				case SDLK_END:
+					if (result_store.n > 0) {
+						highlight = result_store.n - 1;
+						scroll = 0;
+						change = 1;
+					}
+					break;
+				case 'g':
+					jump_start(JUMP_SAMPLE);
+					break;
+				case 't':
+					jump_start(JUMP_TSF);
+					break;
+				case SDLK_PAGEUP:
+					accel-= 2;
+					scroll = 1;
+					break;
+				case SDLK_PAGEDOWN:
+					accel+= 2;
+					scroll = 1;
+					break;
+				case SDLK_2:
+					startfreq = 2370;
+					accel +=1;
+					scroll = 1;
+					break;
+				case SDLK_5:
+					startfreq = 5150;
+					accel +=1;
+					scroll = 1;
+					break;
+				case 'i':
+					color_invert = !color_invert;
+					change = 1;
+					break;
+				case 'f':
+					show_frame_times = !show_frame_times;
+					change = 1;
+					break;
+				case 'd':
+					view = view == VIEW_DENSITY ? VIEW_SAMPLES : VIEW_DENSITY;
+					startfreq = set_zoom(0, startfreq);
+					change = 1;
+					break;
+				case 'w':
+					view = view == VIEW_WATERFALL ? VIEW_SAMPLES : VIEW_WATERFALL;
+					startfreq = set_zoom(0, startfreq);
+					change = 1;
+					break;
+				case SDLK_PLUS:
+				case SDLK_EQUALS:
+				case SDLK_KP_PLUS:
+					/* only the sample view can be zoomed */
+					if (view != VIEW_SAMPLES)
+						break;
+
+					startfreq = set_zoom(zoom + 1, startfreq);
+					scroll = 1;
 					change = 1;
+					break;
+				case SDLK_MINUS:
+				case SDLK_KP_MINUS:
+					if (view != VIEW_SAMPLES)
+						break;
+
+					startfreq = set_zoom(zoom - 1, startfreq);
+					scroll = 1;
+					change = 1;
+					break;
+				default:
+					break;
 				}
 				break;
-			case SDLK_PAGEUP:
-				accel-= 2;
-				scroll = 1;
-				break;
-			case SDLK_PAGEDOWN:
-				accel+= 2;
-				scroll = 1;
-				break;
-			case SDLK_2:
-				startfreq = 2370;
-				accel +=1;
-				scroll = 1;
-				break;
-			case SDLK_5:
-				startfreq = 5150;
-				accel +=1;
-				scroll = 1;
-				break;
-			case 'i':
-				color_invert = !color_invert;
-				change = 1;
-				break;
-			default:
-				break;
-			}
-			break;
-		case SDL_WINDOWEVENT:
-			switch (event.window.event) {
-			case SDL_WINDOWEVENT_EXPOSED:
-				change = 1;
-				break;
+			case SDL_WINDOWEVENT:
+				switch (event.window.event) {
+				case SDL_WINDOWEVENT_EXPOSED:
+					change = 1;
+					break;
+				}
 			}
-		}
-		if (accel) {
-			startfreq += accel;
-			if (accel > 0)			accel--;
-			if (accel < 0)			accel++;
-			change = 1;
-		}
-		if (startfreq < 2300)		startfreq = 2300;
-		if (startfreq > 6000)		startfreq = 6000;
+		} while (SDL_PollEvent(&event));
+
+		if (startfreq < FFT_EVAL_MIN_FREQ)	startfreq = FFT_EVAL_MIN_FREQ;
+		if (startfreq > FFT_EVAL_MAX_FREQ)	startfreq = FFT_EVAL_MAX_FREQ;
 		if (accel < -20)		accel = -20;
 		if (accel >  20)		accel = 20;
 	}
 
+	anim_run(0);
+	live_stop();
 	graphics_quit_sdl();
 }
 
@@ -676,34 +1403,65 @@ static void usage(const char *prog)
 	if (!prog)
 		prog = "fft_eval";
 
-	fprintf(stderr, "Usage: %s [-f fontdir] scanfile\n", prog);
+	fprintf(stderr, "Usage: %s [-f fontdir] [-l] [-i] [-n sample | -t tsf] [-j threads] [--stats[=file]] scanfile\n", prog);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  -l         live mode: keep reading samples while scanfile is written\n");
+	fprintf(stderr, "  -i         keep the TSF index of the samples in scanfile.idx\n");
+	fprintf(stderr, "  -n sample  start at the sample with this number\n");
+	fprintf(stderr, "  -t tsf     start at the first sample at or after this TSF\n");
 	fft_eval_usage(prog);
 }
 
 int main(int argc, char *argv[])
 {
+	static const struct option long_options[] = {
+		FFT_EVAL_LONGOPTS,
+		{ NULL, 0, NULL, 0 },
+	};
 	int ch;
 	char *ss_name = NULL;
 	char *prog = NULL;
 	char *fontdir = NULL;
+	char *end;
 
 	if (argc >= 1)
 		prog = argv[0];
 
-	while ((ch = getopt(argc, argv, "f:")) != -1) {
+	while ((ch = getopt_long(argc, argv, "f:lin:t:" FFT_EVAL_OPTSTRING,
+				 long_options, NULL)) != -1) {
 		switch (ch) {
 		case 'f':
 			if (fontdir)
 				free(fontdir);
 			fontdir = strdup(optarg);
 			break;
+		case 'l':
+			live = 1;
+			break;
+		case 'i':
+			index_file = 1;
+			break;
+		case 'n':
+		case 't':
+			start_jump = ch == 'n' ? JUMP_SAMPLE : JUMP_TSF;
+			start_value = strtoull(optarg, &end, 0);
+			if (*end != '\0') {
+				usage(prog);
+				exit(127);
+			}
+			break;
 		case 's':
 			if (ss_name)
 				free(ss_name);
 			ss_name = strdup(optarg);
 			break;
 		case 'h':
+			usage(prog);
+			exit(127);
 		default:
+			if (fft_eval_parse_option(ch, optarg) == 0)
+				break;
+
 			usage(prog);
 			exit(127);
 		}
@@ -726,14 +1484,18 @@ int main(int argc, char *argv[])
 		exit(127);
 	}
 
-	if (fft_eval_init(ss_name) < 0) {
+	if (!live && fft_eval_init(ss_name) < 0) {
 		fprintf(stderr, "Couldn't read scanfile ...\n");
 		usage(prog);
 		return -1;
 	}
 
+	if (!live)
+		index_init(ss_name);
+
 	graphics_main(ss_name, fontdir);
 
+	fft_eval_index_free(&sample_index);
 	free(fontdir);
 	fft_eval_exit();
 
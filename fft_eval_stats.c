@@ -0,0 +1,181 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * SPDX-FileCopyrightText: 2026 Simon Wunderlich <sw@simonwunderlich.de>
+ */
+
+/*
+ * Counters and timers of the processing stages, enabled by --stats.
+ *
+ * The time is accounted to the current stage. Switching stages with
+ * fft_eval_stage_enter() adds the wall clock and CPU time since the last
+ * switch to the previous stage, so nested stages (e.g. decoding while the
+ * JSON output is written) are never counted twice.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "fft_eval.h"
+
+struct fft_eval_stats fft_eval_stats;
+
+static const char * const stage_names[FFT_EVAL_STAGE_MAX] = {
+	[FFT_EVAL_STAGE_NONE] = "other",
+	[FFT_EVAL_STAGE_READ] = "read",
+	[FFT_EVAL_STAGE_PARSE] = "parse",
+	[FFT_EVAL_STAGE_DECODE] = "decode",
+	[FFT_EVAL_STAGE_EMIT] = "emit",
+	[FFT_EVAL_STAGE_RENDER] = "render",
+};
+
+static const char * const type_names[] = {
+	[ATH_FFT_SAMPLE_HT20] = "ht20",
+	[ATH_FFT_SAMPLE_HT20_40] = "ht20_40",
+	[ATH_FFT_SAMPLE_ATH10K] = "ath10k",
+	[ATH_FFT_SAMPLE_ATH11K] = "ath11k",
+};
+
+static const char * const reject_names[FFT_EVAL_REJECT_MAX] = {
+	[FFT_EVAL_REJECT_SHORT_HEADER] = "short_header",
+	[FFT_EVAL_REJECT_TRUNCATED] = "truncated",
+	[FFT_EVAL_REJECT_TOO_LONG] = "too_long",
+	[FFT_EVAL_REJECT_BAD_LENGTH] = "bad_length",
+	[FFT_EVAL_REJECT_BAD_BINS] = "bad_bins",
+	[FFT_EVAL_REJECT_ZERO_NOISE] = "zero_noise",
+	[FFT_EVAL_REJECT_UNKNOWN_TYPE] = "unknown_type",
+	[FFT_EVAL_REJECT_FILTERED] = "filtered",
+};
+
+static double clock_seconds(clockid_t clock)
+{
+	struct timespec ts;
+
+	if (clock_gettime(clock, &ts) < 0)
+		return 0;
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * fft_eval_stage_switch - accounts the time so far and changes the stage
+ *
+ * Use fft_eval_stage_enter(), which does nothing when --stats is not set.
+ *
+ * returns the previous stage.
+ */
+enum fft_eval_stage fft_eval_stage_switch(enum fft_eval_stage stage)
+{
+	struct fft_eval_stats *stats = &fft_eval_stats;
+	enum fft_eval_stage prev = stats->stage;
+	double wall = clock_seconds(CLOCK_MONOTONIC);
+	double cpu = clock_seconds(CLOCK_PROCESS_CPUTIME_ID);
+
+	if (stats->stage_wall > 0) {
+		stats->wall[prev] += wall - stats->stage_wall;
+		stats->cpu[prev] += cpu - stats->stage_cpu;
+	}
+
+	stats->stage = stage;
+	stats->stage_wall = wall;
+	stats->stage_cpu = cpu;
+
+	return prev;
+}
+
+void fft_eval_counts_add(struct fft_eval_counts *dst,
+			 const struct fft_eval_counts *src)
+{
+	size_t i;
+
+	dst->tlvs += src->tlvs;
+
+	for (i = 0; i < FFT_EVAL_NUM_TYPES; i++)
+		dst->accepted[i] += src->accepted[i];
+
+	for (i = 0; i < FFT_EVAL_REJECT_MAX; i++)
+		dst->rejected[i] += src->rejected[i];
+
+	dst->filtered_bytes += src->filtered_bytes;
+}
+
+/*
+ * fft_eval_stats_add - adds the counters of src to dst
+ *
+ * The time spent in the stages is not added, it is only accounted on the
+ * main thread.
+ */
+void fft_eval_stats_add(struct fft_eval_stats *dst,
+			const struct fft_eval_stats *src)
+{
+	fft_eval_counts_add(&dst->counts, &src->counts);
+	dst->bytes_read += src->bytes_read;
+	dst->reported += src->reported;
+	dst->suppressed += src->suppressed;
+	dst->dropped += src->dropped;
+	dst->decimated += src->decimated;
+}
+
+/*
+ * fft_eval_stats_report - writes the statistics as JSON
+ *
+ * The output goes to the file given to --stats or to stderr. Nothing is
+ * written when --stats was not set.
+ */
+void fft_eval_stats_report(void)
+{
+	const struct fft_eval_stats *stats = &fft_eval_stats;
+	FILE *fp = stderr;
+	int i;
+
+	if (!fft_eval_config.stats)
+		return;
+
+	fft_eval_stage_switch(FFT_EVAL_STAGE_NONE);
+
+	if (fft_eval_config.stats_file) {
+		fp = fopen(fft_eval_config.stats_file, "w");
+		if (!fp) {
+			perror(fft_eval_config.stats_file);
+			return;
+		}
+	}
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"bytes_read\": %llu,\n",
+		(unsigned long long)stats->bytes_read);
+	fprintf(fp, "  \"tlvs\": %llu,\n",
+		(unsigned long long)stats->counts.tlvs);
+
+	fprintf(fp, "  \"accepted\": {");
+	for (i = ATH_FFT_SAMPLE_HT20; i < FFT_EVAL_NUM_TYPES; i++)
+		fprintf(fp, "%s \"%s\": %llu", i > ATH_FFT_SAMPLE_HT20 ? "," : "",
+			type_names[i],
+			(unsigned long long)stats->counts.accepted[i]);
+	fprintf(fp, " },\n");
+
+	fprintf(fp, "  \"rejected\": {");
+	for (i = FFT_EVAL_ACCEPT + 1; i < FFT_EVAL_REJECT_MAX; i++)
+		fprintf(fp, "%s \"%s\": %llu", i > FFT_EVAL_ACCEPT + 1 ? "," : "",
+			reject_names[i],
+			(unsigned long long)stats->counts.rejected[i]);
+	fprintf(fp, " },\n");
+	fprintf(fp, "  \"filtered_bytes\": %llu,\n",
+		(unsigned long long)stats->counts.filtered_bytes);
+
+	fprintf(fp, "  \"suppressed_messages\": %llu,\n",
+		(unsigned long long)stats->suppressed);
+	fprintf(fp, "  \"dropped_samples\": %llu,\n",
+		(unsigned long long)stats->dropped);
+	fprintf(fp, "  \"decimated_samples\": %llu,\n",
+		(unsigned long long)stats->decimated);
+
+	fprintf(fp, "  \"stages\": {\n");
+	for (i = 0; i < FFT_EVAL_STAGE_MAX; i++)
+		fprintf(fp, "    \"%s\": { \"wall\": %.6f, \"cpu\": %.6f }%s\n",
+			stage_names[i], stats->wall[i], stats->cpu[i],
+			i < FFT_EVAL_STAGE_MAX - 1 ? "," : "");
+	fprintf(fp, "  }\n");
+	fprintf(fp, "}\n");
+
+	if (fp != stderr)
+		fclose(fp);
+}
@@ -0,0 +1,268 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * SPDX-FileCopyrightText: 2012 Simon Wunderlich <sw@simonwunderlich.de>
+ * SPDX-FileCopyrightText: 2012 Fraunhofer-Gesellschaft zur Foerderung der angewandten Forschung e.V.
+ * SPDX-FileCopyrightText: 2013 Gui Iribarren <gui@altermundi.net>
+ * SPDX-FileCopyrightText: 2017 Nico Pace <nicopace@altermundi.net>
+ */
+
+/*
+ * Buffered output of decoded samples.
+ *
+ * Output is collected in one large buffer which is handed to write() when
+ * it is full or flushed explicitly. Numbers are formatted without stdio.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fft_eval.h"
+
+#define ARRAY_SIZE(x)	(sizeof(x) / sizeof((x)[0]))
+
+int fft_eval_writer_init(struct fft_eval_writer *writer, int fd, size_t size)
+{
+	memset(writer, 0, sizeof(*writer));
+
+	writer->buf = malloc(size);
+	if (!writer->buf)
+		return -1;
+
+	writer->fd = fd;
+	writer->size = size;
+	writer->precision = 6;
+
+	return 0;
+}
+
+/*
+ * fft_eval_writer_flush - writes out the buffered data
+ *
+ * returns 0 on success, -1 if the data could not be written.
+ */
+int fft_eval_writer_flush(struct fft_eval_writer *writer)
+{
+	size_t pos = 0;
+	ssize_t ret;
+
+	while (pos < writer->len && !writer->error) {
+		ret = write(writer->fd, writer->buf + pos, writer->len - pos);
+		if (ret < 0 && errno == EINTR)
+			continue;
+
+		if (ret <= 0) {
+			writer->error = 1;
+			break;
+		}
+
+		pos += ret;
+	}
+
+	writer->written += writer->len;
+	writer->len = 0;
+
+	return writer->error ? -1 : 0;
+}
+
+/*
+ * fft_eval_writer_free - writes out the buffered data and frees the buffer
+ *
+ * returns 0 on success, -1 if any data could not be written.
+ */
+int fft_eval_writer_free(struct fft_eval_writer *writer)
+{
+	int ret = fft_eval_writer_flush(writer);
+
+	free(writer->buf);
+	writer->buf = NULL;
+
+	return ret;
+}
+
+/*
+ * writer_reserve - returns room for at least len bytes in the buffer
+ *
+ * The caller has to advance writer->len by the number of bytes it used.
+ */
+static char *writer_reserve(struct fft_eval_writer *writer, size_t len)
+{
+	if (writer->size - writer->len < len)
+		fft_eval_writer_flush(writer);
+
+	return writer->buf + writer->len;
+}
+
+void fft_eval_write(struct fft_eval_writer *writer, const void *data,
+		    size_t len)
+{
+	size_t chunk;
+
+	while (len > 0) {
+		chunk = writer->size - writer->len;
+		if (!chunk) {
+			fft_eval_writer_flush(writer);
+			continue;
+		}
+
+		if (chunk > len)
+			chunk = len;
+
+		memcpy(writer->buf + writer->len, data, chunk);
+		writer->len += chunk;
+		data = (const char *)data + chunk;
+		len -= chunk;
+	}
+}
+
+void fft_eval_write_str(struct fft_eval_writer *writer, const char *str)
+{
+	fft_eval_write(writer, str, strlen(str));
+}
+
+static size_t format_u64(char *out, u64 value)
+{
+	char tmp[20];
+	size_t len = 0;
+	size_t i;
+
+	do {
+		tmp[len++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+
+	for (i = 0; i < len; i++)
+		out[i] = tmp[len - i - 1];
+
+	return len;
+}
+
+void fft_eval_write_u64(struct fft_eval_writer *writer, u64 value)
+{
+	char *out = writer_reserve(writer, 20);
+
+	writer->len += format_u64(out, value);
+}
+
+void fft_eval_write_int(struct fft_eval_writer *writer, int64_t value)
+{
+	char *out = writer_reserve(writer, 21);
+	size_t len = 0;
+
+	if (value < 0) {
+		out[len++] = '-';
+		len += format_u64(out + len, -(u64)value);
+	} else {
+		len += format_u64(out + len, value);
+	}
+
+	writer->len += len;
+}
+
+static const u64 pow10_table[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+	10000000ULL, 100000000ULL, 1000000000ULL,
+};
+
+/*
+ * fft_eval_write_float - writes value like printf("%.*f", precision, value)
+ *
+ * A float has a 24 bit mantissa, so value * 10^precision is exact in double
+ * precision for precision <= 9. Rounding it to the nearest integer with ties
+ * to even gives exactly the digits printf would produce. Values which do not
+ * fit into 64 bit after scaling, NaN and infinity are passed to snprintf.
+ */
+void fft_eval_write_float(struct fft_eval_writer *writer, float value,
+			  int precision)
+{
+	char *out = writer_reserve(writer, 64);
+	double scaled;
+	u64 fixed, scale;
+	size_t len = 0;
+	size_t digits;
+	int i;
+
+	if (precision < 0 || precision >= (int)ARRAY_SIZE(pow10_table))
+		goto fallback;
+
+	scale = pow10_table[precision];
+	scaled = fabs((double)value) * scale;
+	if (!(scaled < 9e18))
+		goto fallback;
+
+	fixed = nearbyint(scaled);
+
+	if (signbit(value))
+		out[len++] = '-';
+
+	len += format_u64(out + len, fixed / scale);
+
+	if (precision > 0) {
+		out[len++] = '.';
+
+		fixed %= scale;
+		digits = len + precision;
+		for (i = precision - 1; i >= 0; i--) {
+			out[len + i] = '0' + fixed % 10;
+			fixed /= 10;
+		}
+		len = digits;
+	}
+
+	writer->len += len;
+	return;
+
+fallback:
+	writer->len += snprintf(out, 64, "%.*f", precision, value);
+}
+
+/*
+ * fft_eval_write_json - writes one decoded sample as JSON object
+ *
+ * @writer: output buffer
+ * @sample: decoded sample
+ * @spectrum: spectrum of the sample, from fft_eval_decode() with
+ *	      FFT_EVAL_DECODE_HT20_20MHZ and FFT_EVAL_DECODE_ATH11K_RAW
+ *
+ * The spectrum is decoded by the caller, so nothing is written for samples
+ * which can't be decoded.
+ */
+void fft_eval_write_json(struct fft_eval_writer *writer,
+			 const struct fft_eval_sample *sample,
+			 const struct fft_eval_spectrum *spectrum)
+{
+	char tsf[16];
+	int i;
+
+	/* prints some statistical data about the
+	 * data sample and auxiliary data. */
+	fft_eval_write_lit(writer, "{ \"tsf\": ");
+	if (sample->type == ATH_FFT_SAMPLE_ATH11K) {
+		snprintf(tsf, sizeof(tsf), "%08d", (int)sample->tsf);
+		fft_eval_write_str(writer, tsf);
+	} else {
+		fft_eval_write_u64(writer, sample->tsf);
+	}
+	fft_eval_write_lit(writer, ", \"central_freq\": ");
+	fft_eval_write_int(writer, sample->freq);
+	fft_eval_write_lit(writer, ", \"rssi\": ");
+	fft_eval_write_int(writer, sample->rssi);
+	fft_eval_write_lit(writer, ", \"noise\": ");
+	fft_eval_write_int(writer, sample->noise);
+	fft_eval_write_lit(writer, ", \"data\": [ ");
+
+	for (i = 0; i < spectrum->bins; i++) {
+		fft_eval_write_lit(writer, "[ ");
+		fft_eval_write_float(writer, spectrum->freq[i], writer->precision);
+		fft_eval_write_lit(writer, ", ");
+		fft_eval_write_float(writer, spectrum->signal[i], writer->precision);
+		fft_eval_write_lit(writer, " ]");
+		if (i < spectrum->bins - 1)
+			fft_eval_write_lit(writer, ", ");
+	}
+
+	fft_eval_write_lit(writer, " ] }");
+}